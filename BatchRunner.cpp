@@ -0,0 +1,181 @@
+#include "BatchRunner.h"
+#include "UpkPackage.h"
+#include "UpkRepackager.h"
+#include "MappedFile.h"
+#include "FileIo.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include "WinError.h"
+#include "RunStats.h"
+#include <algorithm>
+#include <cstdarg>
+#include <chrono>
+
+static std::wstring joinPath(LPCWSTR folder, const std::wstring& name) {
+	std::wstring fullPath = folder;
+	if (!fullPath.empty() && fullPath[fullPath.size() - 1] != PATH_SEPARATOR) {
+		fullPath += PATH_SEPARATOR;
+	}
+	return fullPath + name;
+}
+
+bool BatchRunner::fail(const wchar_t* format, ...) {
+	wchar_t buffer[1024];
+	va_list args;
+	va_start(args, format);
+	vswprintf(buffer, _countof(buffer), format, args);
+	va_end(args);
+	error = buffer;
+	return false;
+}
+
+bool BatchRunner::loadJobList(LPCWSTR path) {
+	MappedFile file;
+	if (!file.open(path)) {
+		WinError err;
+		return fail(L"Failed to open the job list %ls: %ls", path, err.getMessage());
+	}
+	const char* text = (const char*)file.data();
+	size_t size = file.size();
+	// Notepad puts a byte order mark in front of UTF-8 files.
+	if (size >= 3 && memcmp(text, "\xEF\xBB\xBF", 3) == 0) {
+		text += 3;
+		size -= 3;
+	}
+	int lineNumber = 0;
+	size_t lineStart = 0;
+	while (lineStart < size) {
+		size_t lineEnd = lineStart;
+		while (lineEnd < size && text[lineEnd] != '\n') ++lineEnd;
+		++lineNumber;
+		std::string line(text + lineStart, lineEnd - lineStart);
+		lineStart = lineEnd + 1;
+		if (!line.empty() && line[line.size() - 1] == '\r') line.resize(line.size() - 1);
+		if (line.empty() || line[0] == '#') continue;
+
+		std::vector<std::wstring> fields;
+		size_t fieldStart = 0;
+		while (true) {
+			size_t tab = line.find('\t', fieldStart);
+			fields.push_back(utf8ToWide(line.substr(fieldStart, tab == std::string::npos ? std::string::npos : tab - fieldStart)));
+			if (tab == std::string::npos) break;
+			fieldStart = tab + 1;
+		}
+		if (fields.size() != 1 && fields.size() != 3) {
+			return fail(L"Line %d of the job list %ls has %d fields. It must have either ORIGINAL_UPK alone or"
+				L" ORIGINAL_UPK, EXTRACTED_FOLDER and NEW_UPK, separated by tabs.", lineNumber, path, (int)fields.size());
+		}
+		for (const std::wstring& field : fields) {
+			if (field.empty()) {
+				return fail(L"Line %d of the job list %ls has an empty field.", lineNumber, path);
+			}
+		}
+		BatchJob job;
+		job.originalPath = fields[0];
+		if (fields.size() == 3) {
+			job.extractedFolder = fields[1];
+			job.outputPath = fields[2];
+		}
+		jobs.push_back(std::move(job));
+	}
+	return true;
+}
+
+bool BatchRunner::addFolder(LPCWSTR originalsFolder, LPCWSTR extractedRoot, LPCWSTR outputFolder) {
+	std::vector<FolderEntry> entries;
+	if (!listFolder(originalsFolder, entries)) {
+		WinError err;
+		return fail(L"Failed to list the folder %ls: %ls", originalsFolder, err.getMessage());
+	}
+	std::vector<std::wstring> names;
+	for (FolderEntry& entry : entries) {
+		if (!entry.isFolder && entry.name.size() > 4
+				&& _wcsicmp(entry.name.c_str() + entry.name.size() - 4, L".upk") == 0) {
+			names.push_back(std::move(entry.name));
+		}
+	}
+	if (names.empty()) {
+		return fail(L"There are no .upk files in the folder %ls", originalsFolder);
+	}
+	std::sort(names.begin(), names.end(), [](const std::wstring& a, const std::wstring& b) {
+		return _wcsicmp(a.c_str(), b.c_str()) < 0;
+	});
+	for (const std::wstring& name : names) {
+		BatchJob job;
+		job.originalPath = joinPath(originalsFolder, name);
+		if (extractedRoot) {
+			size_t dot = name.rfind(L'.');
+			job.extractedFolder = joinPath(extractedRoot, name.substr(0, dot));
+			job.outputPath = joinPath(outputFolder, name);
+		}
+		jobs.push_back(std::move(job));
+	}
+	return true;
+}
+
+int BatchRunner::getFailedCount() const {
+	int count = 0;
+	for (const BatchJob& job : jobs) {
+		if (!job.succeeded) ++count;
+	}
+	return count;
+}
+
+void BatchRunner::runJob(ThreadPool& pool, BufferPool& buffers, BatchJob& job) {
+	ScopedPhase phase("Run batch job");
+	auto startTime = std::chrono::steady_clock::now();
+	UpkPackage package;
+	package.setThreadPool(&pool);
+	// Inspecting only needs the tables, which are all in the header.
+	package.setDecompressOnDemand(job.outputPath.empty());
+	if (useIndex) {
+		package.setIndexPath((job.originalPath + L".index").c_str());
+	}
+	if (!package.open(job.originalPath.c_str())) {
+		job.error = package.getError();
+	} else if (job.outputPath.empty()) {
+		job.succeeded = true;
+	} else {
+		UpkRepackager repackager(package);
+		repackager.setThreadPool(&pool);
+		repackager.setBufferPool(&buffers);
+		repackager.setIncremental(incremental);
+		repackager.setCompression(compression);
+		repackager.setIoUring(useIoUring);
+		if (!repackager.createOutput(job.outputPath.c_str())
+				|| !repackager.writeOutput(job.extractedFolder.c_str())) {
+			job.error = repackager.getError();
+		} else {
+			job.unusedFiles = repackager.getUnusedFiles();
+			job.succeeded = true;
+		}
+	}
+	job.exportCount = package.exportTable.size();
+	job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool BatchRunner::run() {
+	if (memoryLimit && memoryLimit < UpkRepackager::minMemoryLimit) {
+		return fail(L"The memory limit must be at least %d bytes.", (int)UpkRepackager::minMemoryLimit);
+	}
+	for (BatchJob& job : jobs) {
+		unsigned long long writeTime;
+		if (!getFileInfo(job.originalPath.c_str(), job.packageSize, writeTime)) {
+			job.packageSize = 0;
+		}
+	}
+	// Biggest first, so that the last packages to start are small ones and the threads finish at about the same time.
+	std::vector<size_t> order(jobs.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+		return jobs[a].packageSize > jobs[b].packageSize;
+	});
+	ThreadPool pool(jobCount);
+	std::unique_ptr<BufferPool> buffers = UpkRepackager::createBufferPool(memoryLimit, pool.getThreadCount());
+	pool.parallelFor(order.size(), [&](size_t i) {
+		runJob(pool, *buffers, jobs[order[i]]);
+	});
+	return getFailedCount() == 0;
+}
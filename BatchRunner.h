@@ -0,0 +1,61 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+
+class ThreadPool;
+class BufferPool;
+
+// One package of a batch. Without an output path the package is only parsed, which checks that it can be read.
+struct BatchJob {
+	std::wstring originalPath;
+	std::wstring extractedFolder;
+	std::wstring outputPath;
+	bool succeeded = false;
+	std::wstring error;
+	int exportCount = 0;
+	unsigned long long packageSize = 0;
+	std::vector<std::wstring> unusedFiles;
+	double seconds = 0.;
+};
+
+// Repackages or inspects many packages in one process.
+// All of the jobs share one thread pool: the packages are handed out to the threads biggest first, and each
+// package's exports are split into tasks on the same pool, so the threads that run out of packages help
+// with the exports of the ones still going instead of waiting for one huge package to finish.
+class BatchRunner {
+public:
+	// A UTF-8 text file with one job per line: ORIGINAL_UPK, EXTRACTED_FOLDER and NEW_UPK separated by tabs,
+	// or just ORIGINAL_UPK to only inspect it. Blank lines and lines starting with # are skipped.
+	bool loadJobList(LPCWSTR path);
+	// Adds a job for every .upk file in originalsFolder, in name order. The extracted folder of a package is the
+	// folder with its name, without the extension, inside extractedRoot, and its copy goes into outputFolder under
+	// the same file name. If extractedRoot is null, the packages are only inspected.
+	bool addFolder(LPCWSTR originalsFolder, LPCWSTR extractedRoot, LPCWSTR outputFolder);
+	// How many threads the pool has. 0, the default, means one per hardware thread.
+	void setJobCount(int count) { jobCount = count; }
+	void setIncremental(bool on) { incremental = on; }
+	void setCompression(DWORD compressionFlags) { compression = compressionFlags; }
+	void setIoUring(bool on) { useIoUring = on; }
+	// One limit for all of the packages together, see UpkRepackager::setMemoryLimit. A limit that's too small
+	// fails run before any job starts.
+	void setMemoryLimit(size_t bytes) { memoryLimit = bytes; }
+	// Keeps every package's tables in an index file next to it, see UpkPackage::setIndexPath.
+	void setUseIndex(bool on) { useIndex = on; }
+	// Runs every job, even after some have failed. Returns true if all of them succeeded.
+	bool run();
+	const std::vector<BatchJob>& getJobs() const { return jobs; }
+	int getFailedCount() const;
+	const std::wstring& getError() const { return error; }
+private:
+	void runJob(ThreadPool& pool, BufferPool& buffers, BatchJob& job);
+	bool fail(const wchar_t* format, ...);
+	std::vector<BatchJob> jobs;
+	int jobCount = 0;
+	bool incremental = false;
+	bool useIoUring = false;
+	size_t memoryLimit = 0;
+	DWORD compression = 0;
+	bool useIndex = false;
+	std::wstring error;
+};
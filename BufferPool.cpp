@@ -0,0 +1,25 @@
+#include "BufferPool.h"
+#include <algorithm>
+
+BufferPool::BufferPool(size_t bufferSize, size_t maxCount)
+	: bufferSize(bufferSize), maxCount((std::max)(maxCount, (size_t)1)) { }
+
+BYTE* BufferPool::acquire() {
+	std::unique_lock<std::mutex> guard(mutex);
+	bufferReleased.wait(guard, [this] { return !freeBuffers.empty() || buffers.size() < maxCount; });
+	if (freeBuffers.empty()) {
+		buffers.emplace_back(new BYTE[bufferSize]);
+		return buffers.back().get();
+	}
+	BYTE* buffer = freeBuffers.back();
+	freeBuffers.pop_back();
+	return buffer;
+}
+
+void BufferPool::release(BYTE* buffer) {
+	{
+		std::unique_lock<std::mutex> guard(mutex);
+		freeBuffers.push_back(buffer);
+	}
+	bufferReleased.notify_one();
+}
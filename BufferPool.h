@@ -0,0 +1,43 @@
+#pragma once
+#include "Platform.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+// Buffers of one size, lent out to whoever is copying data at the moment, so that however big the payloads are,
+// the copies never take more than bufferSize * maxCount bytes. Buffers are made on first need and then reused.
+// A caller must not wait for a second buffer while holding one, or the callers could end up waiting on each other.
+class BufferPool {
+public:
+	// At least one buffer, whatever maxCount says.
+	BufferPool(size_t bufferSize, size_t maxCount);
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+	size_t getBufferSize() const { return bufferSize; }
+	size_t getMaxCount() const { return maxCount; }
+	// Waits if all maxCount buffers are lent out.
+	BYTE* acquire();
+	void release(BYTE* buffer);
+private:
+	const size_t bufferSize;
+	const size_t maxCount;
+	std::vector<std::unique_ptr<BYTE[]>> buffers;
+	std::vector<BYTE*> freeBuffers;
+	std::mutex mutex;
+	std::condition_variable bufferReleased;
+};
+
+// One buffer of a pool for as long as it's alive.
+class BufferLease {
+public:
+	explicit BufferLease(BufferPool& pool) : pool(pool), buffer(pool.acquire()) { }
+	BufferLease(const BufferLease&) = delete;
+	BufferLease& operator=(const BufferLease&) = delete;
+	~BufferLease() { pool.release(buffer); }
+	BYTE* data() const { return buffer; }
+	size_t size() const { return pool.getBufferSize(); }
+private:
+	BufferPool& pool;
+	BYTE* const buffer;
+};
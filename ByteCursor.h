@@ -0,0 +1,136 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include <cstring>
+#include <climits>
+
+// Reads little-endian values straight out of a block of memory, such as a MappedFile.
+// Every read is bounds-checked. Reading past the end does not crash: it produces zeros and sets the overrun flag,
+// so the caller only needs to check the flag once after decoding a whole table rather than after every field.
+class ByteCursor {
+public:
+	ByteCursor(const BYTE* data, size_t size) : start(data), ptr(data), end(data + size) { }
+	template<typename T>
+	void read(T& value) {
+		if ((size_t)(end - ptr) < sizeof(T)) {
+			value = T{};
+			fail();
+			return;
+		}
+		memcpy(&value, ptr, sizeof(T));
+		ptr += sizeof(T);
+	}
+	int readInt() {
+		int value;
+		read(value);
+		return value;
+	}
+	// Reads an FString: positive length means that many single-byte characters, negative length means that many
+	// UTF-16 characters. The length includes the null terminator, which does not end up in the result.
+	// Where wchar_t holds a whole code point, a surrogate pair becomes one character.
+	void readString(std::wstring& str) {
+		str.clear();
+		appendString(str);
+	}
+	// Same as readString, but adds the characters to the end of str, which can be any container of wchar_t.
+	template<typename Container>
+	void appendString(Container& str) {
+		int length = readInt();
+		size_t oldSize = str.size();
+		if (length > 0) {
+			if ((size_t)(end - ptr) < (size_t)length) {
+				fail();
+				return;
+			}
+			str.resize(oldSize + length - 1);
+			for (int i = 0; i < length - 1; ++i) {
+				str[oldSize + i] = (wchar_t)ptr[i];
+			}
+			ptr += length;
+		} else if (length < 0) {
+			if (length == INT_MIN || (size_t)(end - ptr) / 2 < (size_t)-length) {
+				fail();
+				return;
+			}
+			const int unitCount = -length - 1;
+			str.resize(oldSize + unitCount);
+			size_t count = 0;
+			for (int i = 0; i < unitCount; ++i) {
+				unsigned int c = ptr[i * 2] | (ptr[i * 2 + 1] << 8);
+				if (sizeof(wchar_t) == 4 && c >= 0xD800 && c < 0xDC00 && i + 1 < unitCount) {
+					unsigned int low = ptr[i * 2 + 2] | (ptr[i * 2 + 3] << 8);
+					if (low >= 0xDC00 && low < 0xE000) {
+						c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+						++i;
+					}
+				}
+				str[oldSize + count++] = (wchar_t)c;
+			}
+			str.resize(oldSize + count);
+			ptr += (size_t)-length * 2;
+		}
+	}
+	void skip(size_t bytes) {
+		if ((size_t)(end - ptr) < bytes) {
+			fail();
+			return;
+		}
+		ptr += bytes;
+	}
+	void seek(size_t pos) {
+		if ((size_t)(end - start) < pos) {
+			fail();
+			return;
+		}
+		ptr = start + pos;
+	}
+	size_t tell() const { return ptr - start; }
+	size_t size() const { return end - start; }
+	bool overrun = false;
+private:
+	void fail() {
+		overrun = true;
+		ptr = end;
+	}
+	const BYTE* start;
+	const BYTE* ptr;
+	const BYTE* end;
+};
+
+// Adds little-endian values to the end of a buffer, in the layout ByteCursor reads back.
+class ByteWriter {
+public:
+	explicit ByteWriter(std::vector<BYTE>& buffer) : buffer(buffer) { }
+	template<typename T>
+	void write(const T& value) {
+		const BYTE* bytes = (const BYTE*)&value;
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+	// Writes an FString with UTF-16 characters. Where wchar_t holds a whole code point, the ones above U+FFFF
+	// become surrogate pairs, and the ones that aren't code points at all become U+FFFD.
+	void writeString(const std::wstring& str) {
+		const size_t lengthPosition = buffer.size();
+		write(0);
+		int unitCount = 0;
+		for (wchar_t c : str) {
+			unsigned int code = (unsigned int)c;
+			if (code > 0x10FFFF) {
+				code = 0xFFFD;
+			}
+			if (code > 0xFFFF) {
+				write((unsigned short)(0xD800 + ((code - 0x10000) >> 10)));
+				write((unsigned short)(0xDC00 + ((code - 0x10000) & 0x3FF)));
+				unitCount += 2;
+			} else {
+				write((unsigned short)code);
+				++unitCount;
+			}
+		}
+		write((unsigned short)0);
+		const int length = -(unitCount + 1);
+		memcpy(buffer.data() + lengthPosition, &length, sizeof length);
+	}
+private:
+	std::vector<BYTE>& buffer;
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include "Platform.h"
+#include <algorithm>
+#include <list>
+#include <vector>
+
+// The most recently used decompressed chunks of a compressed package, so that reading exports one by one
+// doesn't decompress the same chunk again for every export in it. Not thread-safe.
+class ChunkCache {
+public:
+	explicit ChunkCache(size_t capacity = 8) : capacity((std::max)(capacity, (size_t)1)) { }
+	// Drops the least recently used chunks if there are more than the new capacity. At least one chunk is always kept.
+	void setCapacity(size_t newCapacity) {
+		capacity = (std::max)(newCapacity, (size_t)1);
+		while (entries.size() > capacity) entries.pop_back();
+	}
+	void clear() { entries.clear(); }
+	// Null if the chunk isn't cached. Otherwise it becomes the most recently used one.
+	const std::vector<BYTE>* find(size_t chunkIndex) {
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			if (it->chunkIndex == chunkIndex) {
+				entries.splice(entries.begin(), entries, it);
+				return &entries.front().data;
+			}
+		}
+		return nullptr;
+	}
+	// Takes the decompressed chunk, dropping the least recently used one if the cache is full.
+	// The returned reference stays valid until the chunk is dropped.
+	const std::vector<BYTE>& insert(size_t chunkIndex, std::vector<BYTE>&& data) {
+		if (entries.size() >= capacity) {
+			entries.pop_back();
+		}
+		entries.push_front(Entry { chunkIndex, std::move(data) });
+		return entries.front().data;
+	}
+private:
+	struct Entry {
+		size_t chunkIndex;
+		std::vector<BYTE> data;
+	};
+	// Linear search is fine: the cache only holds a few chunks of a megabyte or so each.
+	std::list<Entry> entries;
+	size_t capacity;
+};
@@ -0,0 +1,833 @@
+#include "Compression.h"
+#include <cstring>
+#include <algorithm>
+
+bool isDecompressionSupported(DWORD compressionFlags) {
+	DWORD method = compressionFlags & COMPRESS_METHOD_MASK;
+	return method == COMPRESS_ZLIB || method == COMPRESS_LZO;
+}
+
+bool decompressBlock(DWORD compressionFlags, const BYTE* in, size_t inSize, BYTE* out, size_t outSize) {
+	switch (compressionFlags & COMPRESS_METHOD_MASK) {
+	case COMPRESS_ZLIB: return zlibDecompress(in, inSize, out, outSize);
+	case COMPRESS_LZO: return lzoDecompress(in, inSize, out, outSize);
+	default: return false;
+	}
+}
+
+// Deflate (RFC 1951) packs bits starting from the least significant one.
+// Reading past the end produces zeros and sets the overrun flag, same as ByteCursor.
+class BitReader {
+public:
+	BitReader(const BYTE* data, size_t size) : ptr(data), end(data + size) { }
+	unsigned int peek(int count) {
+		while (bitCount <= 56 && ptr != end) {
+			bits |= (unsigned long long)*ptr++ << bitCount;
+			bitCount += 8;
+		}
+		return (unsigned int)(bits & ((1ULL << count) - 1));
+	}
+	void consume(int count) {
+		if (count > bitCount) {
+			overrun = true;
+			bitCount = 0;
+			bits = 0;
+			return;
+		}
+		bits >>= count;
+		bitCount -= count;
+	}
+	unsigned int read(int count) {
+		unsigned int value = peek(count);
+		consume(count);
+		return value;
+	}
+	// Drops the rest of the current byte and hands the bytes that were read ahead back to the caller.
+	const BYTE* alignToByte() {
+		consume(bitCount & 7);
+		ptr -= bitCount / 8;
+		bits = 0;
+		bitCount = 0;
+		return ptr;
+	}
+	void skipBytes(size_t count) { ptr += count; }
+	size_t bytesLeft() const { return end - ptr; }
+	bool overrun = false;
+private:
+	const BYTE* ptr;
+	const BYTE* end;
+	unsigned long long bits = 0;
+	int bitCount = 0;
+};
+
+// A canonical Huffman code. Codes of up to fastBits bits are decoded with one table lookup,
+// longer ones (rare in practice) bit by bit.
+class Huffman {
+public:
+	static const int maxBits = 15;
+	static const int fastBits = 10;
+	// Returns false if the lengths describe more codes than fit. Incomplete codes are allowed:
+	// hitting an unused code while decoding is reported as an error then.
+	bool build(const BYTE* lengths, int symbolCount) {
+		memset(counts, 0, sizeof counts);
+		for (int symbol = 0; symbol < symbolCount; ++symbol) {
+			++counts[lengths[symbol]];
+		}
+		counts[0] = 0;
+		int left = 1;
+		for (int length = 1; length <= maxBits; ++length) {
+			left = (left << 1) - counts[length];
+			if (left < 0) return false;
+		}
+		short offsets[maxBits + 1];
+		offsets[1] = 0;
+		for (int length = 1; length < maxBits; ++length) {
+			offsets[length + 1] = offsets[length] + counts[length];
+		}
+		for (int symbol = 0; symbol < symbolCount; ++symbol) {
+			if (lengths[symbol]) symbols[offsets[lengths[symbol]]++] = (short)symbol;
+		}
+		memset(fast, 0, sizeof fast);
+		int code = 0;
+		int index = 0;
+		for (int length = 1; length <= fastBits; ++length) {
+			for (int i = 0; i < counts[length]; ++i, ++code, ++index) {
+				// Codes are stored starting from their most significant bit, so the lookup index is the code reversed.
+				int reversed = 0;
+				for (int bit = 0; bit < length; ++bit) {
+					reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+				}
+				unsigned short entry = (unsigned short)((symbols[index] << 4) | length);
+				for (int fill = reversed; fill < (1 << fastBits); fill += 1 << length) {
+					fast[fill] = entry;
+				}
+			}
+			code <<= 1;
+		}
+		return true;
+	}
+	// Returns -1 for an unused code.
+	int decode(BitReader& reader) const {
+		unsigned short entry = fast[reader.peek(fastBits)];
+		if (entry) {
+			reader.consume(entry & 15);
+			return entry >> 4;
+		}
+		int code = 0;
+		int first = 0;
+		int index = 0;
+		unsigned int bits = reader.peek(maxBits);
+		for (int length = 1; length <= maxBits; ++length) {
+			code |= (bits >> (length - 1)) & 1;
+			int count = counts[length];
+			if (code - first < count) {
+				reader.consume(length);
+				return symbols[index + code - first];
+			}
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+		}
+		return -1;
+	}
+private:
+	short counts[maxBits + 1];
+	short symbols[288];
+	unsigned short fast[1 << fastBits];
+};
+
+static const unsigned short lengthBases[29] {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const BYTE lengthExtraBits[29] {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short distanceBases[30] {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577 };
+static const BYTE distanceExtraBits[30] {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+struct FixedCodes {
+	Huffman literals;
+	Huffman distances;
+	FixedCodes() {
+		BYTE lengths[288];
+		memset(lengths, 8, 144);
+		memset(lengths + 144, 9, 112);
+		memset(lengths + 256, 7, 24);
+		memset(lengths + 280, 8, 8);
+		literals.build(lengths, 288);
+		memset(lengths, 5, 30);
+		distances.build(lengths, 30);
+	}
+};
+
+static bool inflateCodes(BitReader& reader, const Huffman& literals, const Huffman& distances,
+		BYTE* out, size_t outSize, size_t& produced) {
+	while (!reader.overrun) {
+		int symbol = literals.decode(reader);
+		if (symbol < 0) return false;
+		if (symbol < 256) {
+			if (produced == outSize) return false;
+			out[produced++] = (BYTE)symbol;
+			continue;
+		}
+		if (symbol == 256) return !reader.overrun;
+		symbol -= 257;
+		if (symbol >= 29) return false;
+		size_t length = lengthBases[symbol] + reader.read(lengthExtraBits[symbol]);
+		symbol = distances.decode(reader);
+		if (symbol < 0 || symbol >= 30) return false;
+		size_t distance = distanceBases[symbol] + reader.read(distanceExtraBits[symbol]);
+		if (distance > produced || length > outSize - produced) return false;
+		// The source may overlap what's being written, which repeats the last distance bytes.
+		const BYTE* source = out + produced - distance;
+		BYTE* destination = out + produced;
+		for (size_t i = 0; i < length; ++i) {
+			destination[i] = source[i];
+		}
+		produced += length;
+	}
+	return false;
+}
+
+static bool inflateDynamicBlock(BitReader& reader, BYTE* out, size_t outSize, size_t& produced) {
+	static const BYTE codeLengthOrder[19] { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	int literalCount = reader.read(5) + 257;
+	int distanceCount = reader.read(5) + 1;
+	int codeLengthCount = reader.read(4) + 4;
+	if (literalCount > 286 || distanceCount > 30) return false;
+	BYTE lengths[286 + 30] {};
+	for (int i = 0; i < codeLengthCount; ++i) {
+		lengths[codeLengthOrder[i]] = (BYTE)reader.read(3);
+	}
+	Huffman lengthCode;
+	if (!lengthCode.build(lengths, 19)) return false;
+	int index = 0;
+	while (index < literalCount + distanceCount) {
+		int symbol = lengthCode.decode(reader);
+		if (symbol < 0 || reader.overrun) return false;
+		if (symbol < 16) {
+			lengths[index++] = (BYTE)symbol;
+			continue;
+		}
+		BYTE repeated = 0;
+		int repeat;
+		if (symbol == 16) {
+			if (index == 0) return false;
+			repeated = lengths[index - 1];
+			repeat = 3 + reader.read(2);
+		} else if (symbol == 17) {
+			repeat = 3 + reader.read(3);
+		} else {
+			repeat = 11 + reader.read(7);
+		}
+		if (index + repeat > literalCount + distanceCount) return false;
+		memset(lengths + index, repeated, repeat);
+		index += repeat;
+	}
+	if (lengths[256] == 0) return false;
+	Huffman literals;
+	Huffman distances;
+	return literals.build(lengths, literalCount)
+		&& distances.build(lengths + literalCount, distanceCount)
+		&& inflateCodes(reader, literals, distances, out, outSize, produced);
+}
+
+static bool inflate(BitReader& reader, BYTE* out, size_t outSize, size_t& produced) {
+	static const FixedCodes fixedCodes;
+	produced = 0;
+	bool isLast;
+	do {
+		isLast = reader.read(1) != 0;
+		unsigned int type = reader.read(2);
+		if (type == 0) {
+			const BYTE* ptr = reader.alignToByte();
+			if (reader.bytesLeft() < 4) return false;
+			unsigned int length = ptr[0] | (ptr[1] << 8);
+			unsigned int lengthComplement = ptr[2] | (ptr[3] << 8);
+			if ((length ^ 0xFFFF) != lengthComplement
+					|| reader.bytesLeft() - 4 < length || outSize - produced < length) {
+				return false;
+			}
+			memcpy(out + produced, ptr + 4, length);
+			produced += length;
+			reader.skipBytes(4 + length);
+		} else if (type == 1) {
+			if (!inflateCodes(reader, fixedCodes.literals, fixedCodes.distances, out, outSize, produced)) return false;
+		} else if (type == 2) {
+			if (!inflateDynamicBlock(reader, out, outSize, produced)) return false;
+		} else {
+			return false;
+		}
+	} while (!isLast && !reader.overrun);
+	return !reader.overrun;
+}
+
+static unsigned int adler32(const BYTE* data, size_t size) {
+	unsigned int a = 1;
+	unsigned int b = 0;
+	while (size) {
+		// The largest run after which b can't overflow yet.
+		size_t run = size < 5552 ? size : 5552;
+		size -= run;
+		while (run--) {
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+bool zlibDecompress(const BYTE* in, size_t inSize, BYTE* out, size_t outSize) {
+	if (inSize < 6) return false;
+	BYTE method = in[0];
+	BYTE flags = in[1];
+	// Deflate, and no preset dictionary.
+	if ((method & 0x0F) != 8 || (method * 256 + flags) % 31 != 0 || (flags & 0x20) != 0) return false;
+	BitReader reader(in + 2, inSize - 2);
+	size_t produced;
+	if (!inflate(reader, out, outSize, produced) || produced != outSize) return false;
+	const BYTE* checksum = reader.alignToByte();
+	if (reader.bytesLeft() < 4) return false;
+	unsigned int expected = (checksum[0] << 24) | (checksum[1] << 16) | (checksum[2] << 8) | checksum[3];
+	return adler32(out, outSize) == expected;
+}
+
+// LZO1X is a sequence of instructions, each a match (copy from earlier output) followed by 0 to 3 literals,
+// or a run of 4 or more literals. What the first byte of an instruction means depends on how many literals
+// the previous instruction copied: 0, 1 to 3, or 4 and more.
+bool lzoDecompress(const BYTE* in, size_t inSize, BYTE* out, size_t outSize) {
+	const BYTE* ip = in;
+	const BYTE* const ipEnd = in + inSize;
+	BYTE* op = out;
+	BYTE* const opEnd = out + outSize;
+	// Long lengths continue with a byte per 255 and end with a non-zero byte.
+	auto readLongLength = [&](size_t length) -> size_t {
+		while (ip != ipEnd && *ip == 0) {
+			length += 255;
+			++ip;
+		}
+		if (ip == ipEnd) return 0;
+		return length + *ip++;
+	};
+	auto copyLiterals = [&](size_t count) -> bool {
+		if ((size_t)(ipEnd - ip) < count || (size_t)(opEnd - op) < count) return false;
+		memcpy(op, ip, count);
+		ip += count;
+		op += count;
+		return true;
+	};
+	int state = 0;
+	if (ip != ipEnd && *ip > 17) {
+		size_t count = *ip++ - 17;
+		if (!copyLiterals(count)) return false;
+		state = count < 4 ? (int)count : 4;
+	}
+	while (true) {
+		if (ip == ipEnd) return false;
+		unsigned int instruction = *ip++;
+		size_t length;
+		size_t distance;
+		unsigned int literalsAfter;
+		if (instruction < 16) {
+			if (state == 0) {
+				length = instruction ? instruction : readLongLength(15);
+				if (!length || !copyLiterals(length + 3)) return false;
+				state = 4;
+				continue;
+			}
+			if (ip == ipEnd) return false;
+			distance = (instruction >> 2) + (*ip++ << 2) + 1;
+			if (state == 4) {
+				distance += 0x800;
+				length = 3;
+			} else {
+				length = 2;
+			}
+			literalsAfter = instruction & 3;
+		} else if (instruction >= 64) {
+			if (ip == ipEnd) return false;
+			length = (instruction >> 5) + 1;
+			distance = ((instruction >> 2) & 7) + (*ip++ << 3) + 1;
+			literalsAfter = instruction & 3;
+		} else {
+			bool isFar = instruction < 32;
+			if (isFar) {
+				length = (instruction & 7) ? (instruction & 7) : readLongLength(7);
+			} else {
+				length = (instruction & 31) ? (instruction & 31) : readLongLength(31);
+			}
+			if (!length || ipEnd - ip < 2) return false;
+			length += 2;
+			distance = (ip[0] >> 2) + (ip[1] << 6);
+			literalsAfter = ip[0] & 3;
+			ip += 2;
+			if (isFar) {
+				distance += (instruction & 8) << 11;
+				if (distance == 0) {
+					// The end of stream marker.
+					return ip == ipEnd && op == opEnd;
+				}
+				distance += 0x4000;
+			} else {
+				distance += 1;
+			}
+		}
+		if (distance > (size_t)(op - out) || length > (size_t)(opEnd - op)) return false;
+		const BYTE* source = op - distance;
+		for (size_t i = 0; i < length; ++i) {
+			op[i] = source[i];
+		}
+		op += length;
+		if (!copyLiterals(literalsAfter)) return false;
+		state = (int)literalsAfter;
+	}
+}
+
+bool isCompressionSupported(DWORD compressionFlags) {
+	return isDecompressionSupported(compressionFlags);
+}
+
+bool compressBlock(DWORD compressionFlags, const BYTE* in, size_t inSize, std::vector<BYTE>& out) {
+	switch (compressionFlags & COMPRESS_METHOD_MASK) {
+	case COMPRESS_ZLIB: zlibCompress(in, inSize, out); return true;
+	case COMPRESS_LZO: lzoCompress(in, inSize, out); return true;
+	default: return false;
+	}
+}
+
+// Packs bits starting from the least significant one, the way BitReader reads them.
+class BitWriter {
+public:
+	BitWriter(std::vector<BYTE>& out) : out(out) { }
+	void write(unsigned int value, int count) {
+		bits |= (unsigned long long)value << bitCount;
+		bitCount += count;
+		while (bitCount >= 8) {
+			out.push_back((BYTE)bits);
+			bits >>= 8;
+			bitCount -= 8;
+		}
+	}
+	void flush() {
+		if (bitCount) out.push_back((BYTE)bits);
+		bits = 0;
+		bitCount = 0;
+	}
+private:
+	std::vector<BYTE>& out;
+	unsigned long long bits = 0;
+	int bitCount = 0;
+};
+
+// Huffman code lengths for the given frequencies. Returns false if some code would be longer than maxLength.
+static bool computeCodeLengths(const std::vector<unsigned int>& frequencies, int maxLength, BYTE* lengths) {
+	struct Node {
+		unsigned int frequency;
+		int children[2];
+	};
+	std::vector<Node> nodes;
+	std::vector<std::pair<unsigned int, int>> heap;
+	for (int symbol = 0; symbol < (int)frequencies.size(); ++symbol) {
+		lengths[symbol] = 0;
+		if (frequencies[symbol]) {
+			nodes.push_back({ frequencies[symbol], { -1, symbol } });
+			heap.emplace_back(frequencies[symbol], (int)nodes.size() - 1);
+		}
+	}
+	if (nodes.empty()) return true;
+	if (nodes.size() == 1) {
+		lengths[nodes[0].children[1]] = 1;
+		return true;
+	}
+	auto greater = [](const std::pair<unsigned int, int>& a, const std::pair<unsigned int, int>& b) {
+		return a.first > b.first || a.first == b.first && a.second > b.second;
+	};
+	std::make_heap(heap.begin(), heap.end(), greater);
+	while (heap.size() > 1) {
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		std::pair<unsigned int, int> a = heap.back();
+		heap.pop_back();
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		std::pair<unsigned int, int> b = heap.back();
+		heap.pop_back();
+		nodes.push_back({ a.first + b.first, { a.second, b.second } });
+		heap.emplace_back(a.first + b.first, (int)nodes.size() - 1);
+		std::push_heap(heap.begin(), heap.end(), greater);
+	}
+	std::vector<std::pair<int, int>> stack { { heap[0].second, 0 } };
+	while (!stack.empty()) {
+		std::pair<int, int> item = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[item.first];
+		if (node.children[0] < 0) {
+			if (item.second > maxLength) return false;
+			lengths[node.children[1]] = (BYTE)item.second;
+		} else {
+			stack.emplace_back(node.children[0], item.second + 1);
+			stack.emplace_back(node.children[1], item.second + 1);
+		}
+	}
+	return true;
+}
+
+// Canonical Huffman codes with at most maxLength bits, bit-reversed, ready for BitWriter.
+static void buildCodes(const unsigned int* frequencies, int symbolCount, int maxLength,
+		BYTE* lengths, unsigned short* codes) {
+	std::vector<unsigned int> scaled(frequencies, frequencies + symbolCount);
+	// Flattening the frequencies until the longest code fits loses very little compression.
+	while (!computeCodeLengths(scaled, maxLength, lengths)) {
+		for (unsigned int& frequency : scaled) {
+			frequency = (frequency + 1) / 2;
+		}
+	}
+	int lengthCounts[Huffman::maxBits + 1] {};
+	for (int symbol = 0; symbol < symbolCount; ++symbol) {
+		++lengthCounts[lengths[symbol]];
+	}
+	lengthCounts[0] = 0;
+	int nextCodes[Huffman::maxBits + 1] {};
+	int code = 0;
+	for (int length = 1; length <= Huffman::maxBits; ++length) {
+		code = (code + lengthCounts[length - 1]) << 1;
+		nextCodes[length] = code;
+	}
+	for (int symbol = 0; symbol < symbolCount; ++symbol) {
+		int length = lengths[symbol];
+		if (!length) continue;
+		int value = nextCodes[length]++;
+		int reversed = 0;
+		for (int bit = 0; bit < length; ++bit) {
+			reversed |= ((value >> bit) & 1) << (length - 1 - bit);
+		}
+		codes[symbol] = (unsigned short)reversed;
+	}
+}
+
+struct DeflateCodeTables {
+	BYTE lengthCodes[259];
+	BYTE distanceCodes[32769];
+	DeflateCodeTables() {
+		for (int length = 3; length <= 258; ++length) {
+			int code = 28;
+			while (lengthBases[code] > length) --code;
+			lengthCodes[length] = (BYTE)code;
+		}
+		int code = 0;
+		for (int distance = 1; distance <= 32768; ++distance) {
+			if (code < 29 && distanceBases[code + 1] <= distance) ++code;
+			distanceCodes[distance] = (BYTE)code;
+		}
+	}
+};
+
+// Finds repeats with hash chains, taking a match one byte later if it's longer (lazy matching).
+// Literals are stored as their value, matches as length << 16 | distance.
+static void findMatches(const BYTE* in, size_t inSize, std::vector<unsigned int>& tokens) {
+	const int hashBits = 15;
+	const int maxChainLength = 48;
+	const size_t windowSize = 32768;
+	std::vector<int> head(1 << hashBits, -1);
+	std::vector<int> previous(inSize);
+	auto hash = [&](size_t position) {
+		unsigned int value = in[position] | (in[position + 1] << 8) | (in[position + 2] << 16);
+		return (value * 2654435761u) >> (32 - hashBits);
+	};
+	auto findLongest = [&](size_t position, int& bestLength, int& bestDistance) {
+		bestLength = 0;
+		bestDistance = 0;
+		size_t maxLength = (std::min)(inSize - position, (size_t)258);
+		int candidate = head[hash(position)];
+		for (int chain = 0; chain < maxChainLength && candidate >= 0; ++chain) {
+			if (position - candidate > windowSize) break;
+			if (in[candidate + bestLength] == in[position + bestLength]) {
+				size_t length = 0;
+				while (length < maxLength && in[candidate + length] == in[position + length]) ++length;
+				if ((int)length > bestLength) {
+					bestLength = (int)length;
+					bestDistance = (int)(position - candidate);
+					if (length == maxLength) break;
+				}
+			}
+			candidate = previous[candidate];
+		}
+	};
+	auto insert = [&](size_t position) {
+		unsigned int h = hash(position);
+		previous[position] = head[h];
+		head[h] = (int)position;
+	};
+	tokens.clear();
+	size_t position = 0;
+	while (position < inSize) {
+		int length = 0;
+		int distance = 0;
+		if (position + 3 <= inSize) {
+			findLongest(position, length, distance);
+			insert(position);
+		}
+		if (length >= 3 && length < 32 && position + 4 <= inSize) {
+			int nextLength;
+			int nextDistance;
+			findLongest(position + 1, nextLength, nextDistance);
+			if (nextLength > length) {
+				tokens.push_back(in[position]);
+				++position;
+				continue;
+			}
+		}
+		if (length >= 3) {
+			tokens.push_back(((unsigned int)length << 16) | distance);
+			for (size_t inserted = position + 1; inserted < position + length && inserted + 3 <= inSize; ++inserted) {
+				insert(inserted);
+			}
+			position += length;
+		} else {
+			tokens.push_back(in[position]);
+			++position;
+		}
+	}
+}
+
+static void writeStoredBlocks(const BYTE* in, size_t inSize, std::vector<BYTE>& out) {
+	size_t done = 0;
+	do {
+		size_t length = (std::min)(inSize - done, (size_t)0xFFFF);
+		out.push_back(done + length == inSize ? 1 : 0);
+		out.push_back((BYTE)length);
+		out.push_back((BYTE)(length >> 8));
+		out.push_back((BYTE)~length);
+		out.push_back((BYTE)(~length >> 8));
+		out.insert(out.end(), in + done, in + done + length);
+		done += length;
+	} while (done < inSize);
+}
+
+void zlibCompress(const BYTE* in, size_t inSize, std::vector<BYTE>& out) {
+	static const DeflateCodeTables tables;
+	static const BYTE codeLengthOrder[19] { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	out.clear();
+	out.push_back(0x78);
+	out.push_back(0x9C);
+	std::vector<unsigned int> tokens;
+	findMatches(in, inSize, tokens);
+
+	unsigned int literalFrequencies[286] {};
+	unsigned int distanceFrequencies[30] {};
+	for (unsigned int token : tokens) {
+		if (token < 256) {
+			++literalFrequencies[token];
+		} else {
+			++literalFrequencies[257 + tables.lengthCodes[token >> 16]];
+			++distanceFrequencies[tables.distanceCodes[token & 0xFFFF]];
+		}
+	}
+	literalFrequencies[256] = 1;
+	BYTE lengths[286 + 30];
+	unsigned short literalCodes[286];
+	unsigned short distanceCodes[30];
+	buildCodes(literalFrequencies, 286, 15, lengths, literalCodes);
+	buildCodes(distanceFrequencies, 30, 15, lengths + 286, distanceCodes);
+	int literalCount = 286;
+	while (lengths[literalCount - 1] == 0) --literalCount;
+	int distanceCount = 30;
+	while (distanceCount > 1 && lengths[286 + distanceCount - 1] == 0) --distanceCount;
+	if (distanceCount == 1 && lengths[286] == 0) {
+		// No matches at all. Decoders still expect at least one distance code.
+		lengths[286] = 1;
+		distanceCodes[0] = 0;
+	}
+
+	// The code lengths are themselves sent run-length encoded with a third Huffman code.
+	BYTE allLengths[286 + 30];
+	memcpy(allLengths, lengths, literalCount);
+	memcpy(allLengths + literalCount, lengths + 286, distanceCount);
+	const int allCount = literalCount + distanceCount;
+	struct LengthSymbol {
+		BYTE symbol;
+		BYTE extra;
+	};
+	std::vector<LengthSymbol> lengthSymbols;
+	for (int i = 0; i < allCount; ) {
+		BYTE value = allLengths[i];
+		int run = 1;
+		while (i + run < allCount && allLengths[i + run] == value) ++run;
+		i += run;
+		if (value == 0) {
+			while (run >= 11) {
+				int repeat = (std::min)(run, 138);
+				lengthSymbols.push_back({ 18, (BYTE)(repeat - 11) });
+				run -= repeat;
+			}
+			if (run >= 3) {
+				lengthSymbols.push_back({ 17, (BYTE)(run - 3) });
+				run = 0;
+			}
+		} else {
+			lengthSymbols.push_back({ value, 0 });
+			--run;
+			while (run >= 3) {
+				int repeat = (std::min)(run, 6);
+				lengthSymbols.push_back({ 16, (BYTE)(repeat - 3) });
+				run -= repeat;
+			}
+		}
+		while (run-- > 0) {
+			lengthSymbols.push_back({ value, 0 });
+		}
+	}
+	unsigned int codeLengthFrequencies[19] {};
+	for (const LengthSymbol& lengthSymbol : lengthSymbols) {
+		++codeLengthFrequencies[lengthSymbol.symbol];
+	}
+	// A code with a single symbol would be incomplete, which zlib refuses for this code.
+	int usedCodeLengthSymbols = 0;
+	for (unsigned int frequency : codeLengthFrequencies) {
+		if (frequency) ++usedCodeLengthSymbols;
+	}
+	if (usedCodeLengthSymbols < 2) {
+		++codeLengthFrequencies[codeLengthFrequencies[0] ? 1 : 0];
+	}
+	BYTE codeLengthLengths[19];
+	unsigned short codeLengthCodes[19];
+	buildCodes(codeLengthFrequencies, 19, 7, codeLengthLengths, codeLengthCodes);
+	int codeLengthCount = 19;
+	while (codeLengthCount > 4 && codeLengthLengths[codeLengthOrder[codeLengthCount - 1]] == 0) --codeLengthCount;
+
+	BitWriter writer(out);
+	writer.write(1, 1);
+	writer.write(2, 2);
+	writer.write(literalCount - 257, 5);
+	writer.write(distanceCount - 1, 5);
+	writer.write(codeLengthCount - 4, 4);
+	for (int i = 0; i < codeLengthCount; ++i) {
+		writer.write(codeLengthLengths[codeLengthOrder[i]], 3);
+	}
+	static const BYTE repeatExtraBits[3] { 2, 3, 7 };
+	for (const LengthSymbol& lengthSymbol : lengthSymbols) {
+		writer.write(codeLengthCodes[lengthSymbol.symbol], codeLengthLengths[lengthSymbol.symbol]);
+		if (lengthSymbol.symbol >= 16) {
+			writer.write(lengthSymbol.extra, repeatExtraBits[lengthSymbol.symbol - 16]);
+		}
+	}
+	const BYTE* distanceLengths = lengths + 286;
+	for (unsigned int token : tokens) {
+		if (token < 256) {
+			writer.write(literalCodes[token], lengths[token]);
+			continue;
+		}
+		int length = token >> 16;
+		int distance = token & 0xFFFF;
+		int lengthCode = tables.lengthCodes[length];
+		writer.write(literalCodes[257 + lengthCode], lengths[257 + lengthCode]);
+		writer.write(length - lengthBases[lengthCode], lengthExtraBits[lengthCode]);
+		int distanceCode = tables.distanceCodes[distance];
+		writer.write(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+		writer.write(distance - distanceBases[distanceCode], distanceExtraBits[distanceCode]);
+	}
+	writer.write(literalCodes[256], lengths[256]);
+	writer.flush();
+
+	// Data that doesn't compress is better off stored as is.
+	size_t storedSize = 2 + inSize + 5 * (inSize / 0xFFFF + 1);
+	if (out.size() > storedSize) {
+		out.resize(2);
+		writeStoredBlocks(in, inSize, out);
+	}
+	unsigned int checksum = adler32(in, inSize);
+	out.push_back((BYTE)(checksum >> 24));
+	out.push_back((BYTE)(checksum >> 16));
+	out.push_back((BYTE)(checksum >> 8));
+	out.push_back((BYTE)checksum);
+}
+
+void lzoCompress(const BYTE* in, size_t inSize, std::vector<BYTE>& out) {
+	const int hashBits = 14;
+	const size_t maxDistance = 0xBFFF;
+	out.clear();
+	out.reserve(inSize + inSize / 16 + 64 + 3);
+	std::vector<int> dictionary(1 << hashBits, -1);
+	// The byte of the last match whose low 2 bits hold the count of up to 3 literals following it.
+	size_t literalCountPosition = 0;
+	auto putLongLength = [&](size_t length) {
+		while (length > 255) {
+			length -= 255;
+			out.push_back(0);
+		}
+		out.push_back((BYTE)length);
+	};
+	auto putLiterals = [&](const BYTE* literals, size_t count) {
+		if (!count) return;
+		if (out.empty() && count <= 238) {
+			out.push_back((BYTE)(17 + count));
+		} else if (count <= 3) {
+			out[literalCountPosition] |= (BYTE)count;
+		} else if (count <= 18) {
+			out.push_back((BYTE)(count - 3));
+		} else {
+			out.push_back(0);
+			putLongLength(count - 18);
+		}
+		out.insert(out.end(), literals, literals + count);
+	};
+	auto putMatch = [&](size_t distance, size_t length) {
+		if (length <= 8 && distance <= 0x800) {
+			distance -= 1;
+			out.push_back((BYTE)(((length - 1) << 5) | ((distance & 7) << 2)));
+			literalCountPosition = out.size() - 1;
+			out.push_back((BYTE)(distance >> 3));
+			return;
+		}
+		if (distance <= 0x4000) {
+			distance -= 1;
+			if (length <= 33) {
+				out.push_back((BYTE)(32 | (length - 2)));
+			} else {
+				out.push_back(32);
+				putLongLength(length - 33);
+			}
+		} else {
+			distance -= 0x4000;
+			BYTE marker = (BYTE)(16 | ((distance >> 11) & 8));
+			if (length <= 9) {
+				out.push_back((BYTE)(marker | (length - 2)));
+			} else {
+				out.push_back(marker);
+				putLongLength(length - 9);
+			}
+		}
+		literalCountPosition = out.size();
+		out.push_back((BYTE)(distance << 2));
+		out.push_back((BYTE)(distance >> 6));
+	};
+
+	size_t literalStart = 0;
+	size_t position = 0;
+	while (position + 4 <= inSize) {
+		unsigned int value;
+		memcpy(&value, in + position, 4);
+		unsigned int hash = (value * 0x1824429Du) >> (32 - hashBits);
+		int candidate = dictionary[hash];
+		dictionary[hash] = (int)position;
+		unsigned int candidateValue;
+		if (candidate >= 0 && position - candidate <= maxDistance
+				&& (memcpy(&candidateValue, in + candidate, 4), candidateValue == value)) {
+			size_t length = 4;
+			while (position + length < inSize && in[candidate + length] == in[position + length]) ++length;
+			putLiterals(in + literalStart, position - literalStart);
+			putMatch(position - candidate, length);
+			position += length;
+			literalStart = position;
+		} else {
+			// Speeds through data that doesn't compress, same as the reference implementation.
+			position += 1 + ((position - literalStart) >> 5);
+		}
+	}
+	putLiterals(in + literalStart, inSize - literalStart);
+	out.push_back(16 | 1);
+	out.push_back(0);
+	out.push_back(0);
+}
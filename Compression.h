@@ -0,0 +1,31 @@
+#pragma once
+#include "Platform.h"
+#include <vector>
+
+// Values of Summary::compressionFlags. The other bits are hints for the engine and don't change the data.
+#define COMPRESS_ZLIB				0x01
+#define COMPRESS_LZO				0x02
+#define COMPRESS_LZX				0x04
+#define COMPRESS_METHOD_MASK		0x0F
+
+// Returns false if compressionFlags name a method that can't be decompressed here.
+bool isDecompressionSupported(DWORD compressionFlags);
+
+// Decompresses one block of a compressed chunk. The block must decompress to exactly outSize bytes,
+// otherwise, or if the data is corrupt, returns false. Safe to call from several threads at once.
+bool decompressBlock(DWORD compressionFlags, const BYTE* in, size_t inSize, BYTE* out, size_t outSize);
+
+// A zlib stream (RFC 1950), checksum included.
+bool zlibDecompress(const BYTE* in, size_t inSize, BYTE* out, size_t outSize);
+// LZO1X, the format written by lzo1x_1_compress and lzo1x_999_compress.
+bool lzoDecompress(const BYTE* in, size_t inSize, BYTE* out, size_t outSize);
+
+// Compresses one block with the method in compressionFlags, replacing the contents of out.
+// Returns false if the method isn't one that can be compressed with here.
+bool compressBlock(DWORD compressionFlags, const BYTE* in, size_t inSize, std::vector<BYTE>& out);
+bool isCompressionSupported(DWORD compressionFlags);
+
+// Deflate with dynamic Huffman codes, wrapped in a zlib stream. Any zlib can decompress it.
+void zlibCompress(const BYTE* in, size_t inSize, std::vector<BYTE>& out);
+// LZO1X-1: the fast method the engine itself uses for LZO, decompressible by any LZO1X decompressor.
+void lzoCompress(const BYTE* in, size_t inSize, std::vector<BYTE>& out);
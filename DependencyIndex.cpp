@@ -0,0 +1,223 @@
+#include "DependencyIndex.h"
+#include "UpkPackage.h"
+#include "ExtractedFolderIndex.h"
+#include "MappedFile.h"
+#include "FileIo.h"
+#include "ByteCursor.h"
+#include "ThreadPool.h"
+#include "RunStats.h"
+#include <algorithm>
+#include <map>
+
+#define DEPENDENCY_INDEX_TAG 0x444B5055  // "UPKD"
+#define DEPENDENCY_INDEX_VERSION 1
+
+struct CaseInsensitiveLess {
+	bool operator()(const std::wstring& a, const std::wstring& b) const {
+		return _wcsicmp(a.c_str(), b.c_str()) < 0;
+	}
+};
+
+// The path of every import from its outermost package down. Imports whose chain of outers goes through an export
+// of the package itself aren't outside objects, and those and the ones in a loop of outers get an empty path.
+static std::vector<std::wstring> getImportPaths(const UpkPackage& package) {
+	const TableArray<Import>& imports = package.importTable.imports;
+	std::vector<std::wstring> paths(imports.size());
+	std::vector<char> states(imports.size(), 0);  // 0 - not built, 1 - being built, 2 - built
+	std::vector<int> chain;
+	for (int i = 0; i < (int)imports.size(); ++i) {
+		chain.clear();
+		bool isOutside = true;
+		int current = i;
+		while (states[current] != 2) {
+			if (states[current] == 1) {
+				isOutside = false;
+				break;
+			}
+			states[current] = 1;
+			chain.push_back(current);
+			const int outer = imports[current].outerIndex;
+			if (outer == 0) break;
+			if (outer > 0) {
+				isOutside = false;
+				break;
+			}
+			current = -outer - 1;
+		}
+		for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+			const int importIndex = *it;
+			states[importIndex] = 2;
+			if (!isOutside) continue;
+			const Import& importStruct = imports[importIndex];
+			std::wstring name = nameDataToString(package.nameTable, importStruct.objectName);
+			if (importStruct.outerIndex == 0) {
+				paths[importIndex] = std::move(name);
+			} else {
+				const std::wstring& outerPath = paths[-importStruct.outerIndex - 1];
+				if (!outerPath.empty()) {
+					paths[importIndex] = outerPath + L'.' + name;
+				}
+			}
+		}
+	}
+	return paths;
+}
+
+bool DependencyIndex::scan(LPCWSTR folder, int jobCount, bool useIndex) {
+	packages.clear();
+	objects.clear();
+	failures.clear();
+	error.clear();
+	ExtractedFolderIndex folderIndex;
+	if (!folderIndex.build(folder)) {
+		error = folderIndex.getError();
+		return false;
+	}
+	for (const ExtractedFolderIndex::File& file : folderIndex.getFiles()) {
+		const std::wstring& path = file.relativePath;
+		if (path.size() > 4 && _wcsicmp(path.c_str() + path.size() - 4, L".upk") == 0) {
+			packages.push_back(path);
+		}
+	}
+	std::sort(packages.begin(), packages.end(), CaseInsensitiveLess());
+
+	std::wstring root = folder;
+	if (!root.empty() && root[root.size() - 1] != PATH_SEPARATOR) {
+		root += PATH_SEPARATOR;
+	}
+	std::vector<std::vector<std::wstring>> packageImports(packages.size());
+	std::vector<std::wstring> errors(packages.size());
+	{
+		ScopedPhase phase("Parse packages");
+		ThreadPool pool(jobCount);
+		pool.parallelFor(packages.size(), [&](size_t packageIndex) {
+			const std::wstring path = root + packages[packageIndex];
+			UpkPackage package;
+			// Only the import table is needed, and it's in the header.
+			package.setDecompressOnDemand(true);
+			package.setLazyNames(true);
+			if (useIndex) {
+				package.setIndexPath((path + L".index").c_str());
+			}
+			if (!package.open(path.c_str())) {
+				errors[packageIndex] = package.getError();
+				return;
+			}
+			std::vector<std::wstring> paths = getImportPaths(package);
+			paths.erase(std::remove(paths.begin(), paths.end(), std::wstring()), paths.end());
+			std::sort(paths.begin(), paths.end(), CaseInsensitiveLess());
+			paths.erase(std::unique(paths.begin(), paths.end(), [](const std::wstring& a, const std::wstring& b) {
+				return _wcsicmp(a.c_str(), b.c_str()) == 0;
+			}), paths.end());
+			packageImports[packageIndex] = std::move(paths);
+		});
+	}
+
+	ScopedPhase phase("Build dependency index");
+	// The packages go in in order and import each object at most once, so every list of importers comes out sorted.
+	std::map<std::wstring, std::vector<int>, CaseInsensitiveLess> importers;
+	for (int packageIndex = 0; packageIndex < (int)packages.size(); ++packageIndex) {
+		if (!errors[packageIndex].empty()) {
+			failures.push_back(Failure { packages[packageIndex], errors[packageIndex] });
+			continue;
+		}
+		for (std::wstring& path : packageImports[packageIndex]) {
+			importers[std::move(path)].push_back(packageIndex);
+		}
+	}
+	objects.reserve(importers.size());
+	for (auto& entry : importers) {
+		objects.push_back(ImportedObject { entry.first, std::move(entry.second) });
+	}
+	return true;
+}
+
+const std::vector<int>& DependencyIndex::findDependents(const std::wstring& objectPath) const {
+	static const std::vector<int> none;
+	auto found = std::lower_bound(objects.begin(), objects.end(), objectPath,
+		[](const ImportedObject& object, const std::wstring& path) {
+			return _wcsicmp(object.path.c_str(), path.c_str()) < 0;
+		});
+	if (found == objects.end() || _wcsicmp(found->path.c_str(), objectPath.c_str()) != 0) return none;
+	return found->importers;
+}
+
+int DependencyIndex::findExportingPackage(const std::wstring& objectPath) const {
+	const std::wstring packageName = objectPath.substr(0, objectPath.find(L'.'));
+	for (int packageIndex = 0; packageIndex < (int)packages.size(); ++packageIndex) {
+		const std::wstring& path = packages[packageIndex];
+		size_t nameStart = path.rfind(PATH_SEPARATOR);
+		nameStart = nameStart == std::wstring::npos ? 0 : nameStart + 1;
+		const size_t nameLength = path.size() - 4 - nameStart;
+		if (nameLength == packageName.size()
+				&& _wcsnicmp(path.c_str() + nameStart, packageName.c_str(), nameLength) == 0) {
+			return packageIndex;
+		}
+	}
+	return -1;
+}
+
+bool DependencyIndex::load(LPCWSTR path) {
+	ScopedPhase phase("Load dependency index");
+	packages.clear();
+	objects.clear();
+	failures.clear();
+	MappedFile file;
+	if (!file.open(path)) return false;
+	ByteCursor cursor(file.data(), file.size());
+	unsigned int tag = 0;
+	unsigned int version = 0;
+	cursor.read(tag);
+	cursor.read(version);
+	if (tag != DEPENDENCY_INDEX_TAG || version != DEPENDENCY_INDEX_VERSION) return false;
+	// Every string and list takes at least 4 bytes, which keeps a broken count from allocating too much.
+	unsigned int packageCount = 0;
+	cursor.read(packageCount);
+	if (cursor.overrun || packageCount > (cursor.size() - cursor.tell()) / 4) return false;
+	packages.resize(packageCount);
+	for (std::wstring& packagePath : packages) {
+		cursor.readString(packagePath);
+	}
+	unsigned int objectCount = 0;
+	cursor.read(objectCount);
+	if (cursor.overrun || objectCount > (cursor.size() - cursor.tell()) / 8) return false;
+	objects.resize(objectCount);
+	for (ImportedObject& object : objects) {
+		cursor.readString(object.path);
+		unsigned int importerCount = 0;
+		cursor.read(importerCount);
+		if (cursor.overrun || importerCount > (cursor.size() - cursor.tell()) / 4) return false;
+		object.importers.resize(importerCount);
+		for (int& packageIndex : object.importers) {
+			cursor.read(packageIndex);
+			if (packageIndex < 0 || (unsigned int)packageIndex >= packageCount) return false;
+		}
+	}
+	// findDependents searches the objects by halves, which only works if they're still sorted by path.
+	for (size_t objectIndex = 1; objectIndex < objects.size(); ++objectIndex) {
+		if (_wcsicmp(objects[objectIndex - 1].path.c_str(), objects[objectIndex].path.c_str()) >= 0) return false;
+	}
+	return !cursor.overrun;
+}
+
+bool DependencyIndex::save(LPCWSTR path) const {
+	ScopedPhase phase("Save dependency index");
+	std::vector<BYTE> buffer;
+	ByteWriter writer(buffer);
+	writer.write((unsigned int)DEPENDENCY_INDEX_TAG);
+	writer.write((unsigned int)DEPENDENCY_INDEX_VERSION);
+	writer.write((unsigned int)packages.size());
+	for (const std::wstring& packagePath : packages) {
+		writer.writeString(packagePath);
+	}
+	writer.write((unsigned int)objects.size());
+	for (const ImportedObject& object : objects) {
+		writer.writeString(object.path);
+		writer.write((unsigned int)object.importers.size());
+		for (int packageIndex : object.importers) {
+			writer.write(packageIndex);
+		}
+	}
+
+	return saveFileAtomically(path, buffer.data(), buffer.size());
+}
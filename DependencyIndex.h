@@ -0,0 +1,43 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+
+// Which packages of a whole folder of cooked packages import which outside objects, inverted so that
+// "who depends on X" is a binary search. Objects are known by their path from the outermost package down,
+// like Engine.Default__Texture2D, and since an import always comes with imports of its outers, the path of
+// a package alone, like Engine, finds every package that imports anything from it.
+class DependencyIndex {
+public:
+	struct Failure {
+		std::wstring path;
+		std::wstring error;
+	};
+	// Parses every .upk file in the folder and its subfolders on jobCount threads, 0 meaning one per hardware thread.
+	// With useIndex, the packages' tables come from their sidecar indices, see UpkPackage::setIndexPath.
+	// Packages that fail to parse are left out and listed in getFailures. Returns false only if the folder can't be listed.
+	bool scan(LPCWSTR folder, int jobCount, bool useIndex);
+	// Returns false if the file doesn't exist or isn't a dependency index of this version.
+	bool load(LPCWSTR path);
+	// Writes to a temporary file first and then replaces the old index with it. On failure WinError holds the reason.
+	bool save(LPCWSTR path) const;
+	// Indices into getPackages() of the packages that import the object, in path order. Ignores case.
+	const std::vector<int>& findDependents(const std::wstring& objectPath) const;
+	// The scanned package whose file name is the outermost package of the path, or -1 if none was scanned.
+	int findExportingPackage(const std::wstring& objectPath) const;
+	// Relative to the scanned folder.
+	const std::vector<std::wstring>& getPackages() const { return packages; }
+	size_t getObjectCount() const { return objects.size(); }
+	const std::vector<Failure>& getFailures() const { return failures; }
+	const std::wstring& getError() const { return error; }
+private:
+	struct ImportedObject {
+		std::wstring path;
+		std::vector<int> importers;
+	};
+	std::vector<std::wstring> packages;
+	// Sorted by path, ignoring case.
+	std::vector<ImportedObject> objects;
+	std::vector<Failure> failures;
+	std::wstring error;
+};
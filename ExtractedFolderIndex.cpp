@@ -0,0 +1,60 @@
+#include "ExtractedFolderIndex.h"
+#include "WinError.h"
+#include "FileIo.h"
+#include "RunStats.h"
+#include <cwctype>
+
+std::wstring ExtractedFolderIndex::makeKey(const std::wstring& relativePath) {
+	std::wstring key = relativePath;
+	for (wchar_t& c : key) {
+		c = towupper(c);
+	}
+	return key;
+}
+
+bool ExtractedFolderIndex::build(LPCWSTR folder) {
+	ScopedPhase phase("List extracted folder");
+	files.clear();
+	fileIndices.clear();
+	error.clear();
+	std::wstring root = folder;
+	if (!root.empty() && root[root.size() - 1] == PATH_SEPARATOR) {
+		root.resize(root.size() - 1);
+	}
+	if (!listFolder(root, std::wstring())) return false;
+	fileIndices.reserve(files.size());
+	for (int fileIndex = 0; fileIndex < (int)files.size(); ++fileIndex) {
+		fileIndices.emplace(makeKey(files[fileIndex].relativePath), fileIndex);
+	}
+	return true;
+}
+
+bool ExtractedFolderIndex::listFolder(const std::wstring& folder, const std::wstring& relativeFolder) {
+	std::vector<FolderEntry> entries;
+	if (!::listFolder(folder.c_str(), entries)) {
+		WinError err;
+		error = L"Failed to list the folder " + folder + L": " + err.getMessage();
+		return false;
+	}
+	std::vector<std::wstring> subfolders;
+	for (FolderEntry& entry : entries) {
+		if (entry.isFolder) {
+			subfolders.push_back(std::move(entry.name));
+			continue;
+		}
+		File file;
+		file.relativePath = relativeFolder + entry.name;
+		file.size = entry.size;
+		file.writeTime = entry.writeTime;
+		files.push_back(std::move(file));
+	}
+	for (const std::wstring& subfolder : subfolders) {
+		if (!listFolder(folder + PATH_SEPARATOR + subfolder, relativeFolder + subfolder + PATH_SEPARATOR)) return false;
+	}
+	return true;
+}
+
+int ExtractedFolderIndex::find(const std::wstring& relativePath) const {
+	auto found = fileIndices.find(makeKey(relativePath));
+	return found == fileIndices.end() ? -1 : found->second;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Every file in an extracted folder and its subfolders, listed once up front, so finding the file of an export
+// is a hash lookup instead of a filesystem call per export. Lookups ignore case, same as the filesystem.
+class ExtractedFolderIndex {
+public:
+	struct File {
+		// Relative to the folder, with PATH_SEPARATOR between the parts.
+		std::wstring relativePath;
+		unsigned long long size = 0;
+		// FILETIME of the last write, as one number.
+		unsigned long long writeTime = 0;
+	};
+	// Lists the folder. On failure returns false and getError() says why.
+	bool build(LPCWSTR folder);
+	const std::wstring& getError() const { return error; }
+	// The index of the file in getFiles(), or -1 if there's no such file. Safe to call from several threads at once.
+	int find(const std::wstring& relativePath) const;
+	const std::vector<File>& getFiles() const { return files; }
+private:
+	bool listFolder(const std::wstring& folder, const std::wstring& relativeFolder);
+	static std::wstring makeKey(const std::wstring& relativePath);
+	std::vector<File> files;
+	std::unordered_map<std::wstring, int> fileIndices;
+	std::wstring error;
+};
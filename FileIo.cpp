@@ -0,0 +1,768 @@
+#include "FileIo.h"
+#include "RunStats.h"
+#include <algorithm>
+#ifndef _WIN32
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING
+#include <atomic>
+#include <memory>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Reads and writes are split so that no single call is bigger than this, since ReadFile and WriteFile take a DWORD
+// and pread and pwrite may do only part of a big one anyway.
+static const size_t maxCallSize = 0x40000000;
+
+#ifdef _WIN32
+
+static unsigned long long fileTimeToNumber(const FILETIME& fileTime) {
+	return ((unsigned long long)fileTime.dwHighDateTime << 32) | fileTime.dwLowDateTime;
+}
+
+File::~File() {
+	close();
+}
+
+bool File::open(LPCWSTR path, FileMode mode, FileAccessHint hint) {
+	close();
+	DWORD access = GENERIC_READ | GENERIC_WRITE;
+	DWORD shareMode = NULL;
+	DWORD disposition = OPEN_EXISTING;
+	switch (mode) {
+	case FILE_MODE_READ:
+		access = GENERIC_READ;
+		shareMode = FILE_SHARE_READ;
+		break;
+	case FILE_MODE_CREATE_NEW: disposition = CREATE_NEW; break;
+	case FILE_MODE_CREATE_ALWAYS: disposition = CREATE_ALWAYS; break;
+	case FILE_MODE_OPEN_ALWAYS: disposition = OPEN_ALWAYS; break;
+	}
+	DWORD flags = FILE_ATTRIBUTE_NORMAL;
+	if (hint == FILE_HINT_SEQUENTIAL) flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+	if (hint == FILE_HINT_RANDOM) flags |= FILE_FLAG_RANDOM_ACCESS;
+	handle = CreateFileW(path, access, shareMode, NULL, disposition, flags, NULL);
+	return handle != INVALID_HANDLE_VALUE;
+}
+
+void File::close() {
+	if (handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(handle);
+		handle = INVALID_HANDLE_VALUE;
+	}
+}
+
+bool File::isOpen() const {
+	return handle != INVALID_HANDLE_VALUE;
+}
+
+bool File::readAt(void* data, size_t size, unsigned long long offset, size_t& bytesRead) {
+	bytesRead = 0;
+	while (bytesRead < size) {
+		OVERLAPPED overlapped{};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD callBytesRead = 0;
+		if (!ReadFile(handle, (BYTE*)data + bytesRead, (DWORD)(std::min)(size - bytesRead, maxCallSize),
+				&callBytesRead, &overlapped)) {
+			// Reading at or past the end with an offset fails with this rather than reading nothing.
+			if (GetLastError() == ERROR_HANDLE_EOF) break;
+			return false;
+		}
+		if (!callBytesRead) break;
+		bytesRead += callBytesRead;
+		offset += callBytesRead;
+	}
+	return true;
+}
+
+bool File::writeAt(const void* data, size_t size, unsigned long long offset) {
+	size_t bytesWritten = 0;
+	while (bytesWritten < size) {
+		OVERLAPPED overlapped{};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD callSize = (DWORD)(std::min)(size - bytesWritten, maxCallSize);
+		DWORD callBytesWritten = 0;
+		if (!WriteFile(handle, (const BYTE*)data + bytesWritten, callSize, &callBytesWritten, &overlapped)) return false;
+		if (callBytesWritten != callSize) {
+			SetLastError(ERROR_WRITE_FAULT);
+			return false;
+		}
+		bytesWritten += callBytesWritten;
+		offset += callBytesWritten;
+	}
+	return true;
+}
+
+bool File::getSize(unsigned long long& size) {
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize)) return false;
+	size = (unsigned long long)fileSize.QuadPart;
+	return true;
+}
+
+bool File::setSize(unsigned long long size) {
+	// Space for the part that grows is reserved on disk first. Where the file system can't, only the size is set.
+	unsigned long long oldSize = 0;
+	if (getSize(oldSize) && size > oldSize) {
+		FILE_ALLOCATION_INFO allocation;
+		allocation.AllocationSize.QuadPart = (LONGLONG)size;
+		SetFileInformationByHandle(handle, FileAllocationInfo, &allocation, sizeof allocation);
+	}
+	// Unlike SetEndOfFile, doesn't go through the shared file pointer.
+	FILE_END_OF_FILE_INFO info;
+	info.EndOfFile.QuadPart = (LONGLONG)size;
+	return SetFileInformationByHandle(handle, FileEndOfFileInfo, &info, sizeof info) != FALSE;
+}
+
+bool File::getWriteTime(unsigned long long& writeTime) {
+	FILETIME fileTime;
+	if (!GetFileTime(handle, NULL, NULL, &fileTime)) return false;
+	writeTime = fileTimeToNumber(fileTime);
+	return true;
+}
+
+bool File::setWriteTime(unsigned long long writeTime) {
+	FILETIME fileTime;
+	fileTime.dwLowDateTime = (DWORD)writeTime;
+	fileTime.dwHighDateTime = (DWORD)(writeTime >> 32);
+	return SetFileTime(handle, NULL, NULL, &fileTime) != FALSE;
+}
+
+bool listFolder(LPCWSTR folder, std::vector<FolderEntry>& entries) {
+	std::wstring pattern = folder;
+	if (!pattern.empty() && pattern[pattern.size() - 1] != PATH_SEPARATOR) {
+		pattern += PATH_SEPARATOR;
+	}
+	pattern += L'*';
+	WIN32_FIND_DATAW findData;
+	HANDLE findHandle = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &findData,
+		FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+	if (findHandle == INVALID_HANDLE_VALUE) return false;
+	do {
+		// The call that found this entry. The last call, which finds nothing, is counted after the loop.
+		addRunStat(STAT_FOLDER_LIST_CALLS);
+		if (wcscmp(findData.cFileName, L".") == 0 || wcscmp(findData.cFileName, L"..") == 0) continue;
+		FolderEntry entry;
+		entry.name = findData.cFileName;
+		entry.isFolder = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		entry.size = ((unsigned long long)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+		entry.writeTime = fileTimeToNumber(findData.ftLastWriteTime);
+		entries.push_back(std::move(entry));
+	} while (FindNextFileW(findHandle, &findData));
+	DWORD err = GetLastError();
+	addRunStat(STAT_FOLDER_LIST_CALLS);
+	FindClose(findHandle);
+	SetLastError(err);
+	return err == ERROR_NO_MORE_FILES;
+}
+
+bool createFolder(LPCWSTR path) {
+	return CreateDirectoryW(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+bool deleteFile(LPCWSTR path) {
+	return DeleteFileW(path) || GetLastError() == ERROR_FILE_NOT_FOUND;
+}
+
+static bool replaceFile(LPCWSTR from, LPCWSTR to) {
+	return MoveFileExW(from, to, MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
+
+static DWORD getLastSystemError() {
+	return GetLastError();
+}
+
+static void setLastSystemError(DWORD err) {
+	SetLastError(err);
+}
+
+bool getFileInfo(LPCWSTR path, unsigned long long& size, unsigned long long& writeTime) {
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExW(path, GetFileExInfoStandard, &attributes)) return false;
+	size = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	writeTime = fileTimeToNumber(attributes.ftLastWriteTime);
+	return true;
+}
+
+unsigned long long getCurrentFileTime() {
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	return fileTimeToNumber(now);
+}
+
+FILE* openFileStream(LPCWSTR path, const char* mode) {
+	const std::wstring wideMode(mode, mode + strlen(mode));
+	FILE* file = nullptr;
+	if (_wfopen_s(&file, path, wideMode.c_str()) != 0) return nullptr;
+	return file;
+}
+
+#else
+
+// Between 1601, where FILETIME starts, and 1970, where time_t does.
+static const unsigned long long unixEpochAsFileTime = 116444736000000000ULL;
+
+static unsigned long long timespecToFileTime(const timespec& time) {
+	return (unsigned long long)time.tv_sec * 10000000ULL + time.tv_nsec / 100 + unixEpochAsFileTime;
+}
+
+static std::string toNativePath(LPCWSTR path) {
+	return wideToUtf8(path, wcslen(path));
+}
+
+File::~File() {
+	close();
+}
+
+bool File::open(LPCWSTR path, FileMode mode, FileAccessHint hint) {
+	close();
+	int flags = O_RDWR | O_CREAT | O_CLOEXEC;
+	switch (mode) {
+	case FILE_MODE_READ: flags = O_RDONLY | O_CLOEXEC; break;
+	case FILE_MODE_CREATE_NEW: flags |= O_EXCL; break;
+	case FILE_MODE_CREATE_ALWAYS: flags |= O_TRUNC; break;
+	case FILE_MODE_OPEN_ALWAYS: break;
+	}
+	descriptor = ::open(toNativePath(path).c_str(), flags, 0666);
+	if (descriptor == -1) return false;
+	if (hint != FILE_HINT_NONE) {
+		posix_fadvise(descriptor, 0, 0, hint == FILE_HINT_SEQUENTIAL ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+	}
+	return true;
+}
+
+void File::close() {
+	if (descriptor != -1) {
+		::close(descriptor);
+		descriptor = -1;
+	}
+}
+
+bool File::isOpen() const {
+	return descriptor != -1;
+}
+
+bool File::readAt(void* data, size_t size, unsigned long long offset, size_t& bytesRead) {
+	bytesRead = 0;
+	while (bytesRead < size) {
+		ssize_t callBytesRead = pread(descriptor, (BYTE*)data + bytesRead, (std::min)(size - bytesRead, maxCallSize),
+			(off_t)(offset + bytesRead));
+		if (callBytesRead < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		if (!callBytesRead) break;
+		bytesRead += (size_t)callBytesRead;
+	}
+	return true;
+}
+
+bool File::writeAt(const void* data, size_t size, unsigned long long offset) {
+	size_t bytesWritten = 0;
+	while (bytesWritten < size) {
+		ssize_t callBytesWritten = pwrite(descriptor, (const BYTE*)data + bytesWritten,
+			(std::min)(size - bytesWritten, maxCallSize), (off_t)(offset + bytesWritten));
+		if (callBytesWritten < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		bytesWritten += (size_t)callBytesWritten;
+	}
+	return true;
+}
+
+bool File::getSize(unsigned long long& size) {
+	struct stat status;
+	if (fstat(descriptor, &status) != 0) return false;
+	size = (unsigned long long)status.st_size;
+	return true;
+}
+
+bool File::setSize(unsigned long long size) {
+#ifdef __linux__
+	// Space for the part that grows is reserved on disk, rather than left sparse to be found as it's written.
+	// Where the file system can't, only the size is set.
+	unsigned long long oldSize = 0;
+	if (getSize(oldSize) && size > oldSize) {
+		const int result = posix_fallocate(descriptor, (off_t)oldSize, (off_t)(size - oldSize));
+		if (result == 0) return true;
+		if (result != EINVAL && result != EOPNOTSUPP) {
+			errno = result;
+			return false;
+		}
+	}
+#endif
+	return ftruncate(descriptor, (off_t)size) == 0;
+}
+
+bool File::getWriteTime(unsigned long long& writeTime) {
+	struct stat status;
+	if (fstat(descriptor, &status) != 0) return false;
+	writeTime = timespecToFileTime(status.st_mtim);
+	return true;
+}
+
+bool File::setWriteTime(unsigned long long writeTime) {
+	timespec times[2] {};
+	times[0].tv_nsec = UTIME_OMIT;
+	times[1].tv_sec = (time_t)((writeTime - unixEpochAsFileTime) / 10000000ULL);
+	times[1].tv_nsec = (long)((writeTime - unixEpochAsFileTime) % 10000000ULL * 100);
+	return futimens(descriptor, times) == 0;
+}
+
+bool listFolder(LPCWSTR folder, std::vector<FolderEntry>& entries) {
+	DIR* dir = opendir(toNativePath(folder).c_str());
+	if (!dir) return false;
+	while (true) {
+		addRunStat(STAT_FOLDER_LIST_CALLS);
+		errno = 0;
+		dirent* dirEntry = readdir(dir);
+		if (!dirEntry) break;
+		if (strcmp(dirEntry->d_name, ".") == 0 || strcmp(dirEntry->d_name, "..") == 0) continue;
+		struct stat status;
+		if (fstatat(dirfd(dir), dirEntry->d_name, &status, 0) != 0) {
+			// Deleted since it was listed.
+			if (errno == ENOENT) continue;
+			break;
+		}
+		FolderEntry entry;
+		entry.name = utf8ToWide(dirEntry->d_name, strlen(dirEntry->d_name));
+		entry.isFolder = S_ISDIR(status.st_mode);
+		entry.size = (unsigned long long)status.st_size;
+		entry.writeTime = timespecToFileTime(status.st_mtim);
+		entries.push_back(std::move(entry));
+	}
+	int err = errno;
+	closedir(dir);
+	errno = err;
+	return err == 0;
+}
+
+bool createFolder(LPCWSTR path) {
+	return mkdir(toNativePath(path).c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+bool deleteFile(LPCWSTR path) {
+	return unlink(toNativePath(path).c_str()) == 0 || errno == ENOENT;
+}
+
+static bool replaceFile(LPCWSTR from, LPCWSTR to) {
+	return rename(toNativePath(from).c_str(), toNativePath(to).c_str()) == 0;
+}
+
+static int getLastSystemError() {
+	return errno;
+}
+
+static void setLastSystemError(int err) {
+	errno = err;
+}
+
+bool getFileInfo(LPCWSTR path, unsigned long long& size, unsigned long long& writeTime) {
+	struct stat status;
+	if (stat(toNativePath(path).c_str(), &status) != 0) return false;
+	size = (unsigned long long)status.st_size;
+	writeTime = timespecToFileTime(status.st_mtim);
+	return true;
+}
+
+unsigned long long getCurrentFileTime() {
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return timespecToFileTime(now);
+}
+
+FILE* openFileStream(LPCWSTR path, const char* mode) {
+	return fopen(toNativePath(path).c_str(), mode);
+}
+
+#endif
+
+bool saveFileAtomically(LPCWSTR path, const void* data, size_t size) {
+	std::wstring tempPath = std::wstring(path) + L".tmp";
+	File file;
+	if (!file.open(tempPath.c_str(), FILE_MODE_CREATE_ALWAYS)) return false;
+	addRunStat(STAT_FILES_OPENED);
+	addRunStat(STAT_WRITE_CALLS);
+	addRunStat(STAT_BYTES_WRITTEN, size);
+	bool result = file.writeAt(data, size, 0);
+	auto err = getLastSystemError();
+	file.close();
+	if (result) {
+		result = replaceFile(tempPath.c_str(), path);
+		err = getLastSystemError();
+	}
+	if (!result) {
+		deleteFile(tempPath.c_str());
+		setLastSystemError(err);
+	}
+	return result;
+}
+
+// Reads what's left of the request, from bytesRead on, with a File of its own.
+static bool readRemainder(FileReadRequest& request) {
+	File file;
+	if (!file.open(request.path, FILE_MODE_READ, FILE_HINT_SEQUENTIAL)) return false;
+	request.isOpened = true;
+	addRunStat(STAT_FILES_OPENED);
+	addRunStat(STAT_READ_CALLS);
+	addRunStat(STAT_BYTES_READ, request.size - request.bytesRead);
+	size_t bytesRead = 0;
+	bool result = file.readAt(request.out + request.bytesRead, request.size - request.bytesRead,
+		request.offset + request.bytesRead, bytesRead);
+	auto err = getLastSystemError();
+	request.bytesRead += bytesRead;
+	file.close();
+	setLastSystemError(err);
+	return result;
+}
+
+#ifdef HAVE_IO_URING
+
+// An io_uring set up with the system calls themselves, so that nothing beyond the kernel headers is needed.
+// Only ever used by the thread that made it.
+class IoRing {
+public:
+	IoRing() = default;
+	IoRing(const IoRing&) = delete;
+	IoRing& operator=(const IoRing&) = delete;
+	~IoRing();
+	// Fails if the system has no io_uring or it lacks any of openat, read and close.
+	bool init(unsigned requestedEntryCount);
+	unsigned getEntryCount() const { return entryCount; }
+	// A zeroed entry to fill in. Null if entryCount of them are already waiting to be submitted.
+	io_uring_sqe* getSqe();
+	// Submits the entries from getSqe and waits until at least waitCount completions are there.
+	bool submitAndWait(unsigned waitCount);
+	// Takes back the entries from getSqe that the kernel hasn't taken yet, so they never run, and gives copies of them.
+	void takeBackUnsubmitted(std::vector<io_uring_sqe>& entries);
+	// Waits for one completion without submitting anything.
+	bool waitForCompletion();
+	// Submitted entries whose completions haven't been seen yet.
+	unsigned getPendingCount() const { return submittedCount - seenCount; }
+	// The oldest completion not yet seen, or null if there's none.
+	io_uring_cqe* peekCqe();
+	void seenCqe();
+private:
+	int ringFd = -1;
+	unsigned entryCount = 0;
+	void* sqRing = MAP_FAILED;
+	size_t sqRingSize = 0;
+	void* cqRing = MAP_FAILED;
+	size_t cqRingSize = 0;
+	io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+	size_t sqesSize = 0;
+	unsigned* sqHead = nullptr;
+	unsigned* sqTail = nullptr;
+	unsigned* sqArray = nullptr;
+	unsigned sqMask = 0;
+	unsigned* cqHead = nullptr;
+	unsigned* cqTail = nullptr;
+	io_uring_cqe* cqes = nullptr;
+	unsigned cqMask = 0;
+	// Entries handed out by getSqe, and the part of them the kernel has taken.
+	unsigned localTail = 0;
+	unsigned submittedTail = 0;
+	unsigned submittedCount = 0;
+	unsigned seenCount = 0;
+};
+
+IoRing::~IoRing() {
+	if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+	if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+	if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+	if (ringFd != -1) ::close(ringFd);
+}
+
+bool IoRing::init(unsigned requestedEntryCount) {
+	io_uring_params params{};
+	ringFd = (int)syscall(__NR_io_uring_setup, requestedEntryCount, &params);
+	if (ringFd < 0) {
+		ringFd = -1;
+		return false;
+	}
+	entryCount = params.sq_entries;
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	// Newer kernels map both rings with one call.
+	const bool isSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (isSingleMap) {
+		sqRingSize = cqRingSize = (std::max)(sqRingSize, cqRingSize);
+	}
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) return false;
+	cqRing = isSingleMap
+		? sqRing
+		: mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+	if (cqRing == MAP_FAILED) return false;
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		ringFd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) return false;
+
+	BYTE* sq = (BYTE*)sqRing;
+	sqHead = (unsigned*)(sq + params.sq_off.head);
+	sqTail = (unsigned*)(sq + params.sq_off.tail);
+	sqArray = (unsigned*)(sq + params.sq_off.array);
+	sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+	BYTE* cq = (BYTE*)cqRing;
+	cqHead = (unsigned*)(cq + params.cq_off.head);
+	cqTail = (unsigned*)(cq + params.cq_off.tail);
+	cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+	cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+	localTail = submittedTail = *sqTail;
+
+	const unsigned probeOpCount = 256;
+	std::vector<BYTE> probeData(sizeof(io_uring_probe) + probeOpCount * sizeof(io_uring_probe_op));
+	io_uring_probe* probe = (io_uring_probe*)probeData.data();
+	if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, probeOpCount) < 0) return false;
+	for (int op : { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE }) {
+		if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+	}
+	return true;
+}
+
+io_uring_sqe* IoRing::getSqe() {
+	if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= entryCount) return nullptr;
+	const unsigned slot = localTail & sqMask;
+	sqArray[slot] = slot;
+	++localTail;
+	memset(&sqes[slot], 0, sizeof(io_uring_sqe));
+	return &sqes[slot];
+}
+
+bool IoRing::submitAndWait(unsigned waitCount) {
+	__atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+	while (true) {
+		const int result = (int)syscall(__NR_io_uring_enter, ringFd, localTail - submittedTail, waitCount,
+			IORING_ENTER_GETEVENTS, nullptr, 0);
+		if (result < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		addRunStat(STAT_RING_SUBMIT_CALLS);
+		submittedTail += (unsigned)result;
+		submittedCount += (unsigned)result;
+		// Interrupted while waiting after submitting everything. The caller waits again if nothing completed.
+		if (submittedTail == localTail) return true;
+	}
+}
+
+void IoRing::takeBackUnsubmitted(std::vector<io_uring_sqe>& entries) {
+	for (unsigned tail = submittedTail; tail != localTail; ++tail) {
+		entries.push_back(sqes[sqArray[tail & sqMask]]);
+	}
+	// The kernel only looks at the tail when entered, so moving it back is safe.
+	localTail = submittedTail;
+	__atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+}
+
+bool IoRing::waitForCompletion() {
+	while (true) {
+		if (syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0) return true;
+		if (errno != EINTR) return false;
+	}
+}
+
+io_uring_cqe* IoRing::peekCqe() {
+	const unsigned head = *cqHead;
+	if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return nullptr;
+	return &cqes[head & cqMask];
+}
+
+void IoRing::seenCqe() {
+	__atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+	++seenCount;
+}
+
+// Each thread sets up its ring on first use and keeps it, since setting one up costs a few calls and mappings.
+// Once one fails to set up, no thread tries again.
+static const unsigned ringEntryCount = 128;
+static thread_local std::unique_ptr<IoRing> threadRing;
+static std::atomic<bool> isIoUringUnavailable { false };
+
+static IoRing* getThreadRing() {
+	if (threadRing) return threadRing.get();
+	if (isIoUringUnavailable) return nullptr;
+	std::unique_ptr<IoRing> ring(new IoRing());
+	if (!ring->init(ringEntryCount)) {
+		isIoUringUnavailable = true;
+		return nullptr;
+	}
+	threadRing = std::move(ring);
+	return threadRing.get();
+}
+
+// What a completion is for, in the low bits of its user_data. The request index is in the rest.
+enum RingOp {
+	RING_OP_OPEN,
+	RING_OP_READ,
+	RING_OP_CLOSE,
+	RING_OP_COUNT
+};
+
+// Every request gets an openat, and as soon as that completes, a read hard-linked to a close, so that the file
+// is closed whether the read works or not. Half the ring's entries' worth of requests are in flight at a time,
+// which keeps every request to at most two entries waiting and the completions well within the ring.
+// Requests too big for one read are left for readRemainder, as are short reads.
+static void readFilesWithRing(IoRing& ring, std::vector<FileReadRequest>& requests, std::vector<int>& errors) {
+	const size_t count = requests.size();
+	const unsigned maxInFlight = ring.getEntryCount() / 2;
+	std::vector<std::string> paths(count);
+	std::vector<bool> isFinished(count, false);
+	size_t nextRequest = 0;
+	size_t finishedCount = 0;
+	unsigned inFlight = 0;
+	// Once the ring fails, the files that still open are closed right away rather than read.
+	bool isDraining = false;
+	auto finish = [&](size_t index) {
+		isFinished[index] = true;
+		--inFlight;
+		++finishedCount;
+	};
+	auto handleCompletions = [&]() {
+		while (io_uring_cqe* cqe = ring.peekCqe()) {
+			const size_t index = (size_t)(cqe->user_data / RING_OP_COUNT);
+			const RingOp op = (RingOp)(cqe->user_data % RING_OP_COUNT);
+			const int result = cqe->res;
+			ring.seenCqe();
+			FileReadRequest& request = requests[index];
+			switch (op) {
+			case RING_OP_OPEN: {
+				if (result < 0) {
+					errors[index] = -result;
+					finish(index);
+					break;
+				}
+				request.isOpened = true;
+				addRunStat(STAT_FILES_OPENED);
+				if (isDraining) {
+					::close(result);
+					finish(index);
+					break;
+				}
+				addRunStat(STAT_READ_CALLS);
+				addRunStat(STAT_BYTES_READ, request.size);
+				io_uring_sqe* readSqe = ring.getSqe();
+				readSqe->opcode = IORING_OP_READ;
+				readSqe->fd = result;
+				readSqe->addr = (unsigned long long)(uintptr_t)request.out;
+				readSqe->len = (unsigned)request.size;
+				readSqe->off = request.offset;
+				readSqe->flags = IOSQE_IO_HARDLINK;
+				readSqe->user_data = index * RING_OP_COUNT + RING_OP_READ;
+				io_uring_sqe* closeSqe = ring.getSqe();
+				closeSqe->opcode = IORING_OP_CLOSE;
+				closeSqe->fd = result;
+				closeSqe->user_data = index * RING_OP_COUNT + RING_OP_CLOSE;
+				break;
+			}
+			case RING_OP_READ:
+				if (result < 0) {
+					errors[index] = -result;
+				} else {
+					request.bytesRead = (size_t)result;
+				}
+				break;
+			case RING_OP_CLOSE:
+				finish(index);
+				break;
+			default:
+				break;
+			}
+		}
+	};
+	while (finishedCount < count) {
+		while (nextRequest < count && inFlight < maxInFlight) {
+			const size_t index = nextRequest++;
+			if (requests[index].size > maxCallSize) {
+				isFinished[index] = true;
+				++finishedCount;
+				continue;
+			}
+			paths[index] = toNativePath(requests[index].path);
+			io_uring_sqe* sqe = ring.getSqe();
+			sqe->opcode = IORING_OP_OPENAT;
+			sqe->fd = AT_FDCWD;
+			sqe->addr = (unsigned long long)(uintptr_t)paths[index].c_str();
+			sqe->open_flags = O_RDONLY | O_CLOEXEC;
+			sqe->user_data = index * RING_OP_COUNT + RING_OP_OPEN;
+			++inFlight;
+		}
+		if (!inFlight) break;
+		if (ring.submitAndWait(1)) {
+			handleCompletions();
+			continue;
+		}
+
+		// The ring is no good any more. The reads still in flight write into the callers' buffers, so every
+		// completion is waited for before returning, and the files the entries that never ran would have
+		// closed are closed here.
+		const int err = errno;
+		isDraining = true;
+		std::vector<io_uring_sqe> unsubmitted;
+		ring.takeBackUnsubmitted(unsubmitted);
+		bool isDrained = true;
+		while (ring.getPendingCount()) {
+			if (!ring.waitForCompletion()) {
+				isDrained = false;
+				break;
+			}
+			handleCompletions();
+		}
+		for (const io_uring_sqe& entry : unsubmitted) {
+			if (entry.user_data % RING_OP_COUNT == RING_OP_CLOSE) {
+				::close(entry.fd);
+			}
+		}
+		for (size_t index = 0; index < count; ++index) {
+			if (!isFinished[index] && !errors[index]) {
+				errors[index] = err;
+			}
+		}
+		if (isDrained) {
+			threadRing.reset();
+		} else {
+			// Waiting only fails if the ring itself is broken. Unmapping it then could let the kernel finish
+			// a read into memory that's been reused, so it's left as it is and never used again.
+			threadRing.release();
+		}
+		return;
+	}
+}
+
+#endif
+
+int readFiles(std::vector<FileReadRequest>& requests, bool useIoUring) {
+	std::vector<int> errors;
+#ifdef HAVE_IO_URING
+	IoRing* ring = useIoUring ? getThreadRing() : nullptr;
+	if (ring) {
+		errors.assign(requests.size(), 0);
+		readFilesWithRing(*ring, requests, errors);
+	}
+#endif
+	for (size_t index = 0; index < requests.size(); ++index) {
+		FileReadRequest& request = requests[index];
+		if (!errors.empty() && errors[index]) {
+			setLastSystemError(errors[index]);
+			return (int)index;
+		}
+		// Everything the ring didn't do, and the reads through it that came up short, which might just have been
+		// cut short. Finishing those here also finds out if the file really ends early.
+		if ((!request.isOpened || request.bytesRead < request.size) && !readRemainder(request)) {
+			return (int)index;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "Platform.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Everything the program does with files goes through here, so that the rest of the code is the same on every system.
+// On failure the functions return false and WinError holds the reason.
+// Paths have PATH_SEPARATOR between the parts. Outside Windows they are passed to the system as UTF-8.
+// Times are FILETIMEs as one number, 100-nanosecond intervals since 1601, on every system.
+
+enum FileMode {
+	// An existing file, for reading only. Others can read it at the same time.
+	FILE_MODE_READ,
+	// A new file for reading and writing. Fails if there's a file at the path already.
+	FILE_MODE_CREATE_NEW,
+	// For reading and writing, replacing whatever file is at the path with an empty one.
+	FILE_MODE_CREATE_ALWAYS,
+	// For reading and writing, keeping the file at the path if there is one.
+	FILE_MODE_OPEN_ALWAYS
+};
+
+// How the file is going to be read, so the system can read ahead to suit. Only a hint.
+enum FileAccessHint {
+	FILE_HINT_NONE,
+	// Front to back, like a whole file read in one go.
+	FILE_HINT_SEQUENTIAL,
+	// Scattered reads, where reading ahead would be wasted.
+	FILE_HINT_RANDOM
+};
+
+// A file read and written at given offsets rather than at a shared file pointer, so any number of threads can use
+// one File at the same time. A handle with the offsets in OVERLAPPED on Windows, a descriptor with pread and pwrite elsewhere.
+class File {
+public:
+	File() = default;
+	File(const File&) = delete;
+	File& operator=(const File&) = delete;
+	~File();
+	bool open(LPCWSTR path, FileMode mode, FileAccessHint hint = FILE_HINT_NONE);
+	void close();
+	bool isOpen() const;
+	// Reads until size bytes are read or the file ends. bytesRead says how many were.
+	bool readAt(void* data, size_t size, unsigned long long offset, size_t& bytesRead);
+	// Writes all of the size bytes or fails.
+	bool writeAt(const void* data, size_t size, unsigned long long offset);
+	bool getSize(unsigned long long& size);
+	// Grows the file, with zeros, or cuts it short. The space it grows by is reserved on disk where possible.
+	bool setSize(unsigned long long size);
+	bool getWriteTime(unsigned long long& writeTime);
+	bool setWriteTime(unsigned long long writeTime);
+#ifdef _WIN32
+	HANDLE getHandle() const { return handle; }
+#else
+	int getDescriptor() const { return descriptor; }
+#endif
+private:
+#ifdef _WIN32
+	HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+	int descriptor = -1;
+#endif
+};
+
+struct FolderEntry {
+	std::wstring name;
+	bool isFolder = false;
+	unsigned long long size = 0;
+	unsigned long long writeTime = 0;
+};
+
+// The files and subfolders of a folder, without . and .., in no particular order.
+bool listFolder(LPCWSTR folder, std::vector<FolderEntry>& entries);
+// Also succeeds if the folder is already there. Its parent must exist.
+bool createFolder(LPCWSTR path);
+// Also succeeds if there's no such file.
+bool deleteFile(LPCWSTR path);
+// Writes a temporary file next to path first and then replaces the file at path with it,
+// so an interrupted save never leaves a half-written file behind.
+bool saveFileAtomically(LPCWSTR path, const void* data, size_t size);
+bool getFileInfo(LPCWSTR path, unsigned long long& size, unsigned long long& writeTime);
+unsigned long long getCurrentFileTime();
+// For the files written with fprintf and friends.
+FILE* openFileStream(LPCWSTR path, const char* mode);
+
+// A part of a file for readFiles to read into out.
+struct FileReadRequest {
+	LPCWSTR path = nullptr;
+	unsigned long long offset = 0;
+	size_t size = 0;
+	BYTE* out = nullptr;
+	// Filled in by readFiles. bytesRead is less than size if the file ends first.
+	bool isOpened = false;
+	size_t bytesRead = 0;
+};
+
+// Opens, reads and closes every file of the requests. With useIoUring on Linux, the opens, reads and closes of many
+// files are submitted to an io_uring together and kept in flight at the same time, instead of being three blocking
+// calls per file. Elsewhere, or if the system has no io_uring, the files are read one by one with File.
+// Returns the index of the first request that failed, with isOpened saying whether it was the open or the read
+// and WinError holding the reason, or -1 if none did. The requests after a failed one may not have been read.
+int readFiles(std::vector<FileReadRequest>& requests, bool useIoUring);
@@ -0,0 +1,134 @@
+#include "Hash.h"
+#include <cstring>
+
+// Follows the reference XXH64 algorithm, so the values match other xxHash implementations.
+
+static const unsigned long long prime1 = 0x9E3779B185EBCA87ULL;
+static const unsigned long long prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const unsigned long long prime3 = 0x165667B19E3779F9ULL;
+static const unsigned long long prime4 = 0x85EBCA77C2B2AE63ULL;
+static const unsigned long long prime5 = 0x27D4EB2F165667C5ULL;
+
+static inline unsigned long long rotl(unsigned long long value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static inline unsigned long long read64(const unsigned char* ptr) {
+	unsigned long long value;
+	memcpy(&value, ptr, 8);
+	return value;
+}
+
+static inline unsigned int read32(const unsigned char* ptr) {
+	unsigned int value;
+	memcpy(&value, ptr, 4);
+	return value;
+}
+
+static inline unsigned long long mixRound(unsigned long long accumulator, unsigned long long input) {
+	accumulator += input * prime2;
+	accumulator = rotl(accumulator, 31);
+	return accumulator * prime1;
+}
+
+static inline unsigned long long mergeRound(unsigned long long hash, unsigned long long accumulator) {
+	hash ^= mixRound(0, accumulator);
+	return hash * prime1 + prime4;
+}
+
+// Mixes in the last (less than 32) bytes and scrambles the result.
+static unsigned long long finish(unsigned long long hash, const unsigned char* ptr, size_t size) {
+	while (size >= 8) {
+		hash ^= mixRound(0, read64(ptr));
+		hash = rotl(hash, 27) * prime1 + prime4;
+		ptr += 8;
+		size -= 8;
+	}
+	if (size >= 4) {
+		hash ^= (unsigned long long)read32(ptr) * prime1;
+		hash = rotl(hash, 23) * prime2 + prime3;
+		ptr += 4;
+		size -= 4;
+	}
+	while (size) {
+		hash ^= *ptr * prime5;
+		hash = rotl(hash, 11) * prime1;
+		++ptr;
+		--size;
+	}
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+static unsigned long long mergeAccumulators(const unsigned long long* accumulators) {
+	unsigned long long hash = rotl(accumulators[0], 1) + rotl(accumulators[1], 7)
+		+ rotl(accumulators[2], 12) + rotl(accumulators[3], 18);
+	for (int i = 0; i < 4; ++i) {
+		hash = mergeRound(hash, accumulators[i]);
+	}
+	return hash;
+}
+
+unsigned long long hash64(const void* data, size_t size, unsigned long long seed) {
+	const unsigned char* ptr = (const unsigned char*)data;
+	const size_t totalSize = size;
+	unsigned long long hash;
+	if (size >= 32) {
+		unsigned long long accumulators[4] { seed + prime1 + prime2, seed + prime2, seed, seed - prime1 };
+		do {
+			for (int i = 0; i < 4; ++i) {
+				accumulators[i] = mixRound(accumulators[i], read64(ptr + i * 8));
+			}
+			ptr += 32;
+			size -= 32;
+		} while (size >= 32);
+		hash = mergeAccumulators(accumulators);
+	} else {
+		hash = seed + prime5;
+	}
+	hash += totalSize;
+	return finish(hash, ptr, size);
+}
+
+
+Hasher64::Hasher64(unsigned long long seed)
+	: seed(seed), accumulators { seed + prime1 + prime2, seed + prime2, seed, seed - prime1 } { }
+
+void Hasher64::update(const void* data, size_t size) {
+	const unsigned char* ptr = (const unsigned char*)data;
+	totalSize += size;
+	if (pendingSize + size < 32) {
+		memcpy(pending + pendingSize, ptr, size);
+		pendingSize += size;
+		return;
+	}
+	if (pendingSize) {
+		const size_t fill = 32 - pendingSize;
+		memcpy(pending + pendingSize, ptr, fill);
+		for (int i = 0; i < 4; ++i) {
+			accumulators[i] = mixRound(accumulators[i], read64(pending + i * 8));
+		}
+		ptr += fill;
+		size -= fill;
+		pendingSize = 0;
+	}
+	while (size >= 32) {
+		for (int i = 0; i < 4; ++i) {
+			accumulators[i] = mixRound(accumulators[i], read64(ptr + i * 8));
+		}
+		ptr += 32;
+		size -= 32;
+	}
+	memcpy(pending, ptr, size);
+	pendingSize = size;
+}
+
+unsigned long long Hasher64::finish() const {
+	unsigned long long hash = totalSize >= 32 ? mergeAccumulators(accumulators) : seed + prime5;
+	hash += totalSize;
+	return ::finish(hash, pending, pendingSize);
+}
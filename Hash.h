@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+
+// 64-bit xxHash (XXH64) of a block of memory. Fast, not cryptographic. Used to tell whether export data changed.
+unsigned long long hash64(const void* data, size_t size, unsigned long long seed = 0);
+
+
+// The same hash as hash64, of data that comes in pieces, such as a file read a part at a time.
+class Hasher64 {
+public:
+	explicit Hasher64(unsigned long long seed = 0);
+	void update(const void* data, size_t size);
+	// The hash of everything passed to update so far.
+	unsigned long long finish() const;
+private:
+	unsigned long long seed;
+	unsigned long long accumulators[4];
+	unsigned long long totalSize = 0;
+	// The start of a 32-byte stripe that hasn't been mixed in yet.
+	unsigned char pending[32];
+	size_t pendingSize = 0;
+};
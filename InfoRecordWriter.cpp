@@ -0,0 +1,271 @@
+#include "InfoRecordWriter.h"
+#include "RunStats.h"
+#include <cstring>
+
+void NdjsonRecordWriter::separate() {
+	if (needsComma) {
+		out.write(",", 1);
+	}
+}
+
+void NdjsonRecordWriter::beginRecord(const char* recordType) {
+	out.write("{\"Record\":\"");
+	out.write(recordType);
+	out.write("\"");
+	needsComma = true;
+}
+
+void NdjsonRecordWriter::endRecord() {
+	out.write("}\n", 2);
+	needsComma = false;
+}
+
+void NdjsonRecordWriter::key(const char* name) {
+	separate();
+	out.write("\"");
+	out.write(name);
+	out.write("\":");
+	needsComma = false;
+}
+
+void NdjsonRecordWriter::writeInt(long long value) {
+	separate();
+	out.writeFormat("%lld", value);
+	needsComma = true;
+}
+
+void NdjsonRecordWriter::writeUnsigned(unsigned long long value) {
+	separate();
+	out.writeFormat("%llu", value);
+	needsComma = true;
+}
+
+void NdjsonRecordWriter::writeAscii(const char* str) {
+	separate();
+	out.write("\"");
+	out.write(str);
+	out.write("\"");
+	needsComma = true;
+}
+
+void NdjsonRecordWriter::writeString(const wchar_t* str, size_t length, const char* asciiSuffix) {
+	separate();
+	out.write("\"");
+	out.writeEscaped(str, length);
+	if (asciiSuffix) {
+		out.write(asciiSuffix);
+	}
+	out.write("\"");
+	needsComma = true;
+}
+
+void NdjsonRecordWriter::beginArray(size_t /*count*/) {
+	separate();
+	out.write("[", 1);
+	needsComma = false;
+}
+
+void NdjsonRecordWriter::endArray() {
+	out.write("]", 1);
+	needsComma = true;
+}
+
+void NdjsonRecordWriter::beginMap(size_t /*fieldCount*/) {
+	separate();
+	out.write("{", 1);
+	needsComma = false;
+}
+
+void NdjsonRecordWriter::endMap() {
+	out.write("}", 1);
+	needsComma = true;
+}
+
+// Records are written out once this much has piled up, so a record never has to be moved once the buffer is flushed.
+#define MSGPACK_FLUSH_SIZE 0x10000
+
+MsgPackRecordWriter::MsgPackRecordWriter(FILE* file) : file(file) {
+	buffer.reserve(MSGPACK_FLUSH_SIZE * 2);
+}
+
+MsgPackRecordWriter::~MsgPackRecordWriter() {
+	flush();
+}
+
+void MsgPackRecordWriter::flush() {
+	if (!buffer.empty()) {
+		writeBuffer();
+	}
+	fflush(file);
+}
+
+void MsgPackRecordWriter::writeBuffer() {
+	fwrite(buffer.data(), 1, buffer.size(), file);
+	addRunStat(STAT_WRITE_CALLS);
+	addRunStat(STAT_BYTES_WRITTEN, buffer.size());
+	buffer.clear();
+}
+
+void MsgPackRecordWriter::writeBigEndian(unsigned long long value, int size) {
+	for (int shift = (size - 1) * 8; shift >= 0; shift -= 8) {
+		buffer.push_back((BYTE)(value >> shift));
+	}
+}
+
+void MsgPackRecordWriter::writeLength(size_t length, BYTE fixType, size_t fixLimit, BYTE type8, BYTE type16, BYTE type32) {
+	if (length < fixLimit) {
+		writeByte((BYTE)(fixType | length));
+	} else if (type8 && length <= 0xff) {
+		writeByte(type8);
+		writeBigEndian(length, 1);
+	} else if (length <= 0xffff) {
+		writeByte(type16);
+		writeBigEndian(length, 2);
+	} else {
+		writeByte(type32);
+		writeBigEndian(length, 4);
+	}
+}
+
+void MsgPackRecordWriter::beginRecord(const char* recordType) {
+	recordStart = buffer.size();
+	recordFieldCount = 0;
+	depth = 0;
+	// A fixmap header for now. endRecord puts in the real one.
+	writeByte(0x80);
+	key("Record");
+	writeAscii(recordType);
+}
+
+void MsgPackRecordWriter::endRecord() {
+	if (recordFieldCount < 16) {
+		buffer[recordStart] = (BYTE)(0x80 | recordFieldCount);
+	} else {
+		const bool isMap16 = recordFieldCount <= 0xffff;
+		BYTE header[5];
+		header[0] = isMap16 ? 0xde : 0xdf;
+		const int size = isMap16 ? 2 : 4;
+		for (int i = 0; i < size; ++i) {
+			header[1 + i] = (BYTE)(recordFieldCount >> ((size - 1 - i) * 8));
+		}
+		buffer.insert(buffer.begin() + recordStart + 1, header + 1, header + 1 + size);
+		buffer[recordStart] = header[0];
+	}
+	if (buffer.size() >= MSGPACK_FLUSH_SIZE) {
+		writeBuffer();
+	}
+}
+
+void MsgPackRecordWriter::key(const char* name) {
+	if (depth == 0) {
+		++recordFieldCount;
+	}
+	writeAscii(name);
+}
+
+void MsgPackRecordWriter::writeInt(long long value) {
+	if (value >= 0) {
+		writeUnsigned((unsigned long long)value);
+	} else if (value >= -32) {
+		writeByte((BYTE)value);
+	} else if (value >= -0x80) {
+		writeByte(0xd0);
+		writeBigEndian((unsigned long long)value, 1);
+	} else if (value >= -0x8000) {
+		writeByte(0xd1);
+		writeBigEndian((unsigned long long)value, 2);
+	} else if (value >= -0x7fffffffLL - 1) {
+		writeByte(0xd2);
+		writeBigEndian((unsigned long long)value, 4);
+	} else {
+		writeByte(0xd3);
+		writeBigEndian((unsigned long long)value, 8);
+	}
+}
+
+void MsgPackRecordWriter::writeUnsigned(unsigned long long value) {
+	if (value < 0x80) {
+		writeByte((BYTE)value);
+	} else if (value <= 0xff) {
+		writeByte(0xcc);
+		writeBigEndian(value, 1);
+	} else if (value <= 0xffff) {
+		writeByte(0xcd);
+		writeBigEndian(value, 2);
+	} else if (value <= 0xffffffffULL) {
+		writeByte(0xce);
+		writeBigEndian(value, 4);
+	} else {
+		writeByte(0xcf);
+		writeBigEndian(value, 8);
+	}
+}
+
+void MsgPackRecordWriter::writeAscii(const char* str) {
+	const size_t length = strlen(str);
+	writeLength(length, 0xa0, 32, 0xd9, 0xda, 0xdb);
+	buffer.insert(buffer.end(), (const BYTE*)str, (const BYTE*)str + length);
+}
+
+// The code point that starts at str[i], and how many wchar_t it takes. wchar_t is UTF-16 on Windows,
+// where a code point above 0xFFFF takes two. A surrogate without its pair becomes U+FFFD.
+static unsigned int decodeCodePoint(const wchar_t* str, size_t length, size_t i, size_t& units) {
+	unsigned int c = (unsigned int)str[i];
+	units = 1;
+	if (sizeof(wchar_t) == 2 && c >= 0xd800 && c <= 0xdfff) {
+		if (c <= 0xdbff && i + 1 < length && str[i + 1] >= 0xdc00 && str[i + 1] <= 0xdfff) {
+			units = 2;
+			return 0x10000 + ((c - 0xd800) << 10) + ((unsigned int)str[i + 1] - 0xdc00);
+		}
+		return 0xfffd;
+	}
+	return c;
+}
+
+static size_t getUtf8Size(unsigned int codePoint) {
+	return codePoint < 0x80 ? 1 : codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+}
+
+void MsgPackRecordWriter::writeString(const wchar_t* str, size_t length, const char* asciiSuffix) {
+	const size_t suffixLength = asciiSuffix ? strlen(asciiSuffix) : 0;
+	size_t utf8Length = suffixLength;
+	size_t units;
+	for (size_t i = 0; i < length; i += units) {
+		utf8Length += getUtf8Size(decodeCodePoint(str, length, i, units));
+	}
+	writeLength(utf8Length, 0xa0, 32, 0xd9, 0xda, 0xdb);
+	for (size_t i = 0; i < length; i += units) {
+		const unsigned int c = decodeCodePoint(str, length, i, units);
+		switch (getUtf8Size(c)) {
+		case 1:
+			writeByte((BYTE)c);
+			break;
+		case 2:
+			writeByte((BYTE)(0xc0 | (c >> 6)));
+			writeByte((BYTE)(0x80 | (c & 0x3f)));
+			break;
+		case 3:
+			writeByte((BYTE)(0xe0 | (c >> 12)));
+			writeByte((BYTE)(0x80 | ((c >> 6) & 0x3f)));
+			writeByte((BYTE)(0x80 | (c & 0x3f)));
+			break;
+		default:
+			writeByte((BYTE)(0xf0 | (c >> 18)));
+			writeByte((BYTE)(0x80 | ((c >> 12) & 0x3f)));
+			writeByte((BYTE)(0x80 | ((c >> 6) & 0x3f)));
+			writeByte((BYTE)(0x80 | (c & 0x3f)));
+			break;
+		}
+	}
+	buffer.insert(buffer.end(), (const BYTE*)asciiSuffix, (const BYTE*)asciiSuffix + suffixLength);
+}
+
+void MsgPackRecordWriter::beginArray(size_t count) {
+	writeLength(count, 0x90, 16, 0, 0xdc, 0xdd);
+	++depth;
+}
+
+void MsgPackRecordWriter::beginMap(size_t fieldCount) {
+	writeLength(fieldCount, 0x80, 16, 0, 0xde, 0xdf);
+	++depth;
+}
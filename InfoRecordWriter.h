@@ -0,0 +1,69 @@
+#pragma once
+#include "Platform.h"
+#include <cstdio>
+#include <vector>
+#include "JsonWriter.h"
+
+// The -info output as a stream of records, one for the summary and one per name, import and export, each written
+// out as soon as it's made. A consumer can handle one record at a time and never needs the whole output in memory.
+// Both writers have the same methods, so the same code writes either format:
+//   beginRecord starts a map with a "Record" field naming the kind of record, and endRecord finishes it;
+//   key names the next field of the current map, and the value follows it;
+//   beginArray and beginMap start a nested value with that many elements or fields, and endArray and endMap finish it.
+
+// One JSON object per line, with no spaces and no comments.
+class NdjsonRecordWriter {
+public:
+	explicit NdjsonRecordWriter(FILE* file = stdout) : out(file) { }
+	void beginRecord(const char* recordType);
+	void endRecord();
+	void key(const char* name);
+	void writeInt(long long value);
+	void writeUnsigned(unsigned long long value);
+	void writeAscii(const char* str);
+	// The suffix, if any, goes right after the string. It must be ASCII.
+	void writeString(const wchar_t* str, size_t length, const char* asciiSuffix = nullptr);
+	void beginArray(size_t count);
+	void endArray();
+	void beginMap(size_t fieldCount);
+	void endMap();
+private:
+	void separate();
+	JsonWriter out;
+	bool needsComma = false;
+};
+
+// MessagePack (https://msgpack.org): a plain sequence of maps, one per record, with every number and length
+// in its smallest encoding. Strings are UTF-8.
+class MsgPackRecordWriter {
+public:
+	explicit MsgPackRecordWriter(FILE* file = stdout);
+	MsgPackRecordWriter(const MsgPackRecordWriter&) = delete;
+	MsgPackRecordWriter& operator=(const MsgPackRecordWriter&) = delete;
+	~MsgPackRecordWriter();
+	void flush();
+	void beginRecord(const char* recordType);
+	void endRecord();
+	void key(const char* name);
+	void writeInt(long long value);
+	void writeUnsigned(unsigned long long value);
+	void writeAscii(const char* str);
+	void writeString(const wchar_t* str, size_t length, const char* asciiSuffix = nullptr);
+	void beginArray(size_t count);
+	void endArray() { --depth; }
+	void beginMap(size_t fieldCount);
+	void endMap() { --depth; }
+private:
+	void writeBuffer();
+	void writeByte(BYTE value) { buffer.push_back(value); }
+	// Big-endian, the way MessagePack stores every number.
+	void writeBigEndian(unsigned long long value, int size);
+	// The header of a string, array or map with the given length, in the smallest of its three sizes.
+	void writeLength(size_t length, BYTE fixType, size_t fixLimit, BYTE type8, BYTE type16, BYTE type32);
+	FILE* file;
+	std::vector<BYTE> buffer;
+	// Where the current record starts in the buffer. Its field count isn't known until it ends.
+	size_t recordStart = 0;
+	size_t recordFieldCount = 0;
+	int depth = 0;
+};
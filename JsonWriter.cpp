@@ -0,0 +1,180 @@
+#include "JsonWriter.h"
+#include "RunStats.h"
+#include <cstdarg>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__) || defined(_M_IX86_FP) && _M_IX86_FP >= 2
+#include <emmintrin.h>
+#define JSON_WRITER_SSE2
+#endif
+
+JsonWriter::JsonWriter(FILE* file) : file(file), buffer(0x10000) { }
+
+JsonWriter::~JsonWriter() {
+	flush();
+}
+
+void JsonWriter::flush() {
+	if (used) {
+		writeBuffer();
+	}
+	fflush(file);
+}
+
+void JsonWriter::writeBuffer() {
+	fwrite(buffer.data(), 1, used, file);
+	addRunStat(STAT_WRITE_CALLS);
+	addRunStat(STAT_BYTES_WRITTEN, used);
+	used = 0;
+}
+
+char* JsonWriter::reserve(size_t size) {
+	if (buffer.size() - used < size) {
+		if (used) {
+			writeBuffer();
+		}
+		if (buffer.size() < size) {
+			buffer.resize(size);
+		}
+	}
+	return buffer.data() + used;
+}
+
+void JsonWriter::write(const char* data, size_t size) {
+	memcpy(reserve(size), data, size);
+	used += size;
+}
+
+void JsonWriter::write(const char* str) {
+	write(str, strlen(str));
+}
+
+void JsonWriter::writeFormat(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	char* out = reserve(256);
+	int length = vsnprintf(out, buffer.size() - used, format, args);
+	va_end(args);
+	if (length < 0) return;
+	if ((size_t)length >= buffer.size() - used) {
+		out = reserve((size_t)length + 1);
+		va_start(args, format);
+		vsnprintf(out, (size_t)length + 1, format, args);
+		va_end(args);
+	}
+	used += length;
+}
+
+static inline bool isPlain(unsigned int codePoint) {
+	return codePoint >= 0x20 && codePoint <= 126 && codePoint != '\\' && codePoint != '\"';
+}
+
+#ifdef JSON_WRITER_SSE2
+static inline unsigned int countTrailingZeros(unsigned int mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// Loads 8 characters into 16-bit lanes, along with a mask of the ones that aren't plain.
+// Characters of 0x8000 and above compare as negative, so they end up below 0x20 and get escaped too.
+template<size_t CharSize>
+struct WideLoad;
+
+template<>
+struct WideLoad<2> {
+	static void load8(const wchar_t* src, __m128i& chars, __m128i& special) {
+		chars = _mm_loadu_si128((const __m128i*)src);
+		special = _mm_or_si128(
+			_mm_or_si128(_mm_cmplt_epi16(chars, _mm_set1_epi16(0x20)), _mm_cmpgt_epi16(chars, _mm_set1_epi16(126))),
+			_mm_or_si128(_mm_cmpeq_epi16(chars, _mm_set1_epi16('\\')), _mm_cmpeq_epi16(chars, _mm_set1_epi16('\"'))));
+	}
+};
+
+// Where wchar_t is UTF-32.
+template<>
+struct WideLoad<4> {
+	static __m128i findSpecial(__m128i chars) {
+		return _mm_or_si128(
+			_mm_or_si128(_mm_cmplt_epi32(chars, _mm_set1_epi32(0x20)), _mm_cmpgt_epi32(chars, _mm_set1_epi32(126))),
+			_mm_or_si128(_mm_cmpeq_epi32(chars, _mm_set1_epi32('\\')), _mm_cmpeq_epi32(chars, _mm_set1_epi32('\"'))));
+	}
+	static void load8(const wchar_t* src, __m128i& chars, __m128i& special) {
+		__m128i low = _mm_loadu_si128((const __m128i*)src);
+		__m128i high = _mm_loadu_si128((const __m128i*)(src + 4));
+		chars = _mm_packs_epi32(low, high);
+		special = _mm_packs_epi32(findSpecial(low), findSpecial(high));
+	}
+};
+#endif
+
+// Copies the characters that need no escaping from the start of src into dst, narrowed to bytes,
+// and returns how many there were. dst must have room for length bytes.
+static size_t copyPlain(const wchar_t* src, size_t length, char* dst) {
+	size_t i = 0;
+#ifdef JSON_WRITER_SSE2
+	// 16 characters at a time. If one of them needs escaping, the whole 16 still get stored, but only the ones
+	// before it count.
+	for (; i + 16 <= length; i += 16) {
+		__m128i charsLow, specialLow, charsHigh, specialHigh;
+		WideLoad<sizeof(wchar_t)>::load8(src + i, charsLow, specialLow);
+		WideLoad<sizeof(wchar_t)>::load8(src + i + 8, charsHigh, specialHigh);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(charsLow, charsHigh));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_packs_epi16(specialLow, specialHigh));
+		if (mask) {
+			return i + countTrailingZeros(mask);
+		}
+	}
+#endif
+	for (; i < length && isPlain((unsigned int)src[i]); ++i) {
+		dst[i] = (char)src[i];
+	}
+	return i;
+}
+
+// Writes the escape sequence for one character that isn't plain and returns its length. Needs up to 12 bytes.
+static size_t escapeChar(unsigned int codePoint, char* out) {
+	static const char hexDigits[] = "0123456789abcdef";
+	switch (codePoint) {
+	case '\n': memcpy(out, "\\n", 2); return 2;
+	case '\t': memcpy(out, "\\t", 2); return 2;
+	case '\r': memcpy(out, "\\r", 2); return 2;
+	case '\f': memcpy(out, "\\f", 2); return 2;
+	case '\b': memcpy(out, "\\b", 2); return 2;
+	case '\\': memcpy(out, "\\\\", 2); return 2;
+	case '\"': memcpy(out, "\\\"", 2); return 2;
+	}
+	if (codePoint > 0xffff) {
+		// Only where wchar_t is UTF-32. Python writes these as a surrogate pair.
+		codePoint -= 0x10000;
+		size_t length = escapeChar(0xd800 + (codePoint >> 10), out);
+		return length + escapeChar(0xdc00 + (codePoint & 0x3ff), out + length);
+	}
+	out[0] = '\\';
+	out[1] = 'u';
+	out[2] = hexDigits[(codePoint >> 12) & 0xf];
+	out[3] = hexDigits[(codePoint >> 8) & 0xf];
+	out[4] = hexDigits[(codePoint >> 4) & 0xf];
+	out[5] = hexDigits[codePoint & 0xf];
+	return 6;
+}
+
+void JsonWriter::writeEscaped(const wchar_t* str, size_t length) {
+	const size_t maxRunLength = 0x1000;
+	size_t i = 0;
+	while (i < length) {
+		size_t runLength = (std::min)(length - i, maxRunLength);
+		size_t plainLength = copyPlain(str + i, runLength, reserve(runLength));
+		used += plainLength;
+		i += plainLength;
+		if (plainLength < runLength) {
+			used += escapeChar((unsigned int)str[i], reserve(12));
+			++i;
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "Platform.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Collects output in a buffer and writes it to a FILE in large pieces, instead of a printf call per field.
+// Whatever is still buffered is written by flush or the destructor.
+class JsonWriter {
+public:
+	explicit JsonWriter(FILE* file = stdout);
+	JsonWriter(const JsonWriter&) = delete;
+	JsonWriter& operator=(const JsonWriter&) = delete;
+	~JsonWriter();
+	void flush();
+	void write(const char* str);
+	void write(const char* data, size_t size);
+	// Same format as printf.
+	void writeFormat(const char* format, ...);
+	// Escapes non-ASCII characters, \, " and control characters just the way python json.dumps(ensure_ascii=True) does it.
+	// Doesn't put quotation marks around the string.
+	void writeEscaped(const wchar_t* str, size_t length);
+	void writeEscaped(const std::wstring& str) { writeEscaped(str.c_str(), str.size()); }
+private:
+	// Makes sure there's room for size more bytes in the buffer and returns where they go.
+	char* reserve(size_t size);
+	void writeBuffer();
+	FILE* file;
+	std::vector<char> buffer;
+	size_t used = 0;
+};
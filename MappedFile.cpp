@@ -0,0 +1,96 @@
+#include "MappedFile.h"
+#include "RunStats.h"
+#include <limits>
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/mman.h>
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+static DWORD getLastSystemError() {
+	return GetLastError();
+}
+
+static void setLastSystemError(DWORD err) {
+	SetLastError(err);
+}
+#else
+static int getLastSystemError() {
+	return errno;
+}
+
+static void setLastSystemError(int err) {
+	errno = err;
+}
+#endif
+
+bool MappedFile::open(LPCWSTR path) {
+	close();
+	if (!file.open(path, FILE_MODE_READ)) {
+		return false;
+	}
+	addRunStat(STAT_FILES_OPENED);
+	unsigned long long size = 0;
+	if (!file.getSize(size) || !file.getWriteTime(lastWriteTime)) {
+		auto err = getLastSystemError();
+		close();
+		setLastSystemError(err);
+		return false;
+	}
+	// A 32-bit build can't map a file of 4 GB or more, so it says so rather than mapping the start of it.
+	if (size > (std::numeric_limits<size_t>::max)()) {
+		close();
+#ifdef _WIN32
+		setLastSystemError(ERROR_FILE_TOO_LARGE);
+#else
+		setLastSystemError(EFBIG);
+#endif
+		return false;
+	}
+	fileSize = (size_t)size;
+	if (fileSize == 0) {
+		// Empty files can't be mapped. The parser will report them as too short.
+		return true;
+	}
+#ifdef _WIN32
+	mappingHandle = CreateFileMappingW(file.getHandle(), NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle) {
+		view = (const BYTE*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	void* address = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, file.getDescriptor(), 0);
+	view = address == MAP_FAILED ? nullptr : (const BYTE*)address;
+#endif
+	if (!view) {
+		auto err = getLastSystemError();
+		close();
+		setLastSystemError(err);
+		return false;
+	}
+	addRunStat(STAT_BYTES_MAPPED, fileSize);
+	return true;
+}
+
+void MappedFile::close() {
+	if (view) {
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+#else
+		munmap((void*)view, fileSize);
+#endif
+		view = nullptr;
+	}
+#ifdef _WIN32
+	if (mappingHandle) {
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+#endif
+	file.close();
+	fileSize = 0;
+	lastWriteTime = 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "FileIo.h"
+
+// Maps a whole file into memory for reading, so that parsing it doesn't need a read call per field.
+// The file is opened with shared read access, same as the other files this program opens for reading.
+// CreateFileMapping on Windows, mmap elsewhere.
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+	// On failure returns false and WinError holds the reason.
+	bool open(LPCWSTR path);
+	void close();
+	const BYTE* data() const { return view; }
+	size_t size() const { return fileSize; }
+	// FILETIME of the last write, as one number.
+	unsigned long long getLastWriteTime() const { return lastWriteTime; }
+private:
+	File file;
+#ifdef _WIN32
+	HANDLE mappingHandle = NULL;
+#endif
+	const BYTE* view = nullptr;
+	size_t fileSize = 0;
+	unsigned long long lastWriteTime = 0;
+};
@@ -0,0 +1,223 @@
+#include "PackageDiff.h"
+#include "RunStats.h"
+#include <algorithm>
+#include <cwctype>
+
+// The path from the outermost object down of every import and export, at objectIndex + the import count,
+// so that object index 0 has an empty path. Each path is built from its outer's, so every outer is built only once.
+static std::vector<std::wstring> getAllObjectPaths(const UpkPackage& package) {
+	const int importCount = (int)package.importTable.imports.size();
+	std::vector<std::wstring> paths(importCount + package.exportTable.size() + 1);
+	std::vector<char> states(paths.size(), 0);  // 0 - not built, 1 - being built, 2 - built
+	states[importCount] = 2;
+	std::vector<int> chain;
+	for (int start = -importCount; start <= package.exportTable.size(); ++start) {
+		chain.clear();
+		int objectIndex = start;
+		// Only the exports' chains of outers are checked for loops. An object in a loop gets just its own name.
+		while (states[objectIndex + importCount] == 0) {
+			states[objectIndex + importCount] = 1;
+			chain.push_back(objectIndex);
+			objectIndex = objectIndex < 0
+				? package.importTable.imports[-objectIndex - 1].outerIndex
+				: package.exportTable.outerIndices[objectIndex - 1];
+		}
+		for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+			const int current = *it;
+			const int outer = current < 0
+				? package.importTable.imports[-current - 1].outerIndex
+				: package.exportTable.outerIndices[current - 1];
+			std::wstring& path = paths[current + importCount];
+			if (outer != 0 && states[outer + importCount] == 2) {
+				path = paths[outer + importCount] + L'.';
+			}
+			path += nameDataToString(package.nameTable, *package.getObjectNameData(current));
+			states[current + importCount] = 2;
+		}
+	}
+	return paths;
+}
+
+// The keys in upper case, so that they can be sorted and compared ignoring case without folding it on every comparison.
+static std::vector<std::wstring> foldCase(const std::vector<std::wstring>& keys) {
+	std::vector<std::wstring> folded(keys);
+	for (std::wstring& key : folded) {
+		for (wchar_t& c : key) {
+			c = towupper(c);
+		}
+	}
+	return folded;
+}
+
+static std::vector<int> getOrderByKey(const std::vector<std::wstring>& keys) {
+	std::vector<int> order(keys.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i] = (int)i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&keys](int x, int y) {
+		return keys[x] < keys[y];
+	});
+	return order;
+}
+
+// Pairs up the entries of a and b that have the same key, ignoring case, the same as the engine compares names.
+// A key that's there more than once is paired in table order. Everything comes out in table order.
+static void matchKeys(const std::vector<std::wstring>& a, const std::vector<std::wstring>& b,
+		std::vector<std::pair<int, int>>& pairs, std::vector<int>& onlyInA, std::vector<int>& onlyInB) {
+	const std::vector<std::wstring> foldedA = foldCase(a);
+	const std::vector<std::wstring> foldedB = foldCase(b);
+	const std::vector<int> orderA = getOrderByKey(foldedA);
+	const std::vector<int> orderB = getOrderByKey(foldedB);
+	size_t i = 0;
+	size_t j = 0;
+	while (i < orderA.size() && j < orderB.size()) {
+		const int comparison = foldedA[orderA[i]].compare(foldedB[orderB[j]]);
+		if (comparison < 0) {
+			onlyInA.push_back(orderA[i++]);
+		} else if (comparison > 0) {
+			onlyInB.push_back(orderB[j++]);
+		} else {
+			pairs.emplace_back(orderA[i++], orderB[j++]);
+		}
+	}
+	onlyInA.insert(onlyInA.end(), orderA.begin() + i, orderA.end());
+	onlyInB.insert(onlyInB.end(), orderB.begin() + j, orderB.end());
+	std::sort(pairs.begin(), pairs.end());
+	std::sort(onlyInA.begin(), onlyInA.end());
+	std::sort(onlyInB.begin(), onlyInB.end());
+}
+
+// Matches the two tables and lists the keys found on only one side.
+static std::vector<std::pair<int, int>> matchTables(const std::vector<std::wstring>& a, const std::vector<std::wstring>& b,
+		std::vector<std::wstring>& keysOnlyInA, std::vector<std::wstring>& keysOnlyInB) {
+	std::vector<std::pair<int, int>> pairs;
+	std::vector<int> onlyInA;
+	std::vector<int> onlyInB;
+	matchKeys(a, b, pairs, onlyInA, onlyInB);
+	for (int index : onlyInA) {
+		keysOnlyInA.push_back(a[index]);
+	}
+	for (int index : onlyInB) {
+		keysOnlyInB.push_back(b[index]);
+	}
+	return pairs;
+}
+
+static std::vector<std::wstring> getNames(const UpkPackage& package) {
+	std::vector<std::wstring> names(package.nameTable.size());
+	for (int i = 0; i < package.nameTable.size(); ++i) {
+		names[i].assign(package.nameTable.getName(i), package.nameTable.getNameLength(i));
+	}
+	return names;
+}
+
+static std::vector<std::wstring> getImportKeys(const UpkPackage& package, const std::vector<std::wstring>& objectPaths) {
+	const TableArray<Import>& imports = package.importTable.imports;
+	std::vector<std::wstring> keys(imports.size());
+	for (size_t i = 0; i < imports.size(); ++i) {
+		keys[i] = objectPaths[imports.size() - 1 - i] + L" ("
+			+ nameDataToString(package.nameTable, imports[i].classPackage) + L'.'
+			+ nameDataToString(package.nameTable, imports[i].className) + L')';
+	}
+	return keys;
+}
+
+static std::vector<std::wstring> getExportPaths(const UpkPackage& package, const std::vector<std::wstring>& objectPaths) {
+	const size_t firstExport = package.importTable.imports.size() + 1;
+	return std::vector<std::wstring>(objectPaths.begin() + firstExport, objectPaths.end());
+}
+
+bool PackageDiff::compare(UpkPackage& a, UpkPackage& b) {
+	summaryChanges.clear();
+	namesOnlyInA.clear();
+	namesOnlyInB.clear();
+	importsOnlyInA.clear();
+	importsOnlyInB.clear();
+	exportsOnlyInA.clear();
+	exportsOnlyInB.clear();
+	changedExports.clear();
+	error.clear();
+	std::vector<unsigned long long> hashesA;
+	std::vector<unsigned long long> hashesB;
+	if (!a.hashExports(hashesA)) {
+		error = a.getError();
+		return false;
+	}
+	if (!b.hashExports(hashesB)) {
+		error = b.getError();
+		return false;
+	}
+
+	ScopedPhase phase("Compare packages");
+	const SummaryChange summaryFields[] {
+		{ "Main engine version", a.summary.mainEngineVersion(), b.summary.mainEngineVersion() },
+		{ "Licensee version", a.summary.licenseeVersion(), b.summary.licenseeVersion() },
+		{ "Package flags", a.summary.packageFlags, b.summary.packageFlags },
+		{ "Engine version", a.summary.engineVersion, b.summary.engineVersion },
+		{ "Cooked content version", a.summary.cookedContentVersion, b.summary.cookedContentVersion },
+		{ "Compression flags", a.summary.compressionFlags, b.summary.compressionFlags }
+	};
+	for (const SummaryChange& field : summaryFields) {
+		if (field.a != field.b) {
+			summaryChanges.push_back(field);
+		}
+	}
+
+	const std::vector<std::wstring> pathsA = getAllObjectPaths(a);
+	const std::vector<std::wstring> pathsB = getAllObjectPaths(b);
+	const int importCountA = (int)a.importTable.imports.size();
+	const int importCountB = (int)b.importTable.imports.size();
+	auto isSameObject = [&](int objectIndexA, int objectIndexB) {
+		const std::wstring& pathA = pathsA[objectIndexA + importCountA];
+		const std::wstring& pathB = pathsB[objectIndexB + importCountB];
+		return pathA == pathB || _wcsicmp(pathA.c_str(), pathB.c_str()) == 0;
+	};
+
+	matchTables(getNames(a), getNames(b), namesOnlyInA, namesOnlyInB);
+	matchTables(getImportKeys(a, pathsA), getImportKeys(b, pathsB), importsOnlyInA, importsOnlyInB);
+
+	const ExportTable& exportsA = a.exportTable;
+	const ExportTable& exportsB = b.exportTable;
+	for (const std::pair<int, int>& match
+			: matchTables(getExportPaths(a, pathsA), getExportPaths(b, pathsB), exportsOnlyInA, exportsOnlyInB)) {
+		const int i = match.first;
+		const int j = match.second;
+		ChangedExport changed { pathsA[i + 1 + importCountA], i, j, {} };
+		if (!isSameObject(exportsA.classIndices[i], exportsB.classIndices[j])) {
+			changed.changes.push_back("Class");
+		}
+		if (!isSameObject(exportsA.superIndices[i], exportsB.superIndices[j])) {
+			changed.changes.push_back("Super");
+		}
+		if (!isSameObject(exportsA.archetypeIndices[i], exportsB.archetypeIndices[j])) {
+			changed.changes.push_back("Archetype");
+		}
+		if (exportsA.objectFlags[i] != exportsB.objectFlags[j]) {
+			changed.changes.push_back("Object flags");
+		}
+		if (exportsA.exportFlags[i] != exportsB.exportFlags[j]) {
+			changed.changes.push_back("Export flags");
+		}
+		if (exportsA.packageFlags[i] != exportsB.packageFlags[j]) {
+			changed.changes.push_back("Package flags");
+		}
+		if (exportsA.serializeSizes[i] != exportsB.serializeSizes[j]) {
+			changed.changes.push_back("Serialize size");
+		}
+		if (hashesA[i] != hashesB[j]) {
+			changed.changes.push_back("Data");
+		}
+		if (!changed.changes.empty()) {
+			changedExports.push_back(std::move(changed));
+		}
+	}
+	return true;
+}
+
+bool PackageDiff::isEmpty() const {
+	return summaryChanges.empty()
+		&& namesOnlyInA.empty() && namesOnlyInB.empty()
+		&& importsOnlyInA.empty() && importsOnlyInB.empty()
+		&& exportsOnlyInA.empty() && exportsOnlyInB.empty()
+		&& changedExports.empty();
+}
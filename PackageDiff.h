@@ -0,0 +1,44 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include "UpkPackage.h"
+
+// What differs between two versions of a package, A and B, such as an original and its repackaged copy.
+// Exports and imports are matched by their path inside the package rather than by index, so an export that only
+// moved in the table isn't a difference. Where an export's data is in the file isn't compared either, since
+// repackaging moves it, but its contents are, by hash.
+class PackageDiff {
+public:
+	struct SummaryChange {
+		const char* field;
+		long long a;
+		long long b;
+	};
+	struct ChangedExport {
+		// Outer1.Outer2.ObjectName
+		std::wstring path;
+		int indexA;
+		int indexB;
+		// Which of the export's fields differ, like "Class" or "Data".
+		std::vector<const char*> changes;
+	};
+	// The paths are built here from the name table, so the packages can be opened with setLazyNames. The exports
+	// are hashed on the packages' own threads, see UpkPackage::hashExports. On failure returns false and getError() says why.
+	bool compare(UpkPackage& a, UpkPackage& b);
+	bool isEmpty() const;
+	// Only the fields of the summary that describe the package rather than where its parts are in the file.
+	std::vector<SummaryChange> summaryChanges;
+	std::vector<std::wstring> namesOnlyInA;
+	std::vector<std::wstring> namesOnlyInB;
+	// Path (ClassPackage.ClassName)
+	std::vector<std::wstring> importsOnlyInA;
+	std::vector<std::wstring> importsOnlyInB;
+	std::vector<std::wstring> exportsOnlyInA;
+	std::vector<std::wstring> exportsOnlyInB;
+	// In the order of package A's export table.
+	std::vector<ChangedExport> changedExports;
+	const std::wstring& getError() const { return error; }
+private:
+	std::wstring error;
+};
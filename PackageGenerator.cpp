@@ -0,0 +1,312 @@
+#include "PackageGenerator.h"
+#include "UpkPackage.h"
+#include "WinError.h"
+#include "FileIo.h"
+#include <algorithm>
+#include <cstdarg>
+
+// Names every package has, in this order, followed by generated ones that the objects are named with.
+static const char* const fixedNames[] {
+	"None", "Core", "Engine", "Class", "Package", "GeneratedImports",
+	"Texture2D", "StaticMesh", "SoundNodeWave", "Material"
+};
+enum FixedName {
+	NAME_None, NAME_Core, NAME_Engine, NAME_Class, NAME_Package, NAME_GeneratedImports,
+	NAME_Texture2D, NAME_StaticMesh, NAME_SoundNodeWave, NAME_Material,
+	FIXED_NAME_COUNT
+};
+// The imports that come before the generated ones. The exports use the classes as their classes.
+#define IMPORT_CORE					-1
+#define IMPORT_ENGINE				-2
+#define IMPORT_GENERATED_IMPORTS	-3
+#define IMPORT_PACKAGE_CLASS		-4
+#define IMPORT_FIRST_OBJECT_CLASS	-5
+#define OBJECT_CLASS_COUNT			4
+
+template<typename T>
+static void append(std::vector<BYTE>& out, T value) {
+	size_t oldSize = out.size();
+	out.resize(oldSize + sizeof(T));
+	memcpy(out.data() + oldSize, &value, sizeof(T));
+}
+
+static void appendString(std::vector<BYTE>& out, const std::string& str) {
+	append(out, (int)str.size() + 1);
+	out.insert(out.end(), str.begin(), str.end());
+	out.push_back(0);
+}
+
+static void appendName(std::vector<BYTE>& out, int nameIndex, int numberPart) {
+	append(out, nameIndex);
+	append(out, numberPart);
+}
+
+static void patch(std::vector<BYTE>& out, size_t position, int value) {
+	memcpy(out.data() + position, &value, 4);
+}
+
+bool PackageGenerator::fail(const wchar_t* format, ...) {
+	wchar_t buffer[1024];
+	va_list args;
+	va_start(args, format);
+	vswprintf(buffer, _countof(buffer), format, args);
+	va_end(args);
+	error = buffer;
+	return false;
+}
+
+// xorshift32. Good enough for filler data and always the same for the same seed.
+unsigned int PackageGenerator::nextRandom() {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+void PackageGenerator::planTables() {
+	names.assign(std::begin(fixedNames), std::end(fixedNames));
+	const int generatedNameCount = (std::max)(settings.nameCount - FIXED_NAME_COUNT, 1);
+	for (int i = 0; i < generatedNameCount; ++i) {
+		names.push_back("Object" + std::to_string(i));
+	}
+
+	// Objects named with the same generated name get different number parts, so every path is unique.
+	imports.clear();
+	imports.push_back(ImportInfo { NAME_Core, NAME_Package, 0, NAME_Core, 0 });
+	imports.push_back(ImportInfo { NAME_Core, NAME_Package, 0, NAME_Engine, 0 });
+	imports.push_back(ImportInfo { NAME_Core, NAME_Package, 0, NAME_GeneratedImports, 0 });
+	imports.push_back(ImportInfo { NAME_Core, NAME_Class, IMPORT_CORE, NAME_Package, 0 });
+	for (int i = 0; i < OBJECT_CLASS_COUNT; ++i) {
+		imports.push_back(ImportInfo { NAME_Core, NAME_Class, IMPORT_ENGINE, NAME_Texture2D + i, 0 });
+	}
+	for (int i = 0; i < settings.importCount; ++i) {
+		imports.push_back(ImportInfo { NAME_Engine, NAME_Texture2D, IMPORT_GENERATED_IMPORTS,
+			FIXED_NAME_COUNT + i % generatedNameCount, i / generatedNameCount });
+	}
+
+	// The packages form a tree: package p is inside package (p - 1) / 2, so each level is twice the size of the previous.
+	const int maxPackageCount = settings.depth >= 20 ? INT_MAX : (1 << settings.depth) - 1;
+	const int packageCount = (std::min)(maxPackageCount, settings.exportCount / 2);
+	exports.assign(settings.exportCount, ExportInfo());
+	for (int i = 0; i < settings.exportCount; ++i) {
+		ExportInfo& exportInfo = exports[i];
+		if (i < packageCount) {
+			exportInfo.classIndex = IMPORT_PACKAGE_CLASS;
+			exportInfo.outerIndex = i == 0 ? 0 : (i - 1) / 2 + 1;
+		} else {
+			exportInfo.classIndex = IMPORT_FIRST_OBJECT_CLASS - (int)(nextRandom() % OBJECT_CLASS_COUNT);
+			exportInfo.outerIndex = packageCount == 0 ? 0 : (int)(nextRandom() % packageCount) + 1;
+		}
+		exportInfo.nameIndex = FIXED_NAME_COUNT + i % generatedNameCount;
+		exportInfo.numberPart = i / generatedNameCount;
+		exportInfo.serializeSize = settings.minPayloadSize
+			+ (int)(nextRandom() % ((unsigned int)(settings.maxPayloadSize - settings.minPayloadSize) + 1));
+	}
+}
+
+void PackageGenerator::writeHeader(std::vector<BYTE>& header) {
+	const int version = settings.fileVersion;
+	header.clear();
+	append(header, (DWORD)PACKAGE_FILE_TAG);
+	append(header, version);
+	const size_t totalHeaderSizePosition = header.size();
+	append(header, 0);
+	appendString(header, "None");
+	append(header, (DWORD)0);  // package flags
+	append(header, (int)names.size());
+	const size_t nameOffsetPosition = header.size();
+	append(header, 0);
+	append(header, (int)exports.size());
+	const size_t exportOffsetPosition = header.size();
+	append(header, 0);
+	append(header, (int)imports.size());
+	const size_t importOffsetPosition = header.size();
+	append(header, 0);
+	const size_t dependsOffsetPosition = header.size();
+	append(header, 0);
+	size_t importExportGuidOffsetsPosition = 0;
+	if (version >= 623) {
+		importExportGuidOffsetsPosition = header.size();
+		append(header, 0);
+		append(header, 0);  // import guids count
+		append(header, 0);  // export guids count
+	}
+	if (version >= 584) {
+		append(header, 0);  // thumbnail table offset
+	}
+	for (int i = 0; i < 4; ++i) {
+		append(header, nextRandom());
+	}
+	append(header, 1);  // generation count
+	append(header, (int)exports.size());
+	append(header, (int)names.size());
+	append(header, 0);  // net object count
+	append(header, 12791);  // engine version
+	append(header, 0);  // cooked content version
+	append(header, (DWORD)0);  // compression flags
+	append(header, 0);  // compressed chunks count
+	append(header, nextRandom());  // package source
+	if (version >= 516) {
+		append(header, 0);  // additional packages to cook count
+	}
+	if (version >= 767) {
+		append(header, 0);  // texture types count
+	}
+
+	patch(header, nameOffsetPosition, (int)header.size());
+	for (const std::string& name : names) {
+		appendString(header, name);
+		append(header, 0x0007001000000000ULL);
+	}
+
+	patch(header, importOffsetPosition, (int)header.size());
+	for (const ImportInfo& importInfo : imports) {
+		appendName(header, importInfo.classPackageIndex, 0);
+		appendName(header, importInfo.classNameIndex, 0);
+		append(header, importInfo.outerIndex);
+		appendName(header, importInfo.nameIndex, importInfo.numberPart);
+	}
+
+	patch(header, exportOffsetPosition, (int)header.size());
+	std::vector<size_t> serialOffsetPositions(exports.size());
+	for (size_t i = 0; i < exports.size(); ++i) {
+		const ExportInfo& exportInfo = exports[i];
+		append(header, exportInfo.classIndex);
+		append(header, 0);  // super index
+		append(header, exportInfo.outerIndex);
+		appendName(header, exportInfo.nameIndex, exportInfo.numberPart);
+		append(header, 0);  // archetype index
+		append(header, 0x000F000400000000ULL);  // object flags
+		append(header, exportInfo.serializeSize);
+		serialOffsetPositions[i] = header.size();
+		append(header, 0);
+		if (version < 543) {
+			append(header, 0);  // component map count
+		}
+		append(header, (DWORD)0);  // export flags
+		append(header, 1);  // generation net object count count
+		append(header, 0);
+		for (int guidPart = 0; guidPart < 4; ++guidPart) {
+			append(header, 0);
+		}
+		append(header, (DWORD)0);  // package flags
+	}
+
+	patch(header, dependsOffsetPosition, (int)header.size());
+	for (size_t i = 0; i < exports.size(); ++i) {
+		append(header, 0);  // no dependencies
+	}
+	if (version >= 623) {
+		patch(header, importExportGuidOffsetsPosition, (int)header.size());
+	}
+
+	patch(header, totalHeaderSizePosition, (int)header.size());
+	int serialOffset = (int)header.size();
+	for (size_t i = 0; i < exports.size(); ++i) {
+		exports[i].serialOffset = serialOffset;
+		patch(header, serialOffsetPositions[i], serialOffset);
+		serialOffset += exports[i].serializeSize;
+	}
+}
+
+std::wstring PackageGenerator::getExportName(int exportIndex) const {
+	const ExportInfo& exportInfo = exports[exportIndex];
+	const std::string& name = names[exportInfo.nameIndex];
+	std::wstring result(name.begin(), name.end());
+	if (exportInfo.numberPart) {
+		result += L'_' + std::to_wstring(exportInfo.numberPart - 1);
+	}
+	return result;
+}
+
+bool PackageGenerator::createFolder(const std::wstring& path) {
+	if (!::createFolder(path.c_str())) {
+		WinError err;
+		return fail(L"Failed to create folder %ls: %ls", path.c_str(), err.getMessage());
+	}
+	return true;
+}
+
+bool PackageGenerator::writeFile(File& file, const std::wstring& path, const BYTE* data, size_t size,
+		unsigned long long offset) {
+	if (!file.writeAt(data, size, offset)) {
+		WinError err;
+		return fail(L"Failed to write file %ls: %ls", path.c_str(), err.getMessage());
+	}
+	return true;
+}
+
+bool PackageGenerator::generate(const GeneratorSettings& newSettings, LPCWSTR packagePath, LPCWSTR extractedFolder) {
+	settings = newSettings;
+	settings.nameCount = (std::max)(settings.nameCount, 0);
+	settings.importCount = (std::max)(settings.importCount, 0);
+	settings.exportCount = (std::max)(settings.exportCount, 0);
+	settings.depth = (std::max)(settings.depth, 0);
+	settings.minPayloadSize = (std::max)(settings.minPayloadSize, 0);
+	settings.maxPayloadSize = (std::max)(settings.maxPayloadSize, settings.minPayloadSize);
+	randomState = settings.seed ? settings.seed : 1;
+	error.clear();
+	packageSize = 0;
+
+	planTables();
+	unsigned long long payloadsSize = 0;
+	for (const ExportInfo& exportInfo : exports) {
+		payloadsSize += exportInfo.serializeSize;
+	}
+	std::vector<BYTE> header;
+	writeHeader(header);
+	if (header.size() + payloadsSize > INT_MAX) {
+		return fail(L"The package would be over 2 GB.");
+	}
+
+	if (!createFolder(extractedFolder)) return false;
+	std::wstring folder = extractedFolder;
+	if (!folder.empty() && folder[folder.size() - 1] != PATH_SEPARATOR) {
+		folder += PATH_SEPARATOR;
+	}
+	// Package exports come first, and their outers before them, so their folders can be made in one pass.
+	std::vector<std::wstring> exportFolders(exports.size());
+	for (size_t i = 0; i < exports.size(); ++i) {
+		int outer = exports[i].outerIndex - 1;
+		exportFolders[i] = outer >= 0 ? exportFolders[outer] + getExportName(outer) + PATH_SEPARATOR : folder;
+		if (exports[i].classIndex == IMPORT_PACKAGE_CLASS) {
+			if (!createFolder(exportFolders[i] + getExportName((int)i))) return false;
+		}
+	}
+
+	File packageFile;
+	if (!packageFile.open(packagePath, FILE_MODE_CREATE_ALWAYS)) {
+		WinError err;
+		return fail(L"Failed to create file at location: %ls\n%ls", packagePath, err.getMessage());
+	}
+	bool success = writeFile(packageFile, packagePath, header.data(), header.size(), 0);
+	unsigned long long packageOffset = header.size();
+	std::vector<BYTE> payload;
+	for (size_t i = 0; i < exports.size() && success; ++i) {
+		const ExportInfo& exportInfo = exports[i];
+		payload.resize(exportInfo.serializeSize);
+		for (size_t position = 0; position < payload.size(); position += 4) {
+			unsigned int value = nextRandom();
+			memcpy(payload.data() + position, &value, (std::min)((size_t)4, payload.size() - position));
+		}
+		success = writeFile(packageFile, packagePath, payload.data(), payload.size(), packageOffset);
+		if (!success) break;
+		packageOffset += payload.size();
+
+		const std::string& className = names[imports[-exportInfo.classIndex - 1].nameIndex];
+		std::wstring path = exportFolders[i] + getExportName((int)i) + L'.'
+			+ std::wstring(className.begin(), className.end());
+		File file;
+		if (!file.open(path.c_str(), FILE_MODE_CREATE_ALWAYS)) {
+			WinError err;
+			success = fail(L"Failed to create file at location: %ls\n%ls", path.c_str(), err.getMessage());
+			break;
+		}
+		success = writeFile(file, path, payload.data(), payload.size(), 0);
+	}
+	packageFile.close();
+	if (success) {
+		packageSize = header.size() + payloadsSize;
+	}
+	return success;
+}
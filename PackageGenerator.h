@@ -0,0 +1,64 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+
+class File;
+
+// What kind of package PackageGenerator makes. The defaults make a small package of the newest version.
+struct GeneratorSettings {
+	// Main engine version. The layout of the summary and the export table depends on whether it's below
+	// or at least 516, 543, 584, 623 and 767, the same versions UpkPackage checks when parsing.
+	int fileVersion = 868;
+	int nameCount = 1000;
+	// Imports of objects from another package, on top of the few that the exports need for their classes.
+	int importCount = 100;
+	int exportCount = 2000;
+	// How many levels of Package exports the other exports are put in. 0 puts all of them at the top.
+	// Every level has twice as many packages as the one above it.
+	int depth = 3;
+	int minPayloadSize = 16;
+	int maxPayloadSize = 4096;
+	unsigned int seed = 1;
+};
+
+// Writes a valid uncompressed package filled with random data, along with the folder that gildor's extract
+// tool would extract from it. Repackaging the folder gives back exactly the same package.
+class PackageGenerator {
+public:
+	// The extracted folder is created if it doesn't exist. The package is overwritten if it exists.
+	bool generate(const GeneratorSettings& settings, LPCWSTR packagePath, LPCWSTR extractedFolder);
+	const std::wstring& getError() const { return error; }
+	// The total size of the package that was generated last.
+	unsigned long long getPackageSize() const { return packageSize; }
+private:
+	struct ImportInfo {
+		int classPackageIndex = 0;
+		int classNameIndex = 0;
+		int outerIndex = 0;
+		int nameIndex = 0;
+		int numberPart = 0;
+	};
+	struct ExportInfo {
+		int classIndex = 0;
+		int outerIndex = 0;
+		int nameIndex = 0;
+		int numberPart = 0;
+		int serializeSize = 0;
+		int serialOffset = 0;
+	};
+	void planTables();
+	void writeHeader(std::vector<BYTE>& header);
+	bool createFolder(const std::wstring& path);
+	bool writeFile(File& file, const std::wstring& path, const BYTE* data, size_t size, unsigned long long offset);
+	std::wstring getExportName(int exportIndex) const;
+	unsigned int nextRandom();
+	bool fail(const wchar_t* format, ...);
+	GeneratorSettings settings;
+	unsigned int randomState = 0;
+	std::vector<std::string> names;
+	std::vector<ImportInfo> imports;
+	std::vector<ExportInfo> exports;
+	unsigned long long packageSize = 0;
+	std::wstring error;
+};
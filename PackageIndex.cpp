@@ -0,0 +1,166 @@
+#include "PackageIndex.h"
+#include "MappedFile.h"
+#include "FileIo.h"
+#include "Hash.h"
+#include "RunStats.h"
+#include <algorithm>
+
+#define INDEX_TAG 0x584B5055  // "UPKX"
+#define INDEX_VERSION 2
+// The arrays are stored the way they are in memory, so these two decide whether a build can read an index.
+#define INDEX_LAYOUT ((unsigned int)(sizeof(wchar_t) << 8 | sizeof(size_t)))
+
+struct IndexHeader {
+	unsigned int tag;
+	unsigned int version;
+	unsigned int layout;
+	unsigned int padding;
+	unsigned long long packageSize;
+	unsigned long long packageWriteTime;
+	UEGuid packageGuid;
+	// Everything after the header, which is the arrays.
+	unsigned long long bodySize;
+	unsigned long long bodyHash;
+};
+
+// Every array is its element count as 8 bytes, then the elements, then zeros up to a multiple of 8 bytes,
+// so that every array starts aligned for any of the element types.
+template<typename T>
+static void appendArray(std::vector<BYTE>& buffer, const T* values, size_t count) {
+	unsigned long long storedCount = count;
+	const BYTE* countBytes = (const BYTE*)&storedCount;
+	buffer.insert(buffer.end(), countBytes, countBytes + sizeof storedCount);
+	const BYTE* bytes = (const BYTE*)values;
+	buffer.insert(buffer.end(), bytes, bytes + count * sizeof(T));
+	buffer.resize((buffer.size() + 7) & ~(size_t)7, 0);
+}
+
+template<typename T>
+static void appendArray(std::vector<BYTE>& buffer, const TableArray<T>& values) {
+	appendArray(buffer, values.data(), values.size());
+}
+
+// Goes over the arrays in the order they were appended and points the tables' arrays at them, right where they are
+// in the mapped file, so loading copies nothing.
+class IndexReader {
+public:
+	IndexReader(const BYTE* data, size_t size) : ptr(data), end(data + size) { }
+	template<typename T>
+	bool readArray(TableArray<T>& values) {
+		unsigned long long storedCount = 0;
+		if ((size_t)(end - ptr) < sizeof storedCount) return false;
+		memcpy(&storedCount, ptr, sizeof storedCount);
+		ptr += sizeof storedCount;
+		if (storedCount > (size_t)(end - ptr) / sizeof(T)) return false;
+		const size_t count = (size_t)storedCount;
+		values.view((const T*)ptr, count);
+		ptr += (std::min)((count * sizeof(T) + 7) & ~(size_t)7, (size_t)(end - ptr));
+		return true;
+	}
+private:
+	const BYTE* ptr;
+	const BYTE* end;
+};
+
+static bool readTables(IndexReader& reader, UpkPackage& package) {
+	NameTable& names = package.nameTable;
+	ExportTable& exports = package.exportTable;
+	if (!reader.readArray(names.arena)
+			|| !reader.readArray(names.nameStarts)
+			|| !reader.readArray(names.contextFlags)
+			|| !reader.readArray(package.importTable.imports)
+			|| !reader.readArray(exports.classIndices)
+			|| !reader.readArray(exports.superIndices)
+			|| !reader.readArray(exports.outerIndices)
+			|| !reader.readArray(exports.objectNames)
+			|| !reader.readArray(exports.archetypeIndices)
+			|| !reader.readArray(exports.objectFlags)
+			|| !reader.readArray(exports.serializeSizes)
+			|| !reader.readArray(exports.serialOffsets)
+			|| !reader.readArray(exports.exportFlags)
+			|| !reader.readArray(exports.generationNetObjectCounts)
+			|| !reader.readArray(exports.generationNetObjectCountStarts)
+			|| !reader.readArray(exports.guids)
+			|| !reader.readArray(exports.packageFlags)
+			|| !reader.readArray(exports.filePositionsForSizeAndOffset)) {
+		return false;
+	}
+	// The hash already says the arrays are the ones that were written. This only makes sure they were written
+	// for a summary with the same counts.
+	const Summary& summary = package.summary;
+	const size_t exportCount = exports.classIndices.size();
+	return names.contextFlags.size() == (size_t)(std::max)(summary.nameCount, 0)
+		&& names.nameStarts.size() == names.contextFlags.size() + 1
+		&& package.importTable.imports.size() == (size_t)(std::max)(summary.importCount, 0)
+		&& exportCount == (size_t)(std::max)(summary.exportCount, 0)
+		&& exports.generationNetObjectCountStarts.size() == exportCount + 1;
+}
+
+bool loadPackageIndex(LPCWSTR path, UpkPackage& package, MappedFile& file) {
+	ScopedPhase phase("Load package index");
+	if (!file.open(path)) return false;
+	if (file.size() < sizeof(IndexHeader)) {
+		file.close();
+		return false;
+	}
+	IndexHeader header;
+	memcpy(&header, file.data(), sizeof header);
+	if (header.tag != INDEX_TAG
+			|| header.version != INDEX_VERSION
+			|| header.layout != INDEX_LAYOUT
+			|| header.packageSize != package.getFileSize()
+			|| header.packageWriteTime != package.getFileWriteTime()
+			|| memcmp(&header.packageGuid, &package.summary.guid, sizeof(UEGuid)) != 0
+			|| header.bodySize != file.size() - sizeof header) {
+		file.close();
+		return false;
+	}
+	const BYTE* body = file.data() + sizeof header;
+	IndexReader reader(body, (size_t)header.bodySize);
+	if (hash64(body, (size_t)header.bodySize) != header.bodyHash || !readTables(reader, package)) {
+		package.nameTable = NameTable{};
+		package.importTable = ImportTable{};
+		package.exportTable = ExportTable{};
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+bool savePackageIndex(LPCWSTR path, const UpkPackage& package) {
+	ScopedPhase phase("Save package index");
+	const NameTable& names = package.nameTable;
+	const ExportTable& exports = package.exportTable;
+	std::vector<BYTE> buffer(sizeof(IndexHeader));
+	appendArray(buffer, names.arena);
+	appendArray(buffer, names.nameStarts);
+	appendArray(buffer, names.contextFlags);
+	appendArray(buffer, package.importTable.imports);
+	appendArray(buffer, exports.classIndices);
+	appendArray(buffer, exports.superIndices);
+	appendArray(buffer, exports.outerIndices);
+	appendArray(buffer, exports.objectNames);
+	appendArray(buffer, exports.archetypeIndices);
+	appendArray(buffer, exports.objectFlags);
+	appendArray(buffer, exports.serializeSizes);
+	appendArray(buffer, exports.serialOffsets);
+	appendArray(buffer, exports.exportFlags);
+	appendArray(buffer, exports.generationNetObjectCounts);
+	appendArray(buffer, exports.generationNetObjectCountStarts);
+	appendArray(buffer, exports.guids);
+	appendArray(buffer, exports.packageFlags);
+	appendArray(buffer, exports.filePositionsForSizeAndOffset);
+
+	IndexHeader header {};
+	header.tag = INDEX_TAG;
+	header.version = INDEX_VERSION;
+	header.layout = INDEX_LAYOUT;
+	header.packageSize = package.getFileSize();
+	header.packageWriteTime = package.getFileWriteTime();
+	header.packageGuid = package.summary.guid;
+	header.bodySize = buffer.size() - sizeof header;
+	header.bodyHash = hash64(buffer.data() + sizeof header, buffer.size() - sizeof header);
+	memcpy(buffer.data(), &header, sizeof header);
+
+	return saveFileAtomically(path, buffer.data(), buffer.size());
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "Platform.h"
+#include "UpkPackage.h"
+
+// Stored next to a package (as ORIGINAL_UPK.index) when UpkPackage::setIndexPath is used.
+// It holds the name, import and export tables the way they are after parsing and checking, as plain arrays
+// aligned to 8 bytes, so the tables can point right at them in the mapped file instead of being parsed.
+// The export names and paths aren't stored, since they're quick to work out from the tables when they're needed.
+// An index belongs to one exact package file: its size, last write time and GUID. It's only a cache,
+// so one that doesn't match, or was written by a build with a different wchar_t or size_t, is simply not used.
+
+// Returns false if the file doesn't exist, isn't an index of this version or was made from a different package file.
+// The package must have been opened from a file and have its summary parsed. The package's tables point into file
+// afterwards, so it has to stay open as long as they're used. On failure it's closed again.
+bool loadPackageIndex(LPCWSTR path, UpkPackage& package, MappedFile& file);
+// Writes to a temporary file first and then replaces the old index with it. On failure WinError holds the reason.
+bool savePackageIndex(LPCWSTR path, const UpkPackage& package);
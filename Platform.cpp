@@ -0,0 +1,87 @@
+#include "Platform.h"
+#include <vector>
+#ifndef _WIN32
+#include <clocale>
+#endif
+
+#ifdef _WIN32
+std::wstring utf8ToWide(const char* text, size_t size) {
+	if (!size) return std::wstring();
+	int requiredSize = MultiByteToWideChar(CP_UTF8, NULL, text, (int)size, NULL, 0);
+	std::wstring result(requiredSize, L'\0');
+	MultiByteToWideChar(CP_UTF8, NULL, text, (int)size, &result[0], requiredSize);
+	return result;
+}
+
+std::string wideToUtf8(const wchar_t* text, size_t size) {
+	if (!size) return std::string();
+	int requiredSize = WideCharToMultiByte(CP_UTF8, NULL, text, (int)size, NULL, 0, NULL, NULL);
+	std::string result(requiredSize, '\0');
+	WideCharToMultiByte(CP_UTF8, NULL, text, (int)size, &result[0], requiredSize, NULL, NULL);
+	return result;
+}
+#else
+// wchar_t is UTF-32 here. Malformed sequences come out as U+FFFD, same as MultiByteToWideChar does.
+std::wstring utf8ToWide(const char* text, size_t size) {
+	std::wstring result;
+	result.reserve(size);
+	const unsigned char* ptr = (const unsigned char*)text;
+	const unsigned char* end = ptr + size;
+	while (ptr != end) {
+		unsigned int c = *ptr++;
+		int extraCount = c < 0x80 ? 0 : c < 0xC2 ? -1 : c < 0xE0 ? 1 : c < 0xF0 ? 2 : c < 0xF5 ? 3 : -1;
+		if (extraCount < 0) {
+			result += L'\xFFFD';
+			continue;
+		}
+		c &= 0x7F >> extraCount;
+		int i = 0;
+		for (; i < extraCount && ptr != end && (*ptr & 0xC0) == 0x80; ++i) {
+			c = (c << 6) | (*ptr++ & 0x3F);
+		}
+		const bool isOverlong = (extraCount == 2 && c < 0x800) || (extraCount == 3 && c < 0x10000);
+		if (i != extraCount || isOverlong || c > 0x10FFFF || (c >= 0xD800 && c < 0xE000)) {
+			c = 0xFFFD;
+		}
+		result += (wchar_t)c;
+	}
+	return result;
+}
+
+std::string wideToUtf8(const wchar_t* text, size_t size) {
+	std::string result;
+	result.reserve(size);
+	for (size_t i = 0; i < size; ++i) {
+		unsigned int c = (unsigned int)text[i];
+		if (c > 0x10FFFF || (c >= 0xD800 && c < 0xE000)) c = 0xFFFD;
+		if (c < 0x80) {
+			result += (char)c;
+		} else if (c < 0x800) {
+			result += (char)(0xC0 | (c >> 6));
+			result += (char)(0x80 | (c & 0x3F));
+		} else if (c < 0x10000) {
+			result += (char)(0xE0 | (c >> 12));
+			result += (char)(0x80 | ((c >> 6) & 0x3F));
+			result += (char)(0x80 | (c & 0x3F));
+		} else {
+			result += (char)(0xF0 | (c >> 18));
+			result += (char)(0x80 | ((c >> 12) & 0x3F));
+			result += (char)(0x80 | ((c >> 6) & 0x3F));
+			result += (char)(0x80 | (c & 0x3F));
+		}
+	}
+	return result;
+}
+
+int callWideMain(int argc, char** argv, int (*wideMain)(int, wchar_t**)) {
+	// So that printf's %ls can print more than ASCII.
+	setlocale(LC_CTYPE, "");
+	std::vector<std::wstring> arguments(argc);
+	std::vector<wchar_t*> pointers(argc + 1, nullptr);
+	for (int i = 0; i < argc; ++i) {
+		arguments[i] = utf8ToWide(argv[i], strlen(argv[i]));
+		pointers[i] = &arguments[i][0];
+	}
+	return wideMain(argc, pointers.data());
+}
+#endif
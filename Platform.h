@@ -0,0 +1,43 @@
+#pragma once
+// What the code needs from <Windows.h>. On Windows that's the real header. Elsewhere the few types and CRT functions
+// the code uses are defined here, and the system itself is only touched by FileIo, MappedFile, WinError and RunStats.
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cwchar>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef wchar_t WCHAR;
+typedef wchar_t* LPWSTR;
+typedef const wchar_t* LPCWSTR;
+#define TRUE 1
+#define FALSE 0
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+
+inline int _wcsicmp(const wchar_t* a, const wchar_t* b) { return wcscasecmp(a, b); }
+inline int _wcsnicmp(const wchar_t* a, const wchar_t* b, size_t count) { return wcsncasecmp(a, b, count); }
+#endif
+#include <string>
+
+// Between the parts of the paths the program builds, like the paths of the extracted files.
+#ifdef _WIN32
+#define PATH_SEPARATOR L'\\'
+#else
+#define PATH_SEPARATOR L'/'
+#endif
+
+std::wstring utf8ToWide(const char* text, size_t size);
+inline std::wstring utf8ToWide(const std::string& text) { return utf8ToWide(text.data(), text.size()); }
+std::string wideToUtf8(const wchar_t* text, size_t size);
+inline std::string wideToUtf8(const std::wstring& text) { return wideToUtf8(text.data(), text.size()); }
+
+#ifndef _WIN32
+// For main to call: runs wmain with the arguments, which are UTF-8 outside Windows, converted.
+int callWideMain(int argc, char** argv, int (*wideMain)(int, wchar_t**));
+#endif
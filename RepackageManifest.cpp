@@ -0,0 +1,60 @@
+#include "RepackageManifest.h"
+#include "MappedFile.h"
+#include "FileIo.h"
+#include "ByteCursor.h"
+
+#define MANIFEST_TAG 0x4D4B5055  // "UPKM"
+// 2: 64-bit entry offsets.
+#define MANIFEST_VERSION 2
+
+bool RepackageManifest::load(LPCWSTR path) {
+	MappedFile file;
+	if (!file.open(path)) return false;
+	ByteCursor cursor(file.data(), file.size());
+	unsigned int tag = 0;
+	unsigned int version = 0;
+	cursor.read(tag);
+	cursor.read(version);
+	if (tag != MANIFEST_TAG || version != MANIFEST_VERSION) return false;
+	cursor.read(packageSize);
+	cursor.read(packageWriteTime);
+	cursor.read(packageGuid);
+	cursor.read(outputSize);
+	cursor.read(outputWriteTime);
+	unsigned int entryCount = 0;
+	cursor.read(entryCount);
+	// Every entry takes at least this many bytes, which keeps a broken count from allocating too much.
+	const size_t minEntrySize = 4 + 8 + 8 + 8 + 4;
+	if (cursor.overrun || entryCount > (cursor.size() - cursor.tell()) / minEntrySize) return false;
+	entries.resize(entryCount);
+	for (ManifestEntry& entry : entries) {
+		cursor.read(entry.size);
+		cursor.read(entry.writeTime);
+		cursor.read(entry.hash);
+		cursor.read(entry.offset);
+		cursor.readString(entry.path);
+	}
+	return !cursor.overrun;
+}
+
+bool RepackageManifest::save(LPCWSTR path) const {
+	std::vector<BYTE> buffer;
+	ByteWriter writer(buffer);
+	writer.write((unsigned int)MANIFEST_TAG);
+	writer.write((unsigned int)MANIFEST_VERSION);
+	writer.write(packageSize);
+	writer.write(packageWriteTime);
+	writer.write(packageGuid);
+	writer.write(outputSize);
+	writer.write(outputWriteTime);
+	writer.write((unsigned int)entries.size());
+	for (const ManifestEntry& entry : entries) {
+		writer.write(entry.size);
+		writer.write(entry.writeTime);
+		writer.write(entry.hash);
+		writer.write(entry.offset);
+		writer.writeString(entry.path);
+	}
+
+	return saveFileAtomically(path, buffer.data(), buffer.size());
+}
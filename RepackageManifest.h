@@ -0,0 +1,36 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include "UpkPackage.h"
+
+// What one export's payload was when the output was last written.
+struct ManifestEntry {
+	// The file in the extracted folder the payload came from. Empty if it came from memory or the original package.
+	std::wstring path;
+	DWORD size = 0;
+	// FILETIME of the file, as one number. Zero when there is no file.
+	unsigned long long writeTime = 0;
+	unsigned long long hash = 0;
+	unsigned long long offset = 0;
+};
+
+// Stored next to an output package (as NEW_UPK.manifest) by incremental repackaging.
+// It remembers which original package the output was made from, the state of the output itself when it was done,
+// and where every payload went. The next run uses it to rewrite only the exports whose files changed.
+// Incremental extraction keeps one next to the extracted folder (as EXTRACTED_FOLDER.manifest), where the entries
+// describe the files that were written, and the output size and time are left zero.
+class RepackageManifest {
+public:
+	// Returns false if the file doesn't exist or isn't a manifest of this version.
+	bool load(LPCWSTR path);
+	// Writes to a temporary file first and then replaces the old manifest with it,
+	// so an interrupted save never leaves a half-written manifest behind. On failure WinError holds the reason.
+	bool save(LPCWSTR path) const;
+	unsigned long long packageSize = 0;
+	unsigned long long packageWriteTime = 0;
+	UEGuid packageGuid;
+	unsigned long long outputSize = 0;
+	unsigned long long outputWriteTime = 0;
+	std::vector<ManifestEntry> entries;
+};
@@ -1,134 +1,25 @@
-﻿
-
-#include <iostream>
-#include <Windows.h>
-#include <io.h>     // for _open_osfhandle
-#include <fcntl.h>  // for _O_RDONLY
+﻿#include "Platform.h"
 #include <string>
-#include <vector>
-#include <algorithm>
+#include "UpkPackage.h"
+#include "UpkInfoPrinter.h"
+#include "UpkRepackager.h"
+#include "UpkExtractor.h"
+#include "Compression.h"
 #include "WinError.h"
+#include "FileIo.h"
+#include "RunStats.h"
+#include "BatchRunner.h"
+#include "DependencyIndex.h"
+#include "PackageDiff.h"
+#include "ThreadPool.h"
+#include <chrono>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+#include <cwctype>
 
-// On Linux you use std::string for file paths instead of std::wstring
-// and the standard C API for reading/writing files instead of the Windows' one
-// It's just that the Windows API allows you to read a file with shared access (non-exclusively).
-// It's not critical for this program, just would annoying if the file is already opened by some other program.
-
-#define PACKAGE_FILE_TAG			0x9E2A83C1
-
-static bool fileExists(LPCWSTR path) {
-	DWORD fileAttribs = GetFileAttributesW(path);
-	if (fileAttribs == INVALID_FILE_ATTRIBUTES) {
-		return false;
-	}
-	if ((fileAttribs & FILE_ATTRIBUTE_DIRECTORY) != 0) {
-		return false;
-	}
-	return true;
-}
-
-void readString(std::wstring& str, FILE* file) {
-	int length;
-	fread(&length, 4, 1, file);
-	if (length > 0) {
-		std::string strSingleByte(length - 1, '\0');
-		fread(&strSingleByte.front(), 1, length, file);
-		str.reserve(length - 1);
-		for (char c : strSingleByte) {
-			str.push_back((wchar_t)c);
-		}
-	} else {
-		str.reserve(-length - 1);
-		fread(&str.front(), 2, -length - 1, file);
-	}
-}
-struct FlagWithName {
-	const char* name = nullptr;
-	DWORD value = 0;
-};
-
-std::vector<FlagWithName> allPackageFlags;
-std::vector<FlagWithName> allCompressionFlags;
-std::vector<FlagWithName> allExportFlags;
-
-void addNamedFlag(std::vector<FlagWithName>& ar, const char* name, DWORD value) {
-	ar.push_back(FlagWithName{ name, value });
-}
-
-struct NameData {
-	std::wstring name;
-	int numberPart = 0;
-};
-
-NameData readNameData(std::vector<std::wstring>& nameMap, FILE* file) {
-	NameData newData;
-	int nameIndex;
-	fread(&nameIndex, 4, 1, file);
-	if (nameIndex < 0 || nameIndex >= nameMap.size()) {
-		printf("Name index %d outside the range [0;%d)\n", nameIndex, (int)nameMap.size());
-		exit(-1);
-	}
-	newData.name = nameMap[nameIndex];
-	fread(&newData.numberPart, 4, 1, file);
-	return newData;
-}
-
-std::wstring nameDataToString(NameData& nameData) {
-	std::wstring result = nameData.name;
-	if (nameData.numberPart) {
-		result += L'_';
-		unsigned __int64 numberPart64 = nameData.numberPart - 1;
-		char buffer[25]{ '\0' };
-		_ui64toa_s(numberPart64, buffer, sizeof buffer, 10);
-		result.reserve(result.size() + strlen(buffer));
-		for (char* c = buffer; *c != '\0' && c - buffer <= sizeof buffer; ++c) {
-			result += (wchar_t)*c;
-		}
-	}
-	return result;
-}
-
-struct UEGuid {
-	DWORD a = 0;
-	DWORD b = 0;
-	DWORD c = 0;
-	DWORD d = 0;
-};
-
-void readGuid(UEGuid& guid, FILE* file) {
-	fread(&guid.a, 4, 1, file);
-	fread(&guid.b, 4, 1, file);
-	fread(&guid.c, 4, 1, file);
-	fread(&guid.d, 4, 1, file);
-}
-
-void printGuid(UEGuid& guid) {
-	printf("%.8x-%.4x-%.4x-%.2x%.2x-%.2x%.2x%.2x%.2x%.2x%.2x", guid.a, guid.b & 0xffff, (guid.b >> 16) & 0xffff, guid.c & 0xff,
-		(guid.c >> 8) & 0xff, (guid.c >> 16) & 0xff, (guid.c >> 24) & 0xff, guid.d & 0xff, (guid.d >> 8) & 0xff,
-		(guid.d >> 16) & 0xff, (guid.d >> 24) & 0xff);
-}
-
-void printFlags(DWORD flagField, std::vector<FlagWithName>& ar, const char* spaces = nullptr) {
-	printf("[");
-	bool isFirst = true;
-	for (FlagWithName& fwn : ar) {
-		if ((flagField & fwn.value) != 0) {
-			if (!isFirst) {
-				printf(",\n");
-			} else {
-				printf("\n");
-			}
-			if (spaces) printf("%s", spaces);
-			printf("  \"%s\"", fwn.name);
-			isFirst = false;
-		}
-	}
-	if (!isFirst) {
-		printf("\n");
-		if (spaces) printf("%s", spaces);
-	}
-	printf("]");
-}
+// File access and the differences between Windows and Linux are in FileIo.h and Platform.h.
 
 void printHelp() {
 	printf("%s\n",
@@ -141,7 +32,9 @@ void printHelp() {
 	" Cannot add, remove any of the files or change their classes or paths within the package etc.\n"
 	"\n"
 	" Syntax:\n"
-	"   RepackageUPK [-dataOnly] [-info] ORIGINAL_UPK EXTRACTED_FOLDER NEW_UPK\n"
+	"   RepackageUPK [-dataOnly] [-info [-format json|ndjson|msgpack]] [-jobs N] [-incremental]\n"
+	"                [-compress zlib|lzo] [-index] [-ioUring] [-memoryLimit MB] [-stats text|json]\n"
+	"                [-trace TRACE_FILE] ORIGINAL_UPK EXTRACTED_FOLDER NEW_UPK\n"
 	" , where:\n"
 	"   ORIGINAL_UPK is the path to the original .UPK file that you want to make a copy of,\n"
 	"   EXTRACTED_FOLDER is the path to the folder into which you extracted the contents of the\n"
@@ -154,764 +47,800 @@ void printHelp() {
 	"       Such comments will however still be printed on error.\n"
 	"   -info is an optional flag that makes the tool also print the same info it would\n"
 	"       print in the Usage 2 mode while performing the repackage operation.\n"
+	"   -format json|ndjson|msgpack is an optional setting of how -info prints. json, the default,\n"
+	"       is one indented JSON object with comments for the reader. ndjson is one compact JSON\n"
+	"       object per line: one for the summary, then one per name, import and export, each with a\n"
+	"       \"Record\" field saying which it is. msgpack is the same records in MessagePack. Neither of\n"
+	"       the two has the comments, and they give numbers as numbers rather than hex strings.\n"
+	"   -jobs N is an optional setting of how many exported files are read and written at the\n"
+	"       same time. 0 means as many as there are hardware threads. Default is 1.\n"
+	"       Also limits how many threads decompress a compressed ORIGINAL_UPK, which by default\n"
+	"       uses all hardware threads.\n"
+	"   -incremental is an optional flag that allows NEW_UPK to already exist. A manifest is\n"
+	"       kept next to it (NEW_UPK.manifest), and when the tool is run again on the same\n"
+	"       ORIGINAL_UPK, only the exported files that changed since then are written.\n"
+	"   -compress zlib|lzo is an optional setting that makes NEW_UPK a compressed package,\n"
+	"       compressed with the given method. The chunks are compressed on -jobs threads.\n"
+	"       Can't be combined with -incremental.\n"
+	"   -index is an optional flag that keeps the parsed tables of ORIGINAL_UPK in an index file next\n"
+	"       to it (ORIGINAL_UPK.index). While ORIGINAL_UPK doesn't change, the next runs with -index\n"
+	"       load the tables from there instead of parsing them. Works in every usage mode.\n"
+	"   -ioUring is an optional flag that, on Linux, reads the exported files through io_uring, with\n"
+	"       the opens, reads and closes of many files in flight at once, instead of one file at a time.\n"
+	"       Where io_uring isn't available the files are read the usual way. Also works with -batch\n"
+	"       and -batchFolder.\n"
+	"   -memoryLimit MB is an optional setting of how many megabytes the buffers that the exports are\n"
+	"       copied through may take in all. Bigger exports are copied a part at a time, so memory use\n"
+	"       stays the same however big they are. By default every thread gets a 4 MB buffer.\n"
+	"       Also works with -batch and -batchFolder, where the limit is for all of the packages together.\n"
+	"   -stats text|json is an optional setting that makes the tool print, to stderr, how long each\n"
+	"       phase of the work took, how much was read and written in how many calls, how many\n"
+	"       files were opened and the peak memory use. Works in every usage mode.\n"
+	"   -trace TRACE_FILE is an optional setting that writes every timed phase of every thread to\n"
+	"       TRACE_FILE in the Chrome trace event format, to view in chrome://tracing or ui.perfetto.dev.\n"
+	"       Works in every usage mode.\n"
 	"\n"
 	"Usage 2:\n"
 	" List contents of and information about the UPK.\n"
 	" Syntax:\n"
-	"   RepackageUPK -info [-dataOnly] ORIGINAL_UPK"
+	"   RepackageUPK -info [-dataOnly] [-format json|ndjson|msgpack] [-class NAME] [-path GLOB]\n"
+	"                [-exports FIRST[-LAST]] [-names] [-imports] [-hash] [-index] [-stats text|json]\n"
+	"                [-trace TRACE_FILE] ORIGINAL_UPK\n"
+	" , where:\n"
+	"   -class NAME prints only the exports of that class, like Texture2D.\n"
+	"   -path GLOB prints only the exports whose path inside the package, like Outer1.Outer2.ObjectName,\n"
+	"       matches GLOB, where * is any number of characters and ? is any one character.\n"
+	"   -exports FIRST[-LAST] prints only the exports from index FIRST to LAST, starting from 0.\n"
+	"       FIRST alone is just that one export, and FIRST- is every export from FIRST on.\n"
+	"   -names and -imports print the name and import tables, which are left out once any of\n"
+	"       these five options is given. The class and the path ignore case, and all of them can be\n"
+	"       combined, in which case an export is printed only if it passes every one of them.\n"
+	"   -hash adds a \"Hash\" field to every export, the 64-bit xxHash of its data, the same one Usage 7\n"
+	"       compares. A compressed ORIGINAL_UPK is then decompressed whole.\n"
+	"\n"
+	"Usage 3:\n"
+	" Read the data of one export into a file. If ORIGINAL_UPK is compressed, only the parts of it\n"
+	" that the header and the export are in get decompressed.\n"
+	" Syntax:\n"
+	"   RepackageUPK -readExport EXPORT [-dataOnly] [-index] [-stats text|json] [-trace TRACE_FILE]\n"
+	"                ORIGINAL_UPK OUTPUT_FILE\n"
+	" , where:\n"
+	"   EXPORT is either the index of the export, starting from 0, or its path inside the package,\n"
+	"       like Outer1.Outer2.ObjectName.\n"
+	"   OUTPUT_FILE is overwritten if it already exists.\n"
+	"\n"
+	"Usage 4:\n"
+	" Repackage or inspect many packages in one run. The packages share one pool of threads, so a big\n"
+	" package's exports get spread over the threads that are done with the small ones.\n"
+	" Syntax:\n"
+	"   RepackageUPK -batch JOB_LIST [-dataOnly] [-jobs N] [-incremental] [-compress zlib|lzo] [-index]\n"
+	"                [-ioUring] [-memoryLimit MB] [-stats text|json] [-trace TRACE_FILE]\n"
+	"   RepackageUPK -batchFolder ORIGINALS_FOLDER [-dataOnly] [-jobs N] [-incremental] [-compress zlib|lzo]\n"
+	"                [-index] [-ioUring] [-memoryLimit MB] [-stats text|json] [-trace TRACE_FILE]\n"
+	"                [EXTRACTED_ROOT OUTPUT_FOLDER]\n"
+	" , where:\n"
+	"   JOB_LIST is a UTF-8 text file with one package per line: ORIGINAL_UPK, EXTRACTED_FOLDER and\n"
+	"       NEW_UPK separated by tabs, or ORIGINAL_UPK alone to only check that it can be parsed.\n"
+	"       Blank lines and lines starting with # are skipped.\n"
+	"   ORIGINALS_FOLDER is a folder whose every .upk file is repackaged using the folder of the same\n"
+	"       name, without the extension, in EXTRACTED_ROOT, into a file of the same name in\n"
+	"       OUTPUT_FOLDER, which must exist. Without EXTRACTED_ROOT and OUTPUT_FOLDER, the packages are\n"
+	"       only checked.\n"
+	"   -jobs N is the number of threads, all hardware threads by default.\n"
+	"   Every package is done even if some fail. The failed ones are listed with the reason, and\n"
+	"   the exit code is 0 only if all of them succeeded.\n"
+	"\n"
+	"Usage 5:\n"
+	" Find out which packages depend on which. The first form parses every package in a folder and\n"
+	" its subfolders, and saves which outside objects each of them imports. The second form lists the\n"
+	" packages that import an object, using what the first one saved.\n"
+	" Syntax:\n"
+	"   RepackageUPK -scanDependencies COOKED_FOLDER [-dataOnly] [-jobs N] [-index] [-stats text|json]\n"
+	"                [-trace TRACE_FILE] DEPENDENCY_INDEX\n"
+	"   RepackageUPK -dependents OBJECT [-dataOnly] [-stats text|json] [-trace TRACE_FILE] DEPENDENCY_INDEX\n"
+	" , where:\n"
+	"   COOKED_FOLDER is the folder with the packages. Packages that fail to parse are listed and left out.\n"
+	"   DEPENDENCY_INDEX is the file the scan is saved to and the queries read.\n"
+	"   OBJECT is the path of an object from its package down, like Engine.Default__Texture2D, or just\n"
+	"       the name of a package, like Engine, to find the packages that import anything from it.\n"
+	"       The result is printed as JSON, along with the scanned package OBJECT is from, if any.\n"
+	"   -jobs N is the number of threads the scan uses, all hardware threads by default.\n"
+	"\n"
+	"Usage 6:\n"
+	" Extract the data of every export into a folder, the same way gildor's extract tool does, which is\n"
+	" where Usage 1 reads the files back from.\n"
+	" Syntax:\n"
+	"   RepackageUPK -extract [-dataOnly] [-jobs N] [-incremental] [-index] [-stats text|json]\n"
+	"                [-trace TRACE_FILE] ORIGINAL_UPK EXTRACTED_FOLDER\n"
+	" , where:\n"
+	"   EXTRACTED_FOLDER is created if it doesn't exist. Each export is written to\n"
+	"       path\\to\\outer\\ObjectName.ClassName in it, overwriting the file that is there.\n"
+	"   -jobs N is the number of files written at the same time, all hardware threads by default.\n"
+	"   -incremental keeps a manifest next to the folder (EXTRACTED_FOLDER.manifest), and the next run\n"
+	"       with -incremental leaves alone the files that nothing else has changed since, as long as\n"
+	"       their exports didn't change either.\n"
+	"\n"
+	"Usage 7:\n"
+	" Compare two versions of a package, such as the original and a repackaged copy, and print what\n"
+	" differs between them as JSON: the summary fields, the names, imports and exports found in only one\n"
+	" of them, and the exports whose fields or data changed. Exports and imports are matched by path.\n"
+	" Syntax:\n"
+	"   RepackageUPK -diff [-dataOnly] [-jobs N] [-index] [-stats text|json] [-trace TRACE_FILE]\n"
+	"                A_UPK B_UPK\n"
+	" , where:\n"
+	"   -jobs N is the number of threads that decompress and hash the exports, all hardware threads\n"
+	"       by default.\n"
+	"   The exit code is 0 if the packages are the same, 1 if they differ."
 	);
 }
 
-// Escapes non-ASCII characters, \, " and control characters just the way python json.dumps(ensure_ascii=True) does it.
-// Only thing this doesn't do is it put quotation marks around the resulting string.
-// And it prints it to stdout, not to a buffer.
-void printWStrAsJsonEscapedUnicode(const wchar_t* txt) {
-	while (*txt != L'\0') {
-		unsigned int codePoint = *txt;
-		++txt;
-		if (codePoint >= 0x20 && codePoint <= 126) {
-			printf("%c", codePoint);
-		} else if (codePoint == '\n') {
-			printf("%s", "\\n");
-		} else if (codePoint == '\t') {
-			printf("%s", "\\t");
-		} else if (codePoint == '\r') {
-			printf("%s", "\\r");
-		} else if (codePoint == '\f') {
-			printf("%s", "\\f");
-		} else if (codePoint == '\b') {
-			printf("%s", "\\b");
-		} else if (codePoint == '\\') {
-			printf("%s", "\\\\");
-		} else if (codePoint == '\"') {
-			printf("%s", "\\\"");
-		} else {
-			printf("\\u%.4x", codePoint);
+// Returns -1 if there's no such export.
+static int findExport(const UpkPackage& package, const wchar_t* exportSpec) {
+	const ExportTable& exports = package.exportTable;
+	if (*exportSpec != L'\0' && wcsspn(exportSpec, L"0123456789") == wcslen(exportSpec)) {
+		int exportIndex = (int)wcstol(exportSpec, nullptr, 10);
+		return exportIndex < exports.size() ? exportIndex : -1;
+	}
+	for (int exportIndex = 0; exportIndex < exports.size(); ++exportIndex) {
+		if (_wcsicmp(exports.getObjectPath(exportIndex).c_str(), exportSpec) == 0) {
+			return exportIndex;
 		}
 	}
+	return -1;
 }
 
-// To put UTF-8 string literals into C prepend them with u8 prefix and save the file as UTF-8.
-void printUtf8StrAsJsonEscapedUnicode(const char* txt) {
-	int requiredSize = MultiByteToWideChar(CP_UTF8, NULL, txt, -1, NULL, 0);
-	if (!requiredSize) return;
-	wchar_t* buf = (wchar_t*)malloc(requiredSize * sizeof(wchar_t));
-	if (!buf) return;
-	MultiByteToWideChar(CP_UTF8, NULL, txt, -1, buf, requiredSize);
-	printWStrAsJsonEscapedUnicode(buf);
-	free(buf);
+// FIRST, FIRST-LAST or FIRST-, the last meaning up to the last export. Returns false if it's none of those.
+static bool parseExportRange(const wchar_t* range, int& first, int& last) {
+	wchar_t* end = nullptr;
+	if (!iswdigit(*range)) return false;
+	first = (int)wcstol(range, &end, 10);
+	if (*end == L'\0') {
+		last = first;
+		return true;
+	}
+	if (*end != L'-') return false;
+	++end;
+	if (*end == L'\0') {
+		last = INT_MAX;
+		return true;
+	}
+	if (!iswdigit(*end)) return false;
+	last = (int)wcstol(end, &end, 10);
+	return *end == L'\0' && last >= first;
 }
 
-int wmain(int argc, wchar_t** argv)
-{
-	struct CloseFilesAtTheEnd {
-	public:
-		~CloseFilesAtTheEnd() {
-			if (file) fclose(file);
-			if (writeHandle) CloseHandle(writeHandle);
-		}
-		FILE* file = nullptr;
-		HANDLE writeHandle = NULL;
-	} closeFilesAtTheEnd;
+// A whole non-negative decimal number that fits in an int. Returns false for anything else.
+static bool parseCount(const wchar_t* text, int& value) {
+	wchar_t* end = nullptr;
+	if (!iswdigit(*text)) return false;
+	const long long parsed = wcstoll(text, &end, 10);
+	if (*end != L'\0' || parsed > INT_MAX) return false;
+	value = (int)parsed;
+	return true;
+}
 
-	wchar_t* otherThreeArgs[3] { nullptr };
-	int otherThreeArgsCounter = 0;
-	bool isInfo = false;
-	bool isDataOnly = false;
-	for (int i = 1; i < argc; ++i) {
-		wchar_t* option = argv[i];
-		if (_wcsicmp(option, L"-info") == 0) {
-			isInfo = true;
-		} else if (_wcsicmp(option, L"-dataOnly") == 0) {
-			isDataOnly = true;
-		} else {
-			if (otherThreeArgsCounter >= _countof(otherThreeArgs)) {
-				printHelp();
-				return -1;
-			}
-			otherThreeArgs[otherThreeArgsCounter] = option;
-			++otherThreeArgsCounter;
-		}
+static bool writeWholeFile(LPCWSTR path, const std::vector<BYTE>& data) {
+	File file;
+	if (!file.open(path, FILE_MODE_CREATE_ALWAYS)) {
+		WinError err;
+		printf("Failed to create file at location: %ls\n%ls\n", path, err.getMessage());
+		return false;
 	}
-
-	bool isRepackageMode = (otherThreeArgsCounter == 3);
-	if (!isRepackageMode && !isInfo
-			|| !isRepackageMode && isInfo && otherThreeArgsCounter != 1) {
-		printHelp();
-		return (argc == 1 ? 0 : -1);
+	addRunStat(STAT_FILES_OPENED);
+	addRunStat(STAT_WRITE_CALLS);
+	addRunStat(STAT_BYTES_WRITTEN, data.size());
+	if (!file.writeAt(data.data(), data.size(), 0)) {
+		WinError err;
+		printf("Failed to write file %ls: %ls\n", path, err.getMessage());
+		return false;
 	}
+	return true;
+}
 
-	addNamedFlag(allPackageFlags, "AllowDownload", 0x00000001);
-	addNamedFlag(allPackageFlags, "ClientOptional", 0x00000002);
-	addNamedFlag(allPackageFlags, "ServerSideOnly", 0x00000004);
-	addNamedFlag(allPackageFlags, "Cooked", 0x00000008);
-	addNamedFlag(allPackageFlags, "Unsecure", 0x00000010);
-	addNamedFlag(allPackageFlags, "SavedWithNewerVersion", 0x00000020);
-	addNamedFlag(allPackageFlags, "Need", 0x00008000);
-	addNamedFlag(allPackageFlags, "Compiling", 0x00010000);
-	addNamedFlag(allPackageFlags, "ContainsMap", 0x00020000);
-	addNamedFlag(allPackageFlags, "Trash", 0x00040000);
-	addNamedFlag(allPackageFlags, "DisallowLazyLoading", 0x00080000);
-	addNamedFlag(allPackageFlags, "PlayInEditor", 0x00100000);
-	addNamedFlag(allPackageFlags, "ContainsScript", 0x00200000);
-	addNamedFlag(allPackageFlags, "ContainsDebugInfo", 0x00400000);
-	addNamedFlag(allPackageFlags, "RequireImportsAlreadyLoaded", 0x00800000);
-	addNamedFlag(allPackageFlags, "StoreCompressed", 0x02000000);
-	addNamedFlag(allPackageFlags, "StoreFullyCompressed", 0x04000000);
-	addNamedFlag(allPackageFlags, "ContainsFaceFXData", 0x10000000);
-	addNamedFlag(allPackageFlags, "NoExportAllowed", 0x20000000);
-	addNamedFlag(allPackageFlags, "StrippedSource", 0x40000000);
-	addNamedFlag(allPackageFlags, "FilterEditorOnly", 0x80000000);
-
-	addNamedFlag(allCompressionFlags, "ZLIB", 0x01);
-	addNamedFlag(allCompressionFlags, "LZO", 0x02);
-	addNamedFlag(allCompressionFlags, "LZX", 0x04);
-	addNamedFlag(allCompressionFlags, "BiasMemory", 0x10);
-	addNamedFlag(allCompressionFlags, "BiasSpeed", 0x20);
-	addNamedFlag(allCompressionFlags, "ForcePPUDecompressZLib", 0x80);
-
-	addNamedFlag(allExportFlags, "ForcedExport", 0x1);
-	addNamedFlag(allExportFlags, "ScriptPatcherExport", 0x2);
-	addNamedFlag(allExportFlags, "MemberFieldPatchPending", 0x4);
+// The jobs in the order they were given. Failures are printed even with -dataOnly.
+static void printBatchReport(const BatchRunner& batch, bool isDataOnly, double seconds) {
+	const std::vector<BatchJob>& jobs = batch.getJobs();
+	for (const BatchJob& job : jobs) {
+		if (!job.succeeded) {
+			printf("FAILED %ls\n%ls\n", job.originalPath.c_str(), job.error.c_str());
+			continue;
+		}
+		if (isDataOnly) continue;
+		if (job.outputPath.empty()) {
+			printf("OK %ls: %d exports, %.2f MB, %.3f s\n", job.originalPath.c_str(), job.exportCount,
+				job.packageSize / 1048576., job.seconds);
+			continue;
+		}
+		printf("OK %ls -> %ls: %d exports, %.3f s\n", job.originalPath.c_str(), job.outputPath.c_str(),
+			job.exportCount, job.seconds);
+		for (const std::wstring& path : job.unusedFiles) {
+			printf("File not used by any export: %ls\n", path.c_str());
+		}
+	}
+	if (!isDataOnly) {
+		printf("%d of %d packages succeeded in %.3f s.\n", (int)jobs.size() - batch.getFailedCount(),
+			(int)jobs.size(), seconds);
+	}
+}
 
-	HANDLE fileHandle = CreateFileW(
-		otherThreeArgs[0],
-		GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-	if (fileHandle == INVALID_HANDLE_VALUE) {
-		std::cout << "Failed to open file\n";
+static int scanDependencies(LPCWSTR folder, LPCWSTR indexPath, int jobCount, bool useIndex, bool isDataOnly) {
+	auto startTime = std::chrono::steady_clock::now();
+	DependencyIndex dependencies;
+	if (!dependencies.scan(folder, jobCount, useIndex)) {
+		printf("%ls\n", dependencies.getError().c_str());
 		return -1;
 	}
-	DWORD bytesWritten = 0;
-	HANDLE writeHandle = NULL;
-	if (isRepackageMode) {
-		closeFilesAtTheEnd.writeHandle = fileHandle;
-		const wchar_t* writeFileName = otherThreeArgs[2];
-		writeHandle = CreateFileW(writeFileName,
-			GENERIC_WRITE, NULL, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
-		if (writeHandle == INVALID_HANDLE_VALUE) {
-			WinError err;
-			std::cout << "Failed to create file at location: ";
-			std::wcout << writeFileName << L'\n' << err.getMessage() << L'\n';
-			return -1;
-		}
-		closeFilesAtTheEnd.writeHandle = writeHandle;
+	for (const DependencyIndex::Failure& failure : dependencies.getFailures()) {
+		printf("FAILED %ls\n%ls\n", failure.path.c_str(), failure.error.c_str());
 	}
-	int fileDesc = _open_osfhandle((intptr_t)fileHandle, _O_RDONLY);
-	FILE* file = _fdopen(fileDesc, "rb");
-	closeFilesAtTheEnd.file = file;
-	int tag;
-	fread(&tag, 4, 1, file);
-	if (tag != PACKAGE_FILE_TAG) {
-		printf("Package file tag doesn't match.\n");
+	if (!dependencies.save(indexPath)) {
+		WinError err;
+		printf("Failed to write file %ls: %ls\n", indexPath, err.getMessage());
 		return -1;
 	}
-	int fileVersion;
-	fread(&fileVersion, 4, 1, file);
-	if (isInfo) {
-		printf("{\n  \"Main engine version\": %hd,\n", fileVersion & 0xffff);
-		printf("  \"Licensee version\": %hd,\n", (fileVersion >> 16) & 0xffff);
-	}
-	int totalHeaderSize;
-	fread(&totalHeaderSize, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Total header size\": \"0x%x\",\n", totalHeaderSize);
+	if (!isDataOnly) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		printf("Scanned %d packages, %d of them failed, importing %d different objects, in %.3f s.\n",
+			(int)dependencies.getPackages().size(), (int)dependencies.getFailures().size(),
+			(int)dependencies.getObjectCount(), seconds);
 	}
-	void* copyBuf = malloc(totalHeaderSize);
-	if (!copyBuf) {
-		printf("Not enough memory: %d\n", totalHeaderSize);
+	return 0;
+}
+
+static int printDependents(const wchar_t* objectPath, LPCWSTR indexPath, bool isDataOnly) {
+	auto startTime = std::chrono::steady_clock::now();
+	DependencyIndex dependencies;
+	if (!dependencies.load(indexPath)) {
+		printf("%ls is not a dependency index. Make one with -scanDependencies.\n", indexPath);
 		return -1;
 	}
-	int oldPos = ftell(file);
-	fseek(file, 0, SEEK_SET);
-	fread(copyBuf, 1, totalHeaderSize, file);
-	if (isRepackageMode) {
-		WriteFile(writeHandle, copyBuf, totalHeaderSize, &bytesWritten, NULL);
-	}
-	free(copyBuf);
-	fseek(file, oldPos, SEEK_SET);
-	std::wstring folderName;
-	readString(folderName, file);
-	if (isInfo) {
-		printf("  \"Foler name\": \"");
-		printWStrAsJsonEscapedUnicode(folderName.c_str());
-		printf("\",\n");
-	}
-	DWORD packageFlags;
-	fread(&packageFlags, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Package flags\": \"0x%x\",\n", packageFlags);
-		printf("  \"Package flags list\": ");
-		printFlags(packageFlags, allPackageFlags, "  ");
-		printf(",\n");
-	}
-	int nameCount;
-	fread(&nameCount, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Name count\": %d,\n", nameCount);
-	}
-	int nameOffset;
-	fread(&nameOffset, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Name offset\": \"0x%x\",\n", nameOffset);
-	}
-	int exportCount;
-	fread(&exportCount, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Export count\": %d,\n", exportCount);
-	}
-	int exportOffset;
-	fread(&exportOffset, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Export offset\": \"0x%x\",\n", exportOffset);
-	}
-	int importCount;
-	fread(&importCount, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Import count\": %d,\n", importCount);
-	}
-	int importOffset;
-	fread(&importOffset, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Import offset\": \"0x%x\",\n", importOffset);
-	}
-	int dependsOffset;
-	fread(&dependsOffset, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Depends offset\": \"0x%x\",\n", dependsOffset);
-	}
-	int importExportGuidOffsets = -1;
-	int importGuidsCount = 0;
-	int exportGuidsCount = 0;
-	if ((fileVersion & 0xffff) >= 623) {
-		fread(&importExportGuidOffsets, 4, 1, file);
-		if (isInfo) {
-			printf("  \"Import export guid offsets\": \"0x%x\",\n", importExportGuidOffsets);
-		}
-		fread(&importGuidsCount, 4, 1, file);
-		if (isInfo) {
-			printf("  \"Import guids count\": %d,\n", importGuidsCount);
-		}
-		fread(&exportGuidsCount, 4, 1, file);
-		if (isInfo) {
-			printf("  \"Export guids count\": %d,\n", exportGuidsCount);
+	const std::vector<std::wstring>& packages = dependencies.getPackages();
+	const std::vector<int>& dependents = dependencies.findDependents(objectPath);
+	const int exportingPackage = dependencies.findExportingPackage(objectPath);
+	{
+		JsonWriter out;
+		out.write("{\n  \"Object\": \"");
+		out.writeEscaped(objectPath, wcslen(objectPath));
+		out.write("\",\n  \"Exported by\": ");
+		if (exportingPackage == -1) {
+			out.write("null");
+		} else {
+			out.write("\"");
+			out.writeEscaped(packages[exportingPackage]);
+			out.write("\"");
 		}
-	}
-	int thumbnailTableOffset = 0;
-	if ((fileVersion & 0xffff) >= 584) {
-		fread(&thumbnailTableOffset, 4, 1, file);
-		if (isInfo) {
-			printf("  \"Thumbnail table offset\": \"0x%x\",\n", thumbnailTableOffset);
+		out.write(",\n  \"Dependents\": [");
+		for (size_t i = 0; i < dependents.size(); ++i) {
+			out.write(i == 0 ? "\n    \"" : ",\n    \"");
+			out.writeEscaped(packages[dependents[i]]);
+			out.write("\"");
 		}
+		out.write(dependents.empty() ? "]\n}\n" : "\n  ]\n}\n");
 	}
-	UEGuid guid;
-	readGuid(guid, file);
-	if (isInfo) {
-		printf("  \"Guid\": \"");
-		printGuid(guid);
-		printf("\",\n");
+	if (!isDataOnly) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		printf("Found %d dependents in %.1f ms.\n", (int)dependents.size(), seconds * 1000.);
 	}
-	int generationCount;
-	fread(&generationCount, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Generation count\": %d,\n", generationCount);
-	}
-	if (generationCount) {
-		if (isInfo) {
-			printf("  \"Generations\": [\n");
-		}
-		for (int generationCounter = generationCount; generationCounter > 0; --generationCounter) {
-			int generationExportCount;
-			int generationNameCount;
-			int generationNetObjectCount;
-			fread(&generationExportCount, 4, 1, file);
-			fread(&generationNameCount, 4, 1, file);
-			fread(&generationNetObjectCount, 4, 1, file);
-			if (isInfo) {
-				printf("    {\n      \"Export count\": %d,\n", generationExportCount);
-				printf("      \"Name count\": %d,\n", generationNameCount);
-				printf("      \"Net object count\": %d\n", generationNetObjectCount);
-				if (generationCounter == 1) {
-					printf("    }\n");
-				} else {
-					printf("    },\n");
-				}
-			}
-		}
-		if (isInfo) {
-			printf("  ],\n");
+	return 0;
+}
+
+static void printDiffList(JsonWriter& out, const char*& separator, const char* key, const std::vector<std::wstring>& list) {
+	if (list.empty()) return;
+	out.writeFormat("%s\"%s\": [", separator, key);
+	for (size_t i = 0; i < list.size(); ++i) {
+		out.write(i == 0 ? "\n    \"" : ",\n    \"");
+		out.writeEscaped(list[i]);
+		out.write("\"");
+	}
+	out.write("\n  ]");
+	separator = ",\n  ";
+}
+
+// Only the parts that differ are printed. Returns 0 if nothing does, 1 if something does and -1 on failure.
+static int diffPackages(LPCWSTR pathA, LPCWSTR pathB, int jobCount, bool useIndex, bool isDataOnly) {
+	auto startTime = std::chrono::steady_clock::now();
+	ThreadPool pool(jobCount);
+	UpkPackage packages[2];
+	LPCWSTR paths[2] { pathA, pathB };
+	for (int i = 0; i < 2; ++i) {
+		packages[i].setThreadPool(&pool);
+		packages[i].setLazyNames(true);
+		if (useIndex) {
+			packages[i].setIndexPath((std::wstring(paths[i]) + L".index").c_str());
+		}
+		if (!packages[i].open(paths[i])) {
+			printf("%ls\n", packages[i].getError().c_str());
+			return -1;
 		}
 	}
-	int engineVersion;
-	fread(&engineVersion, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Engine version\": %d,\n", engineVersion);
-	}
-	int cookedContentVersion;
-	fread(&cookedContentVersion, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Cooked content version\": %d,\n", cookedContentVersion);
-	}
-	DWORD compressionFlags;
-	fread(&compressionFlags, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Compression flags\": \"0x%x\",\n", compressionFlags);
-		printf("  \"Compression flags list\": ");
-		printFlags(compressionFlags, allCompressionFlags, "  ");
-		printf(",\n");
-	}
-	int compressedChunksCount;
-	fread(&compressedChunksCount, 4, 1, file);
-	if (compressedChunksCount > 0) {
-		if (isInfo) {
-			printf("  \"Compressed chunks\": [\n");
-		}
-		for (int compressedChunksCounter = compressedChunksCount; compressedChunksCounter > 0; --compressedChunksCounter) {
-			int uncompressedOffset;
-			int uncompressedSize;
-			int compressedOffset;
-			int compressedSize;
-			fread(&uncompressedOffset, 4, 1, file);
-			fread(&uncompressedSize, 4, 1, file);
-			fread(&compressedOffset, 4, 1, file);
-			fread(&compressedSize, 4, 1, file);
-			if (isInfo) {
-				printf("    {\n      \"Uncompressed offset\": \"0x%x\",\n", uncompressedOffset);
-				printf("      \"Uncompressed size\": \"0x%x\",\n", uncompressedSize);
-				printf("      \"Compressed offset\": \"0x%x\",\n", compressedOffset);
-				printf("      \"Compressed size\": \"0x%x\"\n", compressedSize);
-				if (compressedChunksCounter == 1) {
-					printf("    }\n");
-				} else {
-					printf("    },\n");
-				}
-			}
-		}
-		if (isInfo) {
-			printf("  ],\n");
-		}
+	PackageDiff diff;
+	if (!diff.compare(packages[0], packages[1])) {
+		printf("%ls\n", diff.getError().c_str());
+		return -1;
 	}
-	DWORD packageSource;
-	fread(&packageSource, 4, 1, file);
-	if (isInfo) {
-		printf("  \"Package source\": \"0x%x\",\n", packageSource);
-	}
-	if ((fileVersion & 0xffff) >= 516) {
-		int additionalPackagesToCookCount;
-		fread(&additionalPackagesToCookCount, 4, 1, file);
-		if (additionalPackagesToCookCount > 0) {
-			if (isInfo) {
-				printf("  \"Additional packages to cook\": [\n");
-			}
-			for (int additionalPackagesToCookCounter = additionalPackagesToCookCount; additionalPackagesToCookCounter > 0; --additionalPackagesToCookCounter) {
-				std::wstring packageName;
-				readString(packageName, file);
-				if (isInfo) {
-					printf("    \"");
-					printWStrAsJsonEscapedUnicode(packageName.c_str());
-					printf("\"");
-					if (additionalPackagesToCookCounter == 1) {
-						printf("\n");
-					} else {
-						printf(",\n");
-					}
+	{
+		JsonWriter out;
+		const char* separator = "\n  ";
+		out.write("{");
+		if (!diff.summaryChanges.empty()) {
+			out.writeFormat("%s\"Summary\": [", separator);
+			for (size_t i = 0; i < diff.summaryChanges.size(); ++i) {
+				const PackageDiff::SummaryChange& change = diff.summaryChanges[i];
+				out.writeFormat("%s\n    {\n      \"Field\": \"%s\",\n      \"A\": %lld,\n      \"B\": %lld\n    }",
+					i == 0 ? "" : ",", change.field, change.a, change.b);
+			}
+			out.write("\n  ]");
+			separator = ",\n  ";
+		}
+		printDiffList(out, separator, "Names only in A", diff.namesOnlyInA);
+		printDiffList(out, separator, "Names only in B", diff.namesOnlyInB);
+		printDiffList(out, separator, "Imports only in A", diff.importsOnlyInA);
+		printDiffList(out, separator, "Imports only in B", diff.importsOnlyInB);
+		printDiffList(out, separator, "Exports only in A", diff.exportsOnlyInA);
+		printDiffList(out, separator, "Exports only in B", diff.exportsOnlyInB);
+		if (!diff.changedExports.empty()) {
+			out.writeFormat("%s\"Changed exports\": [", separator);
+			for (size_t i = 0; i < diff.changedExports.size(); ++i) {
+				const PackageDiff::ChangedExport& changed = diff.changedExports[i];
+				out.write(i == 0 ? "\n    {\n      \"Path\": \"" : ",\n    {\n      \"Path\": \"");
+				out.writeEscaped(changed.path);
+				out.writeFormat("\",\n      \"Index in A\": %d,\n      \"Index in B\": %d,\n      \"Changes\": [",
+					changed.indexA, changed.indexB);
+				for (size_t j = 0; j < changed.changes.size(); ++j) {
+					out.writeFormat("%s\"%s\"", j == 0 ? "" : ", ", changed.changes[j]);
 				}
+				out.write("]\n    }");
 			}
-			if (isInfo) {
-				printf("  ],\n");
-			}
+			out.write("\n  ]");
 		}
+		out.write(diff.isEmpty() ? "}\n" : "\n}\n");
 	}
-	if ((fileVersion & 0xffff) >= 767) {
-		int textureTypesCount;
-		fread(&textureTypesCount, 4, 1, file);
-		if (textureTypesCount > 0) {
-			if (isInfo) {
-				printf("  \"Texture allocations.Texture types\": [\n");
-			}
-			for (int textureTypesCounter = textureTypesCount; textureTypesCounter > 0; --textureTypesCounter) {
-				int sizeX;
-				int sizeY;
-				int numMips;
-				DWORD format;
-				DWORD texCreateFlags;
-				int exportIndicesCount;
-				fread(&sizeX, 4, 1, file);
-				fread(&sizeY, 4, 1, file);
-				fread(&numMips, 4, 1, file);
-				fread(&format, 4, 1, file);
-				fread(&texCreateFlags, 4, 1, file);
-				fread(&exportIndicesCount, 4, 1, file);
-				if (isInfo) {
-					printf("    {\n      \"Size X\": %d,\n", sizeX);
-					printf("      \"Size Y\": %d,\n", sizeY);
-					printf("      \"Num mips\": %d,\n", numMips);
-					printf("      \"Format\": %d,\n", format);
-					printf("      \"Tex create flags\": \"0x%x\"", texCreateFlags);
-				}
-				if (exportIndicesCount > 0) {
-					if (isInfo) {
-						printf(",\n      \"Export indices\": [\n");
-					}
-					for (int exportIndicesCounter = exportIndicesCount; exportIndicesCounter > 0; --exportIndicesCounter) {
-						int exportIndex;
-						fread(&exportIndex, 4, 1, file);
-						if (isInfo) {
-							printf("        %d", exportIndex);
-							if (exportIndicesCounter == 1) {
-								printf("\n");
-							} else {
-								printf(",\n");
-							}
-						}
-					}
-					if (isInfo) {
-						printf("      ]");
-					}
-				}
-				if (isInfo) {
-					printf("\n    }");
-					if (textureTypesCounter == 1) {
-						printf("\n");
-					} else {
-						printf(",\n");
-					}
-				}
-			}
-			if (isInfo) {
-				printf("  ],\n");
-			}
-		}
-	}
-	if (compressionFlags != 0) {
-		if (!isDataOnly) {
-			printf("The package is compressed. You can decompress it using gildor's decompress tool,"
-			" available on his website: https://www.gildor.org/downloads\n");
+	if (!isDataOnly) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		if (diff.isEmpty()) {
+			printf("The packages are the same, in %.3f s.\n", seconds);
+		} else {
+			printf("%d of %d exports changed, %d removed and %d added, in %.3f s.\n",
+				(int)diff.changedExports.size(), packages[0].exportTable.size(),
+				(int)diff.exportsOnlyInA.size(), (int)diff.exportsOnlyInB.size(), seconds);
 		}
-		return 0;
 	}
-	std::vector<std::wstring> names;
-	if (isInfo) {
-		printf("  \"Names\": [");
-	}
-	if (nameCount) {
-		fseek(file, nameOffset, SEEK_SET);
-		for (int nameCounter = nameCount; nameCounter > 0; --nameCounter) {
-			std::wstring name;
-			readString(name, file);
-			names.push_back(name);
-			unsigned long long contextFlags;
-			fread(&contextFlags, 8, 1, file);
-			if (isInfo) {
-				printf("\n    {\n      \"Name\": \"");
-				printWStrAsJsonEscapedUnicode(name.c_str());
-				printf("\",\n");
-				printf("      \"Context flags\": \"%llx\"\n    }", contextFlags);
-				if (nameCounter != 1) {
-					printf(",");
-				}
-			}
-		}
-		if (isInfo) {
-			printf("\n  ],\n");
-		}
-	} else if (isInfo) {
-		printf("  ],\n");
-	}
-	struct Import {
-		std::wstring name;
-		NameData classPackage;
-		NameData className;
-		int outerIndex;
-		NameData objectName;
-	};
-	std::vector<Import> imports;
-	if (importCount) {
-		fseek(file, importOffset, SEEK_SET);
-		for (int importCounter = importCount; importCounter > 0; --importCounter) {
-			imports.emplace_back();
-			Import& importStruct = imports.back();
-			importStruct.classPackage = readNameData(names, file);
-			importStruct.className = readNameData(names, file);
-			fread(&importStruct.outerIndex, 4, 1, file);
-			importStruct.objectName = readNameData(names, file);
-			importStruct.name = nameDataToString(importStruct.objectName);
-		}
-	}
-	struct Export {
-		int filePositionForSizeAndOffset = 0;
-		std::wstring name;
-		std::vector<std::wstring> packagePath;
-		std::wstring className;
-		int outerIndex = 0;
-	};
-	std::vector<Export> exports;
-	if (exportCount) {
-		fseek(file, exportOffset, SEEK_SET);
-		for (int exportCounter = exportCount; exportCounter > 0; --exportCounter) {
-			fseek(file, 12, SEEK_CUR);
-			NameData objectName = readNameData(names, file);
-			Export newExport;
-			newExport.name = nameDataToString(objectName);
-			exports.push_back(newExport);
-			fseek(file, 24, SEEK_CUR);
-			int generationNetObjectCountCount;
-			fread(&generationNetObjectCountCount, 4, 1, file);
-			if (generationNetObjectCountCount > 0) {
-				fseek(file, generationNetObjectCountCount * 4, SEEK_CUR);
-			}
-			fseek(file, 20, SEEK_CUR);
-		}
-	}
-	if (!importCount && isInfo) printf("  \"Imports\": [],\n");
-	if (importCount && isInfo) {
-		printf("  \"Imports\": [");
-		int importCounter = 0;
-		for (Import& importStruct : imports) {
-			printf("\n    {\n      \"Class package\": \"");
-			printWStrAsJsonEscapedUnicode(nameDataToString(importStruct.classPackage).c_str());
-			printf("\",\n");
-			printf("      \"Class name\": \"");
-			printWStrAsJsonEscapedUnicode(nameDataToString(importStruct.className).c_str());
-			printf("\",\n");
-			printf("      \"Outer index\": %d,\n", importStruct.outerIndex);
-			if (importStruct.outerIndex > 0) {
-				printf("      \"Outer index comment\": \"// points to exports, so \\\"");
-				printWStrAsJsonEscapedUnicode(exports[importStruct.outerIndex - 1].name.c_str());
-				printf("\\\"\",\n");
-			}
-			if (importStruct.outerIndex < 0) {
-				printf("      \"Outer index comment\": \"// points to here, into Imports, so \\\"");
-				printWStrAsJsonEscapedUnicode(imports[-importStruct.outerIndex - 1].name.c_str());
-				printf("\\\"\",\n");
-			}
-			printf("      \"Object name\": \"");
-			printWStrAsJsonEscapedUnicode(nameDataToString(importStruct.objectName).c_str());
-			printf("\"\n    }");
-			if (importCounter != imports.size() - 1) {
-				printf(",");
+	return diff.isEmpty() ? 0 : 1;
+}
+
+enum InfoFormat {
+	INFO_JSON,
+	INFO_NDJSON,
+	INFO_MSGPACK
+};
+
+enum StatsFormat {
+	STATS_NONE,
+	STATS_TEXT,
+	STATS_JSON
+};
+
+// Prints the -stats report and writes the -trace file when it goes out of scope, so wmain can return from anywhere.
+class RunStatsReport {
+public:
+	RunStatsReport(StatsFormat format, const wchar_t* tracePath) : format(format), tracePath(tracePath) {
+		if (format != STATS_NONE || tracePath) {
+			enableRunStats();
+		}
+	}
+	RunStatsReport(const RunStatsReport&) = delete;
+	RunStatsReport& operator=(const RunStatsReport&) = delete;
+	~RunStatsReport() {
+		if (format == STATS_TEXT) {
+			printRunStats(stderr);
+		} else if (format == STATS_JSON) {
+			JsonWriter out(stderr);
+			printRunStatsJson(out);
+		}
+		std::wstring error;
+		if (tracePath && !writeRunStatsTrace(tracePath, error)) {
+			printf("%ls\n", error.c_str());
+		}
+	}
+private:
+	StatsFormat format;
+	const wchar_t* tracePath;
+};
+
+int wmain(int argc, wchar_t** argv)
+{
+	wchar_t* otherThreeArgs[3] { nullptr };
+	int otherThreeArgsCounter = 0;
+	bool isInfo = false;
+	bool isDataOnly = false;
+	int jobCount = 1;
+	bool isJobCountSet = false;
+	bool isIncremental = false;
+	bool useIndex = false;
+	bool useIoUring = false;
+	size_t memoryLimit = 0;
+	DWORD compressionFlags = 0;
+	const wchar_t* exportToRead = nullptr;
+	bool isExtract = false;
+	bool isDiff = false;
+	bool isHash = false;
+	StatsFormat statsFormat = STATS_NONE;
+	InfoFormat infoFormat = INFO_JSON;
+	InfoQuery infoQuery;
+	bool isInfoFiltered = false;
+	bool isNamesAsked = false;
+	bool isImportsAsked = false;
+	const wchar_t* tracePath = nullptr;
+	const wchar_t* batchListPath = nullptr;
+	const wchar_t* batchFolder = nullptr;
+	const wchar_t* scanFolder = nullptr;
+	const wchar_t* dependentsOf = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		wchar_t* option = argv[i];
+		if (_wcsicmp(option, L"-info") == 0) {
+			isInfo = true;
+		} else if (_wcsicmp(option, L"-dataOnly") == 0) {
+			isDataOnly = true;
+		} else if (_wcsicmp(option, L"-incremental") == 0) {
+			isIncremental = true;
+		} else if (_wcsicmp(option, L"-index") == 0) {
+			useIndex = true;
+		} else if (_wcsicmp(option, L"-ioUring") == 0) {
+			useIoUring = true;
+		} else if (_wcsicmp(option, L"-diff") == 0) {
+			isDiff = true;
+		} else if (_wcsicmp(option, L"-hash") == 0) {
+			isHash = true;
+		} else if (_wcsicmp(option, L"-extract") == 0) {
+			isExtract = true;
+		} else if (_wcsicmp(option, L"-readExport") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			++importCounter;
-		}
-		printf("\n  ],\n");
-	}
-	if (isInfo) {
-		printf("  \"Exports\": [");
-	}
-	if (exportCount) {
-		fseek(file, exportOffset, SEEK_SET);
-		int exportCounterStraight = 0;
-		for (int exportCounter = exportCount; exportCounter > 0; --exportCounter) {
-			Export& exportStruct = exports[exportCount - exportCounter];
-			int classIndex;
-			fread(&classIndex, 4, 1, file);
-			if (isInfo) {
-				printf("\n    {\n      \"Class index\": %d,\n", classIndex);
+			exportToRead = argv[++i];
+		} else if (_wcsicmp(option, L"-batch") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			if (classIndex) {
-				if (classIndex < 0) {
-					if (isInfo) {
-						printf("      \"Class index comment\": \"// imports[%d]: \\\"", -classIndex - 1);
-						printWStrAsJsonEscapedUnicode(imports[-classIndex - 1].name.c_str());
-						printf("\\\"\",\n");
-					}
-					exportStruct.className = imports[-classIndex - 1].name;
-				} else {
-					if (isInfo) {
-						printf("      \"Class index comment\": \"// exports[%d]: \\\"", classIndex - 1);
-						printWStrAsJsonEscapedUnicode(exports[classIndex - 1].name.c_str());
-						printf("\\\"\",\n");
-					}
-					exportStruct.className = exports[classIndex - 1].name;
-				}
+			batchListPath = argv[++i];
+		} else if (_wcsicmp(option, L"-batchFolder") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			int superIndex;
-			fread(&superIndex, 4, 1, file);
-			if (isInfo) {
-				printf("      \"Super index\": %d,\n", superIndex);
+			batchFolder = argv[++i];
+		} else if (_wcsicmp(option, L"-scanDependencies") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			if (superIndex && isInfo) {
-				if (superIndex < 0) {
-					printf("      \"Super index comment\": \"// imports[%d]: \\\"", -superIndex - 1);
-					printWStrAsJsonEscapedUnicode(imports[-superIndex - 1].name.c_str());
-					printf("\\\"\",\n");
-				} else {
-					printf("      \"Super index comment\": \"// exports[%d]: \\\"", superIndex - 1);
-					printWStrAsJsonEscapedUnicode(exports[superIndex - 1].name.c_str());
-					printf("\\\"\",\n");
-				}
+			scanFolder = argv[++i];
+		} else if (_wcsicmp(option, L"-dependents") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			int outerIndex;
-			fread(&outerIndex, 4, 1, file);
-			if (isInfo) {
-				printf("      \"Outer index\": %d,\n", outerIndex);
+			dependentsOf = argv[++i];
+		} else if (_wcsicmp(option, L"-compress") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			if (outerIndex && isInfo) {
-				if (outerIndex < 0) {
-					printf("      \"Outer index comment\": \"// imports[%d]: \\\"", -outerIndex - 1);
-					printWStrAsJsonEscapedUnicode(imports[-outerIndex - 1].name.c_str());
-					printf("\\\"\",\n");
-				} else {
-					printf("      \"Outer index comment\": \"// exports[%d]: \\\"", outerIndex - 1);
-					printWStrAsJsonEscapedUnicode(exports[outerIndex - 1].name.c_str());
-					printf("\\\"\",\n");
-				}
+			const wchar_t* method = argv[++i];
+			if (_wcsicmp(method, L"zlib") == 0) {
+				compressionFlags = COMPRESS_ZLIB;
+			} else if (_wcsicmp(method, L"lzo") == 0) {
+				compressionFlags = COMPRESS_LZO;
+			} else {
+				printHelp();
+				return -1;
 			}
-			exportStruct.outerIndex = outerIndex;
-			NameData objectName = readNameData(names, file);
-			if (isInfo) {
-				printf("      \"Object name\": \"");
-				printWStrAsJsonEscapedUnicode(nameDataToString(objectName).c_str());
-				printf("\",\n");
+		} else if (_wcsicmp(option, L"-stats") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			int archetypeIndex;
-			fread(&archetypeIndex, 4, 1, file);
-			if (isInfo) {
-				printf("      \"Archetype index\": %d,\n", archetypeIndex);
+			const wchar_t* format = argv[++i];
+			if (_wcsicmp(format, L"text") == 0) {
+				statsFormat = STATS_TEXT;
+			} else if (_wcsicmp(format, L"json") == 0) {
+				statsFormat = STATS_JSON;
+			} else {
+				printHelp();
+				return -1;
 			}
-			if (archetypeIndex && isInfo) {
-				if (archetypeIndex < 0) {
-					printf("      \"Archetype index comment\": \"// imports[%d]: \\\"", -archetypeIndex - 1);
-					printWStrAsJsonEscapedUnicode(imports[-archetypeIndex - 1].name.c_str());
-					printf("\\\"\",\n");
-				} else {
-					printf("      \"Archetype index comment\": \"// exports[%d]: \\\"", archetypeIndex - 1);
-					printWStrAsJsonEscapedUnicode(exports[archetypeIndex - 1].name.c_str());
-					printf("\\\"\",\n");
-				}
+		} else if (_wcsicmp(option, L"-format") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			unsigned long long objectFlags;
-			fread(&objectFlags, 8, 1, file);
-			if (isInfo) {
-				printf("      \"Object flags\": \"0x%llx\",\n", objectFlags);
+			const wchar_t* format = argv[++i];
+			if (_wcsicmp(format, L"json") == 0) {
+				infoFormat = INFO_JSON;
+			} else if (_wcsicmp(format, L"ndjson") == 0) {
+				infoFormat = INFO_NDJSON;
+			} else if (_wcsicmp(format, L"msgpack") == 0) {
+				infoFormat = INFO_MSGPACK;
+			} else {
+				printHelp();
+				return -1;
 			}
-			exportStruct.filePositionForSizeAndOffset = ftell(file);
-			int serializeSize;
-			fread(&serializeSize, 4, 1, file);
-			if (isInfo) {
-				printf("      \"Serialize size\": \"0x%x\",\n", serializeSize);
+		} else if (_wcsicmp(option, L"-class") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			int serialOffset;
-			fread(&serialOffset, 4, 1, file);
-			if (isInfo) {
-				printf("      \"Serial offset\": \"0x%x\",\n", serialOffset);
+			infoQuery.className = argv[++i];
+			isInfoFiltered = true;
+		} else if (_wcsicmp(option, L"-path") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			if ((fileVersion & 0xffff) < 543) {
-				int len;
-				fread(&len, 4, 1, file);
-				fseek(file, len * 3 * 4, SEEK_CUR);
+			infoQuery.pathPattern = argv[++i];
+			isInfoFiltered = true;
+		} else if (_wcsicmp(option, L"-exports") == 0) {
+			if (i + 1 >= argc || !parseExportRange(argv[++i], infoQuery.firstExport, infoQuery.lastExport)) {
+				printHelp();
+				return -1;
 			}
-			DWORD exportFlags;
-			fread(&exportFlags, 4, 1, file);
-			if (isInfo) {
-				printf("      \"Export flags\": \"0x%x\",\n", exportFlags);
-				printf("      \"Export flags list\": ");
-				printFlags(exportFlags, allExportFlags, "      ");
-				printf(",\n");
+			isInfoFiltered = true;
+		} else if (_wcsicmp(option, L"-names") == 0) {
+			isNamesAsked = true;
+			isInfoFiltered = true;
+		} else if (_wcsicmp(option, L"-imports") == 0) {
+			isImportsAsked = true;
+			isInfoFiltered = true;
+		} else if (_wcsicmp(option, L"-trace") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
 			}
-			int generationNetObjectCountCount;
-			fread(&generationNetObjectCountCount, 4, 1, file);
-			if (generationNetObjectCountCount > 0) {
-				if (isInfo) {
-					printf("      \"Generation net object count\": [\n");
-				}
-				for (int generationNetObjectCountCounter = generationNetObjectCountCount; generationNetObjectCountCounter > 0; --generationNetObjectCountCounter) {
-					int count;
-					fread(&count, 4, 1, file);
-					if (isInfo) {
-						printf("        %d", count);
-						if (generationNetObjectCountCounter != 1) {
-							printf(",");
-						}
-						printf("\n");
-					}
-				}
-				if (isInfo) {
-					printf("      ],\n");
-				}
+			tracePath = argv[++i];
+		} else if (_wcsicmp(option, L"-jobs") == 0) {
+			if (i + 1 >= argc || !parseCount(argv[++i], jobCount)) {
+				printHelp();
+				return -1;
 			}
-			UEGuid exportGuid;
-			readGuid(exportGuid, file);
-			if (isInfo) {
-				printf("      \"Guid\": \"");
-				printGuid(exportGuid);
-				printf("\",\n");
+			isJobCountSet = true;
+		} else if (_wcsicmp(option, L"-memoryLimit") == 0) {
+			int megabytes = 0;
+			if (i + 1 >= argc || !parseCount(argv[++i], megabytes) || megabytes == 0) {
+				printHelp();
+				return -1;
 			}
-			DWORD exportPackageFlags;
-			fread(&exportPackageFlags, 4, 1, file);
-			if (isInfo) {
-				printf("      \"Index\": %d,\n", exportCounterStraight);
-				printf("      \"Package flags\": \"0x%x\"\n    }", exportPackageFlags);
-				if (exportCounter != 1) {
-					printf(",");
-				}
+			memoryLimit = (size_t)megabytes * 1024 * 1024;
+		} else {
+			if (otherThreeArgsCounter >= _countof(otherThreeArgs)) {
+				printHelp();
+				return -1;
 			}
-			++exportCounterStraight;
-		}
-		for (int exportCounter = exportCount; exportCounter > 0; --exportCounter) {
-			Export& exportStruct = exports[exportCount - exportCounter];
-			int outerIndexIter = exportStruct.outerIndex;
-			while (outerIndexIter) {
-				if (outerIndexIter < 0) {
-					break;
-				} else {
-					exportStruct.packagePath.push_back(exports[outerIndexIter - 1].name);
-					outerIndexIter = exports[outerIndexIter - 1].outerIndex;
-				}
+			otherThreeArgs[otherThreeArgsCounter] = option;
+			++otherThreeArgsCounter;
+		}
+	}
+
+	if (exportToRead) {
+		if (otherThreeArgsCounter != 2 || isInfo || isInfoFiltered || isHash || isExtract || isDiff || batchListPath
+				|| batchFolder || scanFolder || dependentsOf || isIncremental || compressionFlags || useIoUring
+				|| memoryLimit || isJobCountSet) {
+			printHelp();
+			return -1;
+		}
+		RunStatsReport statsReport(statsFormat, tracePath);
+		auto startTime = std::chrono::steady_clock::now();
+		UpkPackage package;
+		package.setDecompressOnDemand(true);
+		if (useIndex) {
+			package.setIndexPath((std::wstring(otherThreeArgs[0]) + L".index").c_str());
+		}
+		if (!package.open(otherThreeArgs[0])) {
+			printf("%ls\n", package.getError().c_str());
+			return -1;
+		}
+		int exportIndex = findExport(package, exportToRead);
+		if (exportIndex == -1) {
+			printf("Export not found: %ls\n", exportToRead);
+			return -1;
+		}
+		std::vector<BYTE> exportData;
+		{
+			ScopedPhase phase("Read export");
+			if (!package.readExport(exportIndex, exportData)) {
+				printf("%ls\n", package.getError().c_str());
+				return -1;
 			}
-			std::reverse(exportStruct.packagePath.begin(), exportStruct.packagePath.end());
 		}
-		if (isInfo) {
-			printf("\n  ]\n");
+		if (!writeWholeFile(otherThreeArgs[1], exportData)) {
+			return -1;
 		}
-	} else if (isInfo) {
-		printf("  ]\n");
+		if (!isDataOnly) {
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+			printf("Read export %d (%d bytes) in %.1f ms.\n", exportIndex, (int)exportData.size(), seconds * 1000.);
+		}
+		return 0;
 	}
-	if (isInfo) {
-		printf("}\n");
+
+	if (isExtract) {
+		if (otherThreeArgsCounter != 2 || isInfo || isInfoFiltered || isHash || isDiff || batchListPath || batchFolder
+				|| scanFolder || dependentsOf || compressionFlags || useIoUring || memoryLimit) {
+			printHelp();
+			return -1;
+		}
+		RunStatsReport statsReport(statsFormat, tracePath);
+		auto startTime = std::chrono::steady_clock::now();
+		UpkPackage package;
+		if (isJobCountSet) {
+			package.setJobCount(jobCount);
+		}
+		if (useIndex) {
+			package.setIndexPath((std::wstring(otherThreeArgs[0]) + L".index").c_str());
+		}
+		if (!package.open(otherThreeArgs[0])) {
+			printf("%ls\n", package.getError().c_str());
+			return -1;
+		}
+		UpkExtractor extractor(package);
+		extractor.setJobCount(isJobCountSet ? jobCount : 0);
+		extractor.setIncremental(isIncremental);
+		if (!extractor.extract(otherThreeArgs[1])) {
+			printf("%ls\n", extractor.getError().c_str());
+			return -1;
+		}
+		if (!isDataOnly) {
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+			printf("Extracted %d files (%.2f MB), skipped %d unchanged ones, in %.3f s.\n",
+				extractor.getWrittenCount(), extractor.getBytesWritten() / 1048576.,
+				extractor.getSkippedCount(), seconds);
+		}
+		return 0;
 	}
-	if (!isRepackageMode) return 0;
-	if (!exportCount) return 0;
-	fseek(file, exports[0].filePositionForSizeAndOffset + 4, SEEK_SET);
-	int currentOffset;
-	fread(&currentOffset, 4, 1, file);
-	for (int exportCounter = exportCount; exportCounter > 0; --exportCounter) {
-		Export& exportStruct = exports[exportCount - exportCounter];
-		std::wstring fullPath = otherThreeArgs[1];
-		if (!fullPath.empty() && fullPath[fullPath.size() - 1] != L'\\') {
-			fullPath += L'\\';
-		}
-		for (std::wstring& pathElem : exportStruct.packagePath) {
-			fullPath += pathElem + L'\\';
-		}
-		fullPath += exportStruct.name + L'.' + exportStruct.className;
-		if (!fileExists(fullPath.c_str())) {
-			printf("File not found: %ls\n", fullPath.c_str());
+
+	if (isDiff) {
+		if (otherThreeArgsCounter != 2 || isInfo || isInfoFiltered || isHash || batchListPath || batchFolder
+				|| scanFolder || dependentsOf || isIncremental || compressionFlags || useIoUring || memoryLimit) {
+			printHelp();
+			return -1;
+		}
+		RunStatsReport statsReport(statsFormat, tracePath);
+		return diffPackages(otherThreeArgs[0], otherThreeArgs[1], isJobCountSet ? jobCount : 0, useIndex, isDataOnly);
+	}
+
+	if (scanFolder || dependentsOf) {
+		if (scanFolder && dependentsOf || otherThreeArgsCounter != 1 || isInfo || isInfoFiltered || isHash
+				|| batchListPath || batchFolder || isIncremental || compressionFlags || useIoUring || memoryLimit) {
+			printHelp();
 			return -1;
 		}
-		HANDLE resourceFileHandle = CreateFileW(
-			fullPath.c_str(),
-			GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-		DWORD resourceFileSize = GetFileSize(resourceFileHandle, NULL);
-		void* resourceBuf = malloc(resourceFileSize);
-		if (!resourceBuf) {
-			CloseHandle(resourceFileHandle);
-			printf("Failed to allocate memory: %d\n", resourceFileSize);
+		RunStatsReport statsReport(statsFormat, tracePath);
+		return scanFolder
+			? scanDependencies(scanFolder, otherThreeArgs[0], isJobCountSet ? jobCount : 0, useIndex, isDataOnly)
+			: printDependents(dependentsOf, otherThreeArgs[0], isDataOnly);
+	}
+
+	if (batchListPath || batchFolder) {
+		if (batchListPath && batchFolder || isInfo || isInfoFiltered || isHash
+				|| batchListPath && otherThreeArgsCounter != 0
+				|| batchFolder && otherThreeArgsCounter != 0 && otherThreeArgsCounter != 2
+				|| isIncremental && compressionFlags) {
+			printHelp();
 			return -1;
 		}
-		if (!ReadFile(resourceFileHandle, resourceBuf, resourceFileSize, &bytesWritten, NULL)) {
-			WinError err;
-			printf("Failed to read file %ls: %ls\n", fullPath.c_str(), err.getMessage());
+		RunStatsReport statsReport(statsFormat, tracePath);
+		auto startTime = std::chrono::steady_clock::now();
+		BatchRunner batch;
+		batch.setJobCount(isJobCountSet ? jobCount : 0);
+		batch.setIncremental(isIncremental);
+		batch.setCompression(compressionFlags);
+		batch.setIoUring(useIoUring);
+		batch.setMemoryLimit(memoryLimit);
+		batch.setUseIndex(useIndex);
+		bool isLoaded = batchListPath
+			? batch.loadJobList(batchListPath)
+			: batch.addFolder(batchFolder, otherThreeArgs[0], otherThreeArgs[1]);
+		if (!isLoaded) {
+			printf("%ls\n", batch.getError().c_str());
 			return -1;
 		}
-		CloseHandle(resourceFileHandle);
-		SetFilePointer(writeHandle, currentOffset, NULL, FILE_BEGIN);
-		WriteFile(writeHandle, resourceBuf, resourceFileSize, &bytesWritten, NULL);
-		free(resourceBuf);
-		SetFilePointer(writeHandle, exportStruct.filePositionForSizeAndOffset, NULL, FILE_BEGIN);
-		WriteFile(writeHandle, &resourceFileSize, 4, &bytesWritten, NULL);
-		WriteFile(writeHandle, &currentOffset, 4, &bytesWritten, NULL);
-		currentOffset += resourceFileSize;
+		if (!batch.run() && !batch.getError().empty()) {
+			printf("%ls\n", batch.getError().c_str());
+			return -1;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		printBatchReport(batch, isDataOnly, seconds);
+		return batch.getFailedCount() == 0 ? 0 : -1;
+	}
+
+	bool isRepackageMode = (otherThreeArgsCounter == 3);
+	if (!isRepackageMode && !isInfo
+			|| !isRepackageMode && isInfo && otherThreeArgsCounter != 1
+			|| isIncremental && compressionFlags
+			|| (useIoUring || memoryLimit) && !isRepackageMode
+			|| (infoFormat != INFO_JSON || isInfoFiltered || isHash) && !isInfo) {
+		printHelp();
+		return (argc == 1 ? 0 : -1);
+	}
+	RunStatsReport statsReport(statsFormat, tracePath);
+
+	UpkPackage package;
+	if (isJobCountSet) {
+		package.setJobCount(jobCount);
+	}
+	// The info is all in the summary and the tables, so only the header of a compressed package is needed,
+	// unless the exports are hashed too.
+	package.setDecompressOnDemand(!isRepackageMode && !isHash);
+	if (useIndex) {
+		package.setIndexPath((std::wstring(otherThreeArgs[0]) + L".index").c_str());
+	}
+	// Nor does it need the names and paths of the exports, which only repackaging does.
+	package.setLazyNames(!isRepackageMode);
+	if (!package.open(otherThreeArgs[0])) {
+		printf("%ls\n", package.getError().c_str());
+		return -1;
+	}
+	UpkRepackager repackager(package);
+	repackager.setJobCount(jobCount);
+	repackager.setIncremental(isIncremental);
+	repackager.setCompression(compressionFlags);
+	repackager.setIoUring(useIoUring);
+	repackager.setMemoryLimit(memoryLimit);
+	if (isRepackageMode && !repackager.createOutput(otherThreeArgs[2])) {
+		printf("%ls\n", repackager.getError().c_str());
+		return -1;
+	}
+	std::vector<unsigned long long> exportHashes;
+	if (isHash && !package.hashExports(exportHashes)) {
+		printf("%ls\n", package.getError().c_str());
+		return -1;
+	}
+	if (isInfo) {
+		ScopedPhase phase("Print info");
+		// A filtered query is for some of the exports, and the whole name and import tables would only be in the way.
+		if (isInfoFiltered) {
+			infoQuery.includeNames = isNamesAsked;
+			infoQuery.includeImports = isImportsAsked;
+		}
+		if (infoFormat == INFO_NDJSON) {
+			NdjsonRecordWriter out;
+			printInfoRecords(out, package, infoQuery, isHash ? &exportHashes : nullptr);
+		} else if (infoFormat == INFO_MSGPACK) {
+#ifdef _WIN32
+			// Otherwise every \n byte would get a \r put in front of it.
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			MsgPackRecordWriter out;
+			printInfoRecords(out, package, infoQuery, isHash ? &exportHashes : nullptr);
+		} else {
+			JsonWriter out;
+			printSummaryInfo(out, package.summary);
+			printTablesInfo(out, package, infoQuery, isHash ? &exportHashes : nullptr);
+		}
+	}
+	if (!isRepackageMode) return 0;
+	if (!repackager.writeOutput(otherThreeArgs[1])) {
+		printf("%ls\n", repackager.getError().c_str());
+		return -1;
+	}
+	if (!isDataOnly) {
+		for (const std::wstring& path : repackager.getUnusedFiles()) {
+			printf("File not used by any export: %ls\n", path.c_str());
+		}
+	}
+	if (compressionFlags && !isDataOnly) {
+		const UpkRepackager::CompressionStats& stats = repackager.getCompressionStats();
+		double megabytes = stats.uncompressedSize / 1048576.;
+		printf("Compressed %.2f MB into %.2f MB in %.3f s (%.1f MB/s).\n",
+			megabytes, stats.compressedSize / 1048576., stats.seconds,
+			stats.seconds > 0. ? megabytes / stats.seconds : 0.);
 	}
 
 	return 0;
 }
+
+#ifndef _WIN32
+int main(int argc, char** argv) {
+	return callWideMain(argc, argv, wmain);
+}
+#endif
@@ -0,0 +1,222 @@
+#include "RunStats.h"
+#include "FileIo.h"
+#ifdef _WIN32
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstring>
+
+#ifdef _WIN32
+#pragma comment(lib, "psapi.lib")
+
+static unsigned long getThreadId() {
+	return GetCurrentThreadId();
+}
+
+static unsigned long getProcessId() {
+	return GetCurrentProcessId();
+}
+#else
+static unsigned long getThreadId() {
+	return (unsigned long)syscall(SYS_gettid);
+}
+
+static unsigned long getProcessId() {
+	return (unsigned long)getpid();
+}
+#endif
+
+struct PhaseRecord {
+	const char* name;
+	long long startTime;
+	long long endTime;
+};
+
+// Each thread appends to its own list without locking. The lists belong to the registry rather than to the threads,
+// so they outlive the thread pools' threads and are all there when the stats are printed.
+struct ThreadRecords {
+	unsigned long threadId = 0;
+	std::vector<PhaseRecord> records;
+};
+
+static std::atomic<bool> enabled { false };
+static std::atomic<unsigned long long> stats[STAT_COUNT];
+static long long runStartTime = 0;
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<ThreadRecords>> registry;
+static thread_local ThreadRecords* threadRecords = nullptr;
+
+// In microseconds, which is what the trace format wants.
+static long long now() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void enableRunStats() {
+	runStartTime = now();
+	enabled = true;
+}
+
+bool isRunStatsEnabled() {
+	return enabled;
+}
+
+void addRunStat(RunStat stat, unsigned long long amount) {
+	if (enabled) {
+		stats[stat].fetch_add(amount, std::memory_order_relaxed);
+	}
+}
+
+ScopedPhase::ScopedPhase(const char* name) : name(name), startTime(enabled ? now() : 0) { }
+
+ScopedPhase::~ScopedPhase() {
+	if (!enabled) return;
+	if (!threadRecords) {
+		std::unique_lock<std::mutex> guard(registryMutex);
+		registry.emplace_back(new ThreadRecords());
+		threadRecords = registry.back().get();
+		threadRecords->threadId = getThreadId();
+	}
+	threadRecords->records.push_back(PhaseRecord { name, startTime, now() });
+}
+
+struct PhaseSummary {
+	const char* name;
+	unsigned long long count = 0;
+	long long totalTime = 0;
+	long long firstStart = 0;
+	long long lastEnd = 0;
+};
+
+static std::vector<PhaseSummary> summarizePhases() {
+	std::vector<PhaseRecord> records;
+	{
+		std::unique_lock<std::mutex> guard(registryMutex);
+		for (const std::unique_ptr<ThreadRecords>& thread : registry) {
+			records.insert(records.end(), thread->records.begin(), thread->records.end());
+		}
+	}
+	std::vector<PhaseSummary> phases;
+	for (const PhaseRecord& record : records) {
+		PhaseSummary* phase = nullptr;
+		for (PhaseSummary& existingPhase : phases) {
+			if (strcmp(existingPhase.name, record.name) == 0) {
+				phase = &existingPhase;
+				break;
+			}
+		}
+		if (!phase) {
+			phases.emplace_back();
+			phase = &phases.back();
+			phase->name = record.name;
+			phase->firstStart = record.startTime;
+			phase->lastEnd = record.endTime;
+		}
+		++phase->count;
+		phase->totalTime += record.endTime - record.startTime;
+		phase->firstStart = (std::min)(phase->firstStart, record.startTime);
+		phase->lastEnd = (std::max)(phase->lastEnd, record.endTime);
+	}
+	std::stable_sort(phases.begin(), phases.end(), [](const PhaseSummary& a, const PhaseSummary& b) {
+		return a.firstStart < b.firstStart;
+	});
+	return phases;
+}
+
+static unsigned long long getPeakMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	counters.cb = sizeof counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters)) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	// In kilobytes on Linux.
+	return (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+}
+
+static const char* const statNames[STAT_COUNT] {
+	"Bytes read",
+	"Read calls",
+	"Bytes written",
+	"Write calls",
+	"Seek calls",
+	"Files opened",
+	"Bytes mapped",
+	"Folder list calls",
+	"Ring submit calls"
+};
+
+void printRunStats(FILE* file) {
+	const long long totalTime = now() - runStartTime;
+	fprintf(file, "%-32s %10s %12s %12s\n", "Phase", "Count", "Total ms", "Wall ms");
+	for (const PhaseSummary& phase : summarizePhases()) {
+		fprintf(file, "%-32s %10llu %12.3f %12.3f\n", phase.name, phase.count,
+			phase.totalTime / 1000., (phase.lastEnd - phase.firstStart) / 1000.);
+	}
+	fprintf(file, "%-32s %10s %12s %12.3f\n", "Whole run", "", "", totalTime / 1000.);
+	for (int stat = 0; stat < STAT_COUNT; ++stat) {
+		fprintf(file, "%-32s %10llu\n", statNames[stat], stats[stat].load());
+	}
+	fprintf(file, "%-32s %10.2f MB\n", "Peak memory", getPeakMemory() / 1048576.);
+}
+
+void printRunStatsJson(JsonWriter& out) {
+	const long long totalTime = now() - runStartTime;
+	out.write("{\n  \"Phases\": [");
+	bool isFirst = true;
+	for (const PhaseSummary& phase : summarizePhases()) {
+		out.write(isFirst ? "\n" : ",\n");
+		isFirst = false;
+		out.write("    {\n      \"Name\": \"");
+		out.write(phase.name);
+		out.writeFormat("\",\n      \"Count\": %llu,\n      \"Total ms\": %.3f,\n      \"Wall ms\": %.3f\n    }",
+			phase.count, phase.totalTime / 1000., (phase.lastEnd - phase.firstStart) / 1000.);
+	}
+	out.write(isFirst ? "],\n" : "\n  ],\n");
+	out.writeFormat("  \"Whole run ms\": %.3f,\n", totalTime / 1000.);
+	for (int stat = 0; stat < STAT_COUNT; ++stat) {
+		out.writeFormat("  \"%s\": %llu,\n", statNames[stat], stats[stat].load());
+	}
+	out.writeFormat("  \"Peak memory\": %llu\n}\n", getPeakMemory());
+}
+
+bool writeRunStatsTrace(LPCWSTR path, std::wstring& error) {
+	FILE* file = openFileStream(path, "wb");
+	if (!file) {
+		error = L"Failed to create file at location: ";
+		error += path;
+		return false;
+	}
+	{
+		JsonWriter out(file);
+		out.write("{\"traceEvents\":[");
+		bool isFirst = true;
+		std::unique_lock<std::mutex> guard(registryMutex);
+		for (const std::unique_ptr<ThreadRecords>& thread : registry) {
+			for (const PhaseRecord& record : thread->records) {
+				out.write(isFirst ? "\n" : ",\n");
+				isFirst = false;
+				out.write("{\"name\":\"");
+				out.write(record.name);
+				out.writeFormat("\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%lu,\"tid\":%lu}",
+					record.startTime - runStartTime, record.endTime - record.startTime,
+					getProcessId(), thread->threadId);
+			}
+		}
+		out.write("\n],\"displayTimeUnit\":\"ms\"}\n");
+	}
+	fclose(file);
+	return true;
+}
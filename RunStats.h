@@ -0,0 +1,51 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include "JsonWriter.h"
+
+// Where the time and the I/O of one run of the tool go, for -stats and -trace.
+// Nothing is recorded until enableRunStats is called, so the calls spread around the code cost next to nothing otherwise.
+// Recording is safe from several threads at once.
+
+enum RunStat {
+	STAT_BYTES_READ,
+	STAT_READ_CALLS,
+	STAT_BYTES_WRITTEN,
+	STAT_WRITE_CALLS,
+	// Reads and writes all go to an offset through FileIo, so nothing seeks and this stays at zero.
+	// It's kept so that the -stats output keeps its fields.
+	STAT_SEEK_CALLS,
+	STAT_FILES_OPENED,
+	// Files are mapped rather than read, so their size is counted separately from the bytes read.
+	STAT_BYTES_MAPPED,
+	// FindFirstFile and FindNextFile calls, or readdir calls outside Windows.
+	STAT_FOLDER_LIST_CALLS,
+	// io_uring_enter calls, each of which submits and waits for the opens, reads and closes of many files.
+	STAT_RING_SUBMIT_CALLS,
+	STAT_COUNT
+};
+
+void enableRunStats();
+bool isRunStatsEnabled();
+void addRunStat(RunStat stat, unsigned long long amount = 1);
+
+// Records the time from its construction to its destruction under the given name, which must be a string literal.
+// The same name can be recorded any number of times and from any number of threads: the summary adds them up.
+class ScopedPhase {
+public:
+	explicit ScopedPhase(const char* name);
+	ScopedPhase(const ScopedPhase&) = delete;
+	ScopedPhase& operator=(const ScopedPhase&) = delete;
+	~ScopedPhase();
+private:
+	const char* name;
+	long long startTime;
+};
+
+// Phases in the order they first started, with how many times each ran, their total time and the wall time
+// from the first start to the last end, then the I/O counters and peak memory. Call once the work is done.
+void printRunStats(FILE* file);
+void printRunStatsJson(JsonWriter& out);
+// Every recorded phase as a complete event in the Chrome trace event format, one row per thread.
+// It opens in chrome://tracing or https://ui.perfetto.dev.
+bool writeRunStatsTrace(LPCWSTR path, std::wstring& error);
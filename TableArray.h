@@ -0,0 +1,113 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+// One array of a package's tables. Parsing fills it in, and then it holds its own elements, like a std::vector.
+// Or it points at elements that are somewhere else, like in a mapped index file (see PackageIndex), which must
+// then outlive it. Reading works the same either way. Changing an array that points somewhere else first copies
+// the elements into one of its own.
+template<typename T>
+class TableArray {
+public:
+	TableArray() = default;
+	TableArray(std::initializer_list<T> values) : owned(values) { refresh(); }
+	TableArray(const TableArray& other) { *this = other; }
+	TableArray(TableArray&& other) noexcept { *this = std::move(other); }
+	TableArray& operator=(const TableArray& other) {
+		if (&other == this) return *this;
+		if (other.isView()) {
+			owned = std::vector<T>{};
+			first = other.first;
+			count = other.count;
+		} else {
+			owned = other.owned;
+			refresh();
+		}
+		return *this;
+	}
+	TableArray& operator=(TableArray&& other) noexcept {
+		if (&other == this) return *this;
+		const bool otherIsView = other.isView();
+		owned = std::move(other.owned);
+		if (otherIsView) {
+			first = other.first;
+			count = other.count;
+		} else {
+			refresh();
+		}
+		other.owned.clear();
+		other.refresh();
+		return *this;
+	}
+	// Points at count elements starting at values, dropping the elements of its own.
+	void view(const T* values, size_t valueCount) {
+		owned = std::vector<T>{};
+		first = values;
+		count = valueCount;
+	}
+	bool isView() const { return first != owned.data(); }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const T* data() const { return first; }
+	const T* begin() const { return first; }
+	const T* end() const { return first + count; }
+	const T& operator[](size_t index) const { return first[index]; }
+	const T& back() const { return first[count - 1]; }
+	// Unlike operator[], gives an element that can be changed, so it makes the elements its own first.
+	T& at(size_t index) {
+		own();
+		return owned[index];
+	}
+	void push_back(const T& value) {
+		own();
+		owned.push_back(value);
+		refresh();
+	}
+	void append(const T* values, size_t valueCount) {
+		own();
+		owned.insert(owned.end(), values, values + valueCount);
+		refresh();
+	}
+	void reserve(size_t capacity) {
+		own();
+		owned.reserve(capacity);
+		refresh();
+	}
+	void resize(size_t newCount) {
+		own();
+		owned.resize(newCount);
+		refresh();
+	}
+	void assign(size_t newCount, const T& value) {
+		owned.assign(newCount, value);
+		refresh();
+	}
+	void assign(const T* values, const T* valuesEnd) {
+		owned.assign(values, valuesEnd);
+		refresh();
+	}
+	void assign(std::vector<T>&& values) {
+		owned = std::move(values);
+		refresh();
+	}
+	void clear() {
+		owned.clear();
+		refresh();
+	}
+private:
+	void own() {
+		if (isView()) {
+			std::vector<T> copy(first, first + count);
+			owned.swap(copy);
+		}
+	}
+	void refresh() {
+		first = owned.data();
+		count = owned.size();
+	}
+	std::vector<T> owned;
+	const T* first = nullptr;
+	size_t count = 0;
+};
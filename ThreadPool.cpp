@@ -0,0 +1,134 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Which pool, if any, the current thread is a worker of, and which worker.
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+ThreadPool::ThreadPool(int threadCount) {
+	if (threadCount <= 0) {
+		threadCount = getHardwareThreadCount();
+	}
+	queues.reserve(threadCount);
+	for (int i = 0; i < threadCount; ++i) {
+		queues.emplace_back(new WorkerQueue());
+	}
+	threads.reserve(threadCount);
+	for (int i = 0; i < threadCount; ++i) {
+		threads.emplace_back(&ThreadPool::workerLoop, this, (size_t)i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> guard(mutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+int ThreadPool::getHardwareThreadCount() {
+	unsigned int count = std::thread::hardware_concurrency();
+	return count ? (int)count : 1;
+}
+
+int ThreadPool::getCurrentWorker() const {
+	return currentPool == this ? (int)currentWorker : -1;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	// Tasks from outside the pool are spread over the workers' queues in turn.
+	int worker = getCurrentWorker();
+	size_t queueIndex = worker != -1 ? (size_t)worker : nextQueue++ % queues.size();
+	// Counted before it's queued, so the count never drops below zero when a worker takes the task right away.
+	{
+		std::unique_lock<std::mutex> guard(mutex);
+		++queuedTaskCount;
+	}
+	{
+		WorkerQueue& queue = *queues[queueIndex];
+		std::unique_lock<std::mutex> guard(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	taskAvailable.notify_one();
+}
+
+bool ThreadPool::runOneTask(size_t workerIndex) {
+	std::function<void()> task;
+	// The newest task of its own, which is the one most likely to still have its data in the cache.
+	{
+		WorkerQueue& queue = *queues[workerIndex];
+		std::unique_lock<std::mutex> guard(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			--queuedTaskCount;
+		}
+	}
+	// Otherwise the oldest task of another worker, which is usually the biggest piece of work left there.
+	for (size_t i = 1; !task && i < queues.size(); ++i) {
+		WorkerQueue& queue = *queues[(workerIndex + i) % queues.size()];
+		std::unique_lock<std::mutex> guard(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			--queuedTaskCount;
+		}
+	}
+	if (!task) return false;
+	task();
+	return true;
+}
+
+void ThreadPool::workerLoop(size_t workerIndex) {
+	currentPool = this;
+	currentWorker = workerIndex;
+	while (true) {
+		if (runOneTask(workerIndex)) continue;
+		std::unique_lock<std::mutex> guard(mutex);
+		taskAvailable.wait(guard, [this]{ return stopping || queuedTaskCount != 0; });
+		if (stopping && queuedTaskCount == 0) return;
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func) {
+	if (!count) return;
+	std::atomic<size_t> nextIndex { 0 };
+	auto runIndices = [&] {
+		for (size_t index = nextIndex++; index < count; index = nextIndex++) {
+			func(index);
+		}
+	};
+	const int worker = getCurrentWorker();
+	// A worker calling this takes part itself, so it needs one helper fewer.
+	size_t helperCount = (std::min)(count, threads.size()) - (worker != -1 ? 1 : 0);
+	std::atomic<size_t> helpersLeft { helperCount };
+	std::mutex doneMutex;
+	std::condition_variable done;
+	for (size_t i = 0; i < helperCount; ++i) {
+		submit([&] {
+			runIndices();
+			std::unique_lock<std::mutex> guard(doneMutex);
+			if (--helpersLeft == 0) {
+				done.notify_one();
+			}
+		});
+	}
+	if (worker == -1) {
+		std::unique_lock<std::mutex> guard(doneMutex);
+		done.wait(guard, [&]{ return helpersLeft == 0; });
+		return;
+	}
+	runIndices();
+	// The helpers that haven't started yet are most likely still in this worker's own queue.
+	while (helpersLeft != 0) {
+		if (!runOneTask((size_t)worker)) {
+			std::this_thread::yield();
+		}
+	}
+	// The last helper may still be inside notify_one, which uses doneMutex and done.
+	std::unique_lock<std::mutex> guard(doneMutex);
+}
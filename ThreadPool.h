@@ -0,0 +1,47 @@
+#pragma once
+#include <thread>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+// A fixed set of worker threads that run submitted tasks.
+// Every worker has its own queue: it takes the newest task from its own queue and, when that's empty, steals
+// the oldest task from another worker's. Tasks submitted from inside a task go to the current worker's queue,
+// so work split up by a task stays with it unless another worker runs out of work of its own.
+class ThreadPool {
+public:
+	// threadCount of 0 means one thread per hardware thread.
+	ThreadPool(int threadCount = 0);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+	int getThreadCount() const { return (int)threads.size(); }
+	void submit(std::function<void()> task);
+	// Calls func(0), func(1), ..., func(count - 1) on the pool's threads and returns once all of the calls have returned.
+	// Can be called from inside a task of the same pool: the calling worker then takes part in the calls and runs
+	// other tasks while it waits, instead of blocking.
+	void parallelFor(size_t count, const std::function<void(size_t)>& func);
+	static int getHardwareThreadCount();
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+	void workerLoop(size_t workerIndex);
+	// Runs one task from the worker's own queue or, failing that, from another's. Returns false if all were empty.
+	bool runOneTask(size_t workerIndex);
+	// The index of the calling thread among this pool's workers, or -1 if it's not one of them.
+	int getCurrentWorker() const;
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> threads;
+	// Tasks that are queued and not yet taken. Only increased with mutex held, so a waiting worker can't miss a wakeup.
+	std::atomic<size_t> queuedTaskCount { 0 };
+	std::atomic<size_t> nextQueue { 0 };
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	bool stopping = false;
+};
@@ -0,0 +1,205 @@
+#include "UpkApi.h"
+#include "UpkPackage.h"
+#include "UpkRepackager.h"
+#include <memory>
+#include <algorithm>
+
+struct UpkHandle {
+	UpkPackage package;
+	std::unique_ptr<UpkRepackager> repackager;
+	std::wstring error;
+};
+
+static int fail(const UpkHandle* handle, const std::wstring& error) {
+	const_cast<UpkHandle*>(handle)->error = error;
+	return 0;
+}
+
+static bool isOpen(const UpkHandle* handle) {
+	if (!handle->repackager) {
+		fail(handle, L"No package is open.");
+		return false;
+	}
+	return true;
+}
+
+static void copyGuid(const UEGuid& guid, unsigned int* dest) {
+	dest[0] = guid.a;
+	dest[1] = guid.b;
+	dest[2] = guid.c;
+	dest[3] = guid.d;
+}
+
+// Copies str into buffer the way upkGetObjectName describes.
+static int copyString(const std::wstring& str, wchar_t* buffer, int bufferLength) {
+	if (buffer && (size_t)bufferLength > str.size()) {
+		memcpy(buffer, str.c_str(), (str.size() + 1) * sizeof(wchar_t));
+	}
+	return (int)str.size();
+}
+
+UpkHandle* upkCreate(void) {
+	return new UpkHandle;
+}
+
+void upkDestroy(UpkHandle* handle) {
+	delete handle;
+}
+
+int upkOpen(UpkHandle* handle, const wchar_t* path) {
+	handle->repackager.reset();
+	if (!handle->package.open(path)) {
+		return fail(handle, handle->package.getError());
+	}
+	handle->repackager.reset(new UpkRepackager(handle->package));
+	return 1;
+}
+
+void upkSetDecompressOnDemand(UpkHandle* handle, int on) {
+	handle->package.setDecompressOnDemand(on != 0);
+}
+
+const wchar_t* upkGetError(const UpkHandle* handle) {
+	return handle->error.c_str();
+}
+
+int upkGetSummary(const UpkHandle* handle, UpkSummaryInfo* info) {
+	if (!isOpen(handle)) return 0;
+	const Summary& summary = handle->package.summary;
+	info->mainEngineVersion = summary.mainEngineVersion();
+	info->licenseeVersion = summary.licenseeVersion();
+	info->totalHeaderSize = summary.totalHeaderSize;
+	info->packageFlags = summary.packageFlags;
+	info->nameCount = summary.nameCount;
+	info->nameOffset = summary.nameOffset;
+	info->exportCount = summary.exportCount;
+	info->exportOffset = summary.exportOffset;
+	info->importCount = summary.importCount;
+	info->importOffset = summary.importOffset;
+	info->dependsOffset = summary.dependsOffset;
+	copyGuid(summary.guid, info->guid);
+	info->engineVersion = summary.engineVersion;
+	info->cookedContentVersion = summary.cookedContentVersion;
+	info->compressionFlags = summary.compressionFlags;
+	info->compressedChunkCount = (int)summary.compressedChunks.size();
+	info->packageSource = summary.packageSource;
+	return 1;
+}
+
+int upkGetNameCount(const UpkHandle* handle) {
+	return handle->package.nameTable.size();
+}
+
+const wchar_t* upkGetName(const UpkHandle* handle, int nameIndex) {
+	const NameTable& nameTable = handle->package.nameTable;
+	if (nameIndex < 0 || nameIndex >= nameTable.size()) {
+		fail(handle, L"Name index is out of range.");
+		return nullptr;
+	}
+	return nameTable.getName(nameIndex);
+}
+
+int upkGetImportCount(const UpkHandle* handle) {
+	return (int)handle->package.importTable.imports.size();
+}
+
+int upkGetImport(UpkHandle* handle, int importIndex, UpkImportInfo* info) {
+	const TableArray<Import>& imports = handle->package.importTable.imports;
+	if (importIndex < 0 || importIndex >= (int)imports.size()) {
+		return fail(handle, L"Import index is out of range.");
+	}
+	const Import& importStruct = imports[importIndex];
+	const NameTable& nameTable = handle->package.nameTable;
+	info->classPackage = nameTable.getName(importStruct.classPackage.nameIndex);
+	info->classPackageNumber = importStruct.classPackage.numberPart;
+	info->className = nameTable.getName(importStruct.className.nameIndex);
+	info->classNameNumber = importStruct.className.numberPart;
+	info->outerIndex = importStruct.outerIndex;
+	info->objectName = nameTable.getName(importStruct.objectName.nameIndex);
+	info->objectNameNumber = importStruct.objectName.numberPart;
+	return 1;
+}
+
+int upkGetExportCount(const UpkHandle* handle) {
+	return handle->package.exportTable.size();
+}
+
+int upkGetExport(UpkHandle* handle, int exportIndex, UpkExportInfo* info) {
+	const ExportTable& exports = handle->package.exportTable;
+	if (exportIndex < 0 || exportIndex >= exports.size()) {
+		return fail(handle, L"Export index is out of range.");
+	}
+	info->classIndex = exports.classIndices[exportIndex];
+	info->superIndex = exports.superIndices[exportIndex];
+	info->outerIndex = exports.outerIndices[exportIndex];
+	info->objectName = handle->package.nameTable.getName(exports.objectNames[exportIndex].nameIndex);
+	info->objectNameNumber = exports.objectNames[exportIndex].numberPart;
+	info->archetypeIndex = exports.archetypeIndices[exportIndex];
+	info->objectFlags = exports.objectFlags[exportIndex];
+	info->serializeSize = exports.serializeSizes[exportIndex];
+	info->serialOffset = exports.serialOffsets[exportIndex];
+	info->exportFlags = exports.exportFlags[exportIndex];
+	info->packageFlags = exports.packageFlags[exportIndex];
+	copyGuid(exports.guids[exportIndex], info->guid);
+	return 1;
+}
+
+int upkGetObjectName(UpkHandle* handle, int objectIndex, wchar_t* buffer, int bufferLength) {
+	if (!objectIndex || !handle->package.isValidObjectIndex(objectIndex)) {
+		fail(handle, L"Object index is out of range.");
+		return -1;
+	}
+	return copyString(handle->package.getObjectName(objectIndex), buffer, bufferLength);
+}
+
+int upkGetExportPath(UpkHandle* handle, int exportIndex, wchar_t* buffer, int bufferLength) {
+	const ExportTable& exports = handle->package.exportTable;
+	if (exportIndex < 0 || exportIndex >= exports.size()) {
+		fail(handle, L"Export index is out of range.");
+		return -1;
+	}
+	return copyString(exports.getObjectPath(exportIndex), buffer, bufferLength);
+}
+
+long long upkReadExportData(UpkHandle* handle, int exportIndex, void* buffer, size_t bufferSize) {
+	UpkPackage& package = handle->package;
+	const ExportTable& exports = package.exportTable;
+	if (exportIndex < 0 || exportIndex >= exports.size()) {
+		fail(handle, L"Export index is out of range.");
+		return -1;
+	}
+	const int serialOffset = exports.serialOffsets[exportIndex];
+	const int serializeSize = exports.serializeSizes[exportIndex];
+	if (serialOffset < 0 || serializeSize < 0
+			|| !package.isDecompressedOnDemand() && (size_t)serialOffset + (size_t)serializeSize > package.size()) {
+		fail(handle, L"The export's data is outside the package file.");
+		return -1;
+	}
+	size_t copySize = (std::min)((size_t)serializeSize, bufferSize);
+	if (buffer && copySize && !package.readUncompressed(serialOffset, copySize, (BYTE*)buffer)) {
+		fail(handle, package.getError());
+		return -1;
+	}
+	return serializeSize;
+}
+
+int upkReplaceExportData(UpkHandle* handle, int exportIndex, const void* data, size_t size) {
+	if (!isOpen(handle)) return 0;
+	if (exportIndex < 0 || exportIndex >= handle->package.exportTable.size()) {
+		return fail(handle, L"Export index is out of range.");
+	}
+	handle->repackager->replacePayload(exportIndex, data, size);
+	return 1;
+}
+
+int upkSave(UpkHandle* handle, const wchar_t* extractedFolder, const wchar_t* outputPath) {
+	if (!isOpen(handle)) return 0;
+	UpkRepackager& repackager = *handle->repackager;
+	bool success = repackager.createOutput(outputPath)
+		&& repackager.writeOutput(extractedFolder);
+	repackager.closeOutput();
+	if (!success) {
+		return fail(handle, repackager.getError());
+	}
+	return 1;
+}
@@ -0,0 +1,108 @@
+#pragma once
+// C interface of the UpkPackage library, for tools that want to open a package once and query or patch it in-process
+// instead of running RepackageUPK.exe and parsing its JSON.
+// Strings are returned as pointers into the package object and stay valid until upkDestroy or the next upkOpen.
+// Functions returning int return 1 on success and 0 on failure, upkGetError then says why.
+// Object indices follow the engine's convention: 0 is null, -1, -2, ... are imports 0, 1, ...,
+// 1, 2, ... are exports 0, 1, ...
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#ifdef UPKPACKAGE_EXPORTS
+#define UPK_API __declspec(dllexport)
+#else
+#define UPK_API __declspec(dllimport)
+#endif
+#else
+#define UPK_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct UpkHandle UpkHandle;
+
+typedef struct UpkSummaryInfo {
+	int mainEngineVersion;
+	int licenseeVersion;
+	int totalHeaderSize;
+	unsigned int packageFlags;
+	int nameCount;
+	int nameOffset;
+	int exportCount;
+	int exportOffset;
+	int importCount;
+	int importOffset;
+	int dependsOffset;
+	unsigned int guid[4];
+	int engineVersion;
+	int cookedContentVersion;
+	unsigned int compressionFlags;
+	int compressedChunkCount;
+	unsigned int packageSource;
+} UpkSummaryInfo;
+
+typedef struct UpkImportInfo {
+	const wchar_t* classPackage;
+	int classPackageNumber;
+	const wchar_t* className;
+	int classNameNumber;
+	int outerIndex;
+	const wchar_t* objectName;
+	int objectNameNumber;
+} UpkImportInfo;
+
+typedef struct UpkExportInfo {
+	int classIndex;
+	int superIndex;
+	int outerIndex;
+	const wchar_t* objectName;
+	int objectNameNumber;
+	int archetypeIndex;
+	unsigned long long objectFlags;
+	int serializeSize;
+	int serialOffset;
+	unsigned int exportFlags;
+	unsigned int packageFlags;
+	unsigned int guid[4];
+} UpkExportInfo;
+
+UPK_API UpkHandle* upkCreate(void);
+UPK_API void upkDestroy(UpkHandle* handle);
+UPK_API int upkOpen(UpkHandle* handle, const wchar_t* path);
+// For the packages opened after this call: if on is non-zero, compressed packages only get decompressed
+// as far as needed to read the tables, and upkReadExportData decompresses only the chunks the export is in.
+// upkSave then needs an extracted folder.
+UPK_API void upkSetDecompressOnDemand(UpkHandle* handle, int on);
+// Message of the last failed call on this handle.
+UPK_API const wchar_t* upkGetError(const UpkHandle* handle);
+
+UPK_API int upkGetSummary(const UpkHandle* handle, UpkSummaryInfo* info);
+UPK_API int upkGetNameCount(const UpkHandle* handle);
+UPK_API const wchar_t* upkGetName(const UpkHandle* handle, int nameIndex);
+UPK_API int upkGetImportCount(const UpkHandle* handle);
+UPK_API int upkGetImport(UpkHandle* handle, int importIndex, UpkImportInfo* info);
+UPK_API int upkGetExportCount(const UpkHandle* handle);
+UPK_API int upkGetExport(UpkHandle* handle, int exportIndex, UpkExportInfo* info);
+// Writes the object name, with its _N suffix, into buffer and returns its length without the null terminator.
+// If the buffer is too small (or null), nothing is written and the required length is returned.
+// Returns -1 for an invalid index.
+UPK_API int upkGetObjectName(UpkHandle* handle, int objectIndex, wchar_t* buffer, int bufferLength);
+// Same as upkGetObjectName, but writes the export's path inside the package: Outer1.Outer2.ObjectName.
+UPK_API int upkGetExportPath(UpkHandle* handle, int exportIndex, wchar_t* buffer, int bufferLength);
+// Copies the export's serialized data out of the original package, decompressed. Returns the number of bytes the data takes,
+// which may be more than bufferSize, in which case only bufferSize bytes are copied. Returns -1 on failure.
+UPK_API long long upkReadExportData(UpkHandle* handle, int exportIndex, void* buffer, size_t bufferSize);
+
+// Remembers new data for the export, to be written by the next upkSave. The data is copied.
+UPK_API int upkReplaceExportData(UpkHandle* handle, int exportIndex, const void* data, size_t size);
+// Writes a new package. Exports replaced with upkReplaceExportData use the new data,
+// the rest are read from extractedFolder if it's not null, otherwise they keep their original data.
+// Fails if outputPath already exists.
+UPK_API int upkSave(UpkHandle* handle, const wchar_t* extractedFolder, const wchar_t* outputPath);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,248 @@
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include "UpkPackage.h"
+#include "UpkInfoPrinter.h"
+#include "UpkRepackager.h"
+#include "PackageGenerator.h"
+#include "WinError.h"
+#include "FileIo.h"
+
+void printHelp() {
+	printf("%s\n",
+	"Generates UE3 packages and times how long RepackageUPK takes on them.\n"
+	"\n"
+	"Usage 1:\n"
+	" Generate a package filled with random data and the folder gildor's extract tool would extract from it.\n"
+	" Syntax:\n"
+	"   UpkBench -generate [-version V] [-names N] [-imports N] [-exports N] [-depth N] [-payload MIN MAX] [-seed N]\n"
+	"            NEW_UPK EXTRACTED_FOLDER\n"
+	" , where:\n"
+	"   -version V is the main engine version of the package. Default is 868.\n"
+	"   -names, -imports and -exports set the sizes of the tables. Defaults are 1000, 100 and 2000.\n"
+	"   -depth N is how many levels of packages the exports are put in. Default is 3.\n"
+	"   -payload MIN MAX is the range of sizes of the exports' data, in bytes. Default is 16 to 4096.\n"
+	"   -seed N changes the random data. The same settings and seed always give the same package.\n"
+	"\n"
+	"Usage 2:\n"
+	" Generate a set of packages, covering every file version the parser treats differently, plus a large one,\n"
+	" and print how long it takes to parse them, print their -info JSON and repackage them.\n"
+	" Syntax:\n"
+	"   UpkBench [-runs N] [-jobs N] WORK_FOLDER\n"
+	" , where:\n"
+	"   -runs N is how many times each step is timed. The median and the fastest time are printed. Default is 5.\n"
+	"   -jobs N is passed to the repackager, same as RepackageUPK's -jobs. Default is 1.\n"
+	"   WORK_FOLDER is where the packages and their extracted folders are generated. It's created if it\n"
+	"       doesn't exist, and the generated files are left there."
+	);
+}
+
+struct Timings {
+	std::vector<double> milliseconds;
+	double median() {
+		std::sort(milliseconds.begin(), milliseconds.end());
+		return milliseconds.empty() ? 0. : milliseconds[milliseconds.size() / 2];
+	}
+	double fastest() {
+		return milliseconds.empty() ? 0. : *std::min_element(milliseconds.begin(), milliseconds.end());
+	}
+};
+
+struct BenchmarkPackage {
+	const wchar_t* name;
+	GeneratorSettings settings;
+};
+
+static GeneratorSettings makeSettings(int fileVersion, int nameCount, int importCount, int exportCount, int depth,
+		int minPayloadSize, int maxPayloadSize) {
+	GeneratorSettings settings;
+	settings.fileVersion = fileVersion;
+	settings.nameCount = nameCount;
+	settings.importCount = importCount;
+	settings.exportCount = exportCount;
+	settings.depth = depth;
+	settings.minPayloadSize = minPayloadSize;
+	settings.maxPayloadSize = maxPayloadSize;
+	return settings;
+}
+
+// One package on each side of every version the parser checks, and a large one with deep nesting.
+static const BenchmarkPackage benchmarkPackages[] {
+	{ L"v500", makeSettings(500, 2000, 200, 5000, 4, 16, 4096) },
+	{ L"v516", makeSettings(516, 2000, 200, 5000, 4, 16, 4096) },
+	{ L"v543", makeSettings(543, 2000, 200, 5000, 4, 16, 4096) },
+	{ L"v584", makeSettings(584, 2000, 200, 5000, 4, 16, 4096) },
+	{ L"v623", makeSettings(623, 2000, 200, 5000, 4, 16, 4096) },
+	{ L"v767", makeSettings(767, 2000, 200, 5000, 4, 16, 4096) },
+	{ L"v868", makeSettings(868, 2000, 200, 5000, 4, 16, 4096) },
+	{ L"large", makeSettings(868, 50000, 5000, 100000, 10, 16, 2048) },
+};
+
+static bool benchmarkPackage(const BenchmarkPackage& benchmark, const std::wstring& workFolder, int runCount, int jobCount) {
+	const std::wstring packagePath = workFolder + benchmark.name + L".upk";
+	const std::wstring extractedFolder = workFolder + benchmark.name;
+	const std::wstring infoPath = workFolder + benchmark.name + L".json";
+	const std::wstring outputPath = workFolder + benchmark.name + L"_repackaged.upk";
+	PackageGenerator generator;
+	if (!generator.generate(benchmark.settings, packagePath.c_str(), extractedFolder.c_str())) {
+		printf("%ls\n", generator.getError().c_str());
+		return false;
+	}
+	Timings parseTimings;
+	Timings infoTimings;
+	Timings repackageTimings;
+	for (int run = 0; run < runCount; ++run) {
+		auto startTime = std::chrono::steady_clock::now();
+		UpkPackage package;
+		if (!package.open(packagePath.c_str())) {
+			printf("%ls\n", package.getError().c_str());
+			return false;
+		}
+		auto parsedTime = std::chrono::steady_clock::now();
+		parseTimings.milliseconds.push_back(std::chrono::duration<double, std::milli>(parsedTime - startTime).count());
+
+		FILE* infoFile = openFileStream(infoPath.c_str(), "wb");
+		if (!infoFile) {
+			printf("Failed to create file at location: %ls\n", infoPath.c_str());
+			return false;
+		}
+		{
+			JsonWriter out(infoFile);
+			printSummaryInfo(out, package.summary);
+			printTablesInfo(out, package);
+		}
+		fclose(infoFile);
+		auto printedTime = std::chrono::steady_clock::now();
+		infoTimings.milliseconds.push_back(std::chrono::duration<double, std::milli>(printedTime - parsedTime).count());
+
+		if (!deleteFile(outputPath.c_str())) {
+			WinError err;
+			printf("Failed to delete file %ls: %ls\n", outputPath.c_str(), err.getMessage());
+			return false;
+		}
+		auto repackageStartTime = std::chrono::steady_clock::now();
+		{
+			UpkRepackager repackager(package);
+			repackager.setJobCount(jobCount);
+			if (!repackager.createOutput(outputPath.c_str()) || !repackager.writeOutput(extractedFolder.c_str())) {
+				printf("%ls\n", repackager.getError().c_str());
+				return false;
+			}
+		}
+		repackageTimings.milliseconds.push_back(std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - repackageStartTime).count());
+	}
+	const double megabytes = generator.getPackageSize() / 1048576.;
+	const double repackageMilliseconds = repackageTimings.median();
+	printf("%-8ls %7d %8d %9.2f %10.2f (%.2f) %10.2f (%.2f) %10.2f (%.2f) %8.1f\n",
+		benchmark.name, benchmark.settings.fileVersion, benchmark.settings.exportCount, megabytes,
+		parseTimings.median(), parseTimings.fastest(),
+		infoTimings.median(), infoTimings.fastest(),
+		repackageMilliseconds, repackageTimings.fastest(),
+		repackageMilliseconds > 0. ? megabytes / (repackageMilliseconds / 1000.) : 0.);
+	return true;
+}
+
+int wmain(int argc, wchar_t** argv)
+{
+	bool isGenerate = false;
+	GeneratorSettings settings;
+	int runCount = 5;
+	int jobCount = 1;
+	wchar_t* otherArgs[2] { nullptr };
+	int otherArgsCounter = 0;
+	for (int i = 1; i < argc; ++i) {
+		wchar_t* option = argv[i];
+		// The options that take one number.
+		int* numberOption = nullptr;
+		if (_wcsicmp(option, L"-version") == 0) numberOption = &settings.fileVersion;
+		else if (_wcsicmp(option, L"-names") == 0) numberOption = &settings.nameCount;
+		else if (_wcsicmp(option, L"-imports") == 0) numberOption = &settings.importCount;
+		else if (_wcsicmp(option, L"-exports") == 0) numberOption = &settings.exportCount;
+		else if (_wcsicmp(option, L"-depth") == 0) numberOption = &settings.depth;
+		else if (_wcsicmp(option, L"-runs") == 0) numberOption = &runCount;
+		else if (_wcsicmp(option, L"-jobs") == 0) numberOption = &jobCount;
+		if (numberOption) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
+			}
+			*numberOption = (int)wcstol(argv[++i], nullptr, 10);
+			if (*numberOption < 0) {
+				printHelp();
+				return -1;
+			}
+		} else if (_wcsicmp(option, L"-generate") == 0) {
+			isGenerate = true;
+		} else if (_wcsicmp(option, L"-seed") == 0) {
+			if (i + 1 >= argc) {
+				printHelp();
+				return -1;
+			}
+			settings.seed = (unsigned int)wcstoul(argv[++i], nullptr, 10);
+		} else if (_wcsicmp(option, L"-payload") == 0) {
+			if (i + 2 >= argc) {
+				printHelp();
+				return -1;
+			}
+			settings.minPayloadSize = (int)wcstol(argv[++i], nullptr, 10);
+			settings.maxPayloadSize = (int)wcstol(argv[++i], nullptr, 10);
+			if (settings.minPayloadSize < 0 || settings.maxPayloadSize < settings.minPayloadSize) {
+				printHelp();
+				return -1;
+			}
+		} else {
+			if (otherArgsCounter >= _countof(otherArgs)) {
+				printHelp();
+				return -1;
+			}
+			otherArgs[otherArgsCounter] = option;
+			++otherArgsCounter;
+		}
+	}
+
+	if (isGenerate) {
+		if (otherArgsCounter != 2) {
+			printHelp();
+			return -1;
+		}
+		PackageGenerator generator;
+		if (!generator.generate(settings, otherArgs[0], otherArgs[1])) {
+			printf("%ls\n", generator.getError().c_str());
+			return -1;
+		}
+		printf("Generated %ls (%.2f MB).\n", otherArgs[0], generator.getPackageSize() / 1048576.);
+		return 0;
+	}
+
+	if (otherArgsCounter != 1 || runCount == 0) {
+		printHelp();
+		return (argc == 1 ? 0 : -1);
+	}
+	std::wstring workFolder = otherArgs[0];
+	if (!createFolder(workFolder.c_str())) {
+		WinError err;
+		printf("Failed to create folder %ls: %ls\n", workFolder.c_str(), err.getMessage());
+		return -1;
+	}
+	if (workFolder[workFolder.size() - 1] != PATH_SEPARATOR) {
+		workFolder += PATH_SEPARATOR;
+	}
+	printf("Median of %d runs, fastest in parentheses. Times are in milliseconds.\n", runCount);
+	printf("%-8s %7s %8s %9s %19s %19s %19s %8s\n",
+		"Package", "Version", "Exports", "Size MB", "Parse", "Info JSON", "Repackage", "MB/s");
+	for (const BenchmarkPackage& benchmark : benchmarkPackages) {
+		if (!benchmarkPackage(benchmark, workFolder, runCount, jobCount)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+#ifndef _WIN32
+int main(int argc, char** argv) {
+	return callWideMain(argc, argv, wmain);
+}
+#endif
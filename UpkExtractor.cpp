@@ -0,0 +1,229 @@
+#include "UpkExtractor.h"
+#include "RepackageManifest.h"
+#include "ExtractedFolderIndex.h"
+#include "WinError.h"
+#include "FileIo.h"
+#include "ThreadPool.h"
+#include "Hash.h"
+#include "RunStats.h"
+#include <algorithm>
+#include <cstdarg>
+#include <memory>
+
+UpkExtractor::UpkExtractor(UpkPackage& package) : package(package) { }
+
+bool UpkExtractor::fail(const wchar_t* format, ...) {
+	wchar_t buffer[1024];
+	va_list args;
+	va_start(args, format);
+	vswprintf(buffer, _countof(buffer), format, args);
+	va_end(args);
+	std::unique_lock<std::mutex> guard(errorMutex);
+	if (!failed) {
+		failed = true;
+		error = buffer;
+	}
+	return false;
+}
+
+// Whether the name can be one part of a path as it is: a name like .. or one with a separator in it would
+// point somewhere else than a folder or file of its own.
+static bool isSafePathPart(const std::wstring& name) {
+	return !name.empty() && name != L"." && name != L".."
+		&& name.find_first_of(L"/\\:") == std::wstring::npos;
+}
+
+// Whether the relative path, followed part by part, never goes above the folder it's relative to.
+static bool staysInFolder(const std::wstring& path) {
+	int depth = 0;
+	size_t start = 0;
+	while (start <= path.size()) {
+		size_t end = path.find_first_of(L"/\\", start);
+		if (end == std::wstring::npos) end = path.size();
+		const std::wstring part = path.substr(start, end - start);
+		if (part.find(L':') != std::wstring::npos) return false;
+		if (part == L"..") {
+			if (--depth < 0) return false;
+		} else if (!part.empty() && part != L".") {
+			++depth;
+		}
+		start = end + 1;
+	}
+	return true;
+}
+
+bool UpkExtractor::checkFilePaths() {
+	const ExportTable& exports = package.exportTable;
+	// The folders are the exports' outers, which are exports too, so checking every export's own names covers them.
+	for (int exportIndex = 0; exportIndex < exports.size(); ++exportIndex) {
+		if (!isSafePathPart(exports.names.get(exportIndex)) || !isSafePathPart(exports.classNames.get(exportIndex))
+				|| !staysInFolder(exports.getFilePath(exportIndex))) {
+			return fail(L"Export %d's file path %ls would not be a file of its own inside the extracted folder.",
+				exportIndex, exports.getFilePath(exportIndex).c_str());
+		}
+	}
+	return true;
+}
+
+bool UpkExtractor::createFolders(const std::wstring& root) {
+	ScopedPhase phase("Create folders");
+	const ExportTable& exports = package.exportTable;
+	// Every outer's folder is also the folder of an export itself, the outer, so this covers every level.
+	// Sorted, a folder comes before the ones inside it.
+	std::vector<std::wstring> folders { std::wstring() };
+	for (int exportIndex = 0; exportIndex < exports.size(); ++exportIndex) {
+		const int outer = exports.outerIndices[exportIndex] - 1;
+		if (outer >= 0) {
+			folders.push_back(exports.folderPaths.get(outer));
+		}
+	}
+	std::sort(folders.begin(), folders.end());
+	folders.erase(std::unique(folders.begin(), folders.end()), folders.end());
+	for (const std::wstring& folder : folders) {
+		std::wstring path = root + folder;
+		path.resize(path.size() - 1);
+		if (!createFolder(path.c_str())) {
+			WinError err;
+			return fail(L"Failed to create the folder %ls: %ls", path.c_str(), err.getMessage());
+		}
+	}
+	return true;
+}
+
+bool UpkExtractor::writeFile(const std::wstring& path, const BYTE* data, size_t size, unsigned long long writeTime) {
+	ScopedPhase phase("Write extracted file");
+	File file;
+	if (!file.open(path.c_str(), FILE_MODE_CREATE_ALWAYS)) {
+		WinError err;
+		return fail(L"Failed to create file at location: %ls\n%ls", path.c_str(), err.getMessage());
+	}
+	addRunStat(STAT_FILES_OPENED);
+	addRunStat(STAT_WRITE_CALLS);
+	addRunStat(STAT_BYTES_WRITTEN, size);
+	// Every file gets the same time, which the manifest remembers, so the next run can tell if anything touched it.
+	bool result = file.writeAt(data, size, 0) && file.setWriteTime(writeTime);
+	WinError err;
+	file.close();
+	if (!result) {
+		return fail(L"Failed to write file %ls: %ls", path.c_str(), err.getMessage());
+	}
+	return true;
+}
+
+bool UpkExtractor::extract(LPCWSTR folder) {
+	const ExportTable& exports = package.exportTable;
+	failed = false;
+	error.clear();
+	writtenCount = 0;
+	skippedCount = 0;
+	bytesWritten = 0;
+	if (exports.size() && exports.names.empty()) {
+		return fail(L"The package was opened without the export names, which the file paths are made of.");
+	}
+	// Before anything in the folder is touched.
+	if (!checkFilePaths()) return false;
+
+	std::wstring root = folder;
+	if (!root.empty() && root[root.size() - 1] == PATH_SEPARATOR) {
+		root.resize(root.size() - 1);
+	}
+	const std::wstring manifestPath = root + L".manifest";
+	root += PATH_SEPARATOR;
+
+	RepackageManifest oldManifest;
+	ExtractedFolderIndex folderIndex;
+	bool hasManifest = false;
+	if (incremental) {
+		ScopedPhase phase("Compare with manifest");
+		hasManifest = oldManifest.load(manifestPath.c_str()) && oldManifest.entries.size() == (size_t)exports.size()
+			&& folderIndex.build(folder);
+		// Once the folder starts changing, the old manifest no longer describes it.
+		if (!deleteFile(manifestPath.c_str())) {
+			WinError err;
+			return fail(L"Failed to delete the old manifest %ls: %ls", manifestPath.c_str(), err.getMessage());
+		}
+	}
+	// Then the exports are known to be the same without reading them.
+	const bool isSamePackage = hasManifest
+		&& oldManifest.packageSize == package.getFileSize()
+		&& oldManifest.packageWriteTime == package.getFileWriteTime()
+		&& memcmp(&oldManifest.packageGuid, &package.summary.guid, sizeof(UEGuid)) == 0;
+
+	if (!createFolders(root)) return false;
+
+	const unsigned long long now = getCurrentFileTime();
+	std::vector<ManifestEntry> entries(exports.size());
+	std::unique_ptr<ThreadPool> ownPool;
+	if (!sharedPool) ownPool.reset(new ThreadPool(jobCount));
+	ThreadPool& pool = sharedPool ? *sharedPool : *ownPool;
+	{
+		ScopedPhase phase("Extract exports");
+		pool.parallelFor(exports.size(), [&](size_t exportIndex) {
+			if (failed) return;
+			ManifestEntry& entry = entries[exportIndex];
+			entry.path = exports.getFilePath((int)exportIndex);
+			entry.offset = exports.serialOffsets[exportIndex];
+			// A file with the same path, size and time as last time is still the one that was written then.
+			const ManifestEntry* oldEntry = nullptr;
+			if (hasManifest) {
+				const int fileIndex = folderIndex.find(entry.path);
+				const ManifestEntry& candidate = oldManifest.entries[exportIndex];
+				if (fileIndex != -1 && candidate.path == entry.path
+						&& folderIndex.getFiles()[fileIndex].size == candidate.size
+						&& folderIndex.getFiles()[fileIndex].writeTime == candidate.writeTime) {
+					oldEntry = &candidate;
+				}
+			}
+			if (oldEntry && isSamePackage) {
+				entry = *oldEntry;
+				++skippedCount;
+				return;
+			}
+
+			std::vector<BYTE> buffer;
+			const BYTE* data = nullptr;
+			const int serialOffset = exports.serialOffsets[exportIndex];
+			const int serializeSize = exports.serializeSizes[exportIndex];
+			if (package.isDecompressedOnDemand()) {
+				if (!package.readExport((int)exportIndex, buffer)) {
+					fail(L"%ls", package.getError().c_str());
+					return;
+				}
+				data = buffer.data();
+			} else if (serialOffset < 0 || serializeSize < 0
+					|| (size_t)serialOffset + (size_t)serializeSize > package.size()) {
+				fail(L"Export %d's data is outside the package file.", (int)exportIndex);
+				return;
+			} else {
+				data = package.data() + serialOffset;
+			}
+			entry.size = (DWORD)serializeSize;
+			if (incremental) {
+				entry.hash = hash64(data, serializeSize);
+			}
+			// The package changed, but not this export.
+			if (oldEntry && oldEntry->size == entry.size && oldEntry->hash == entry.hash) {
+				entry.writeTime = oldEntry->writeTime;
+				++skippedCount;
+				return;
+			}
+			if (!writeFile(root + entry.path, data, serializeSize, now)) return;
+			entry.writeTime = now;
+			++writtenCount;
+			bytesWritten += serializeSize;
+		});
+	}
+	if (failed || !incremental) return !failed;
+
+	ScopedPhase phase("Save manifest");
+	RepackageManifest manifest;
+	manifest.packageSize = package.getFileSize();
+	manifest.packageWriteTime = package.getFileWriteTime();
+	manifest.packageGuid = package.summary.guid;
+	manifest.entries = std::move(entries);
+	if (!manifest.save(manifestPath.c_str())) {
+		WinError err;
+		return fail(L"Failed to save the manifest %ls: %ls", manifestPath.c_str(), err.getMessage());
+	}
+	return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "UpkPackage.h"
+
+class ThreadPool;
+
+// The opposite of UpkRepackager: writes every export's payload into a folder, at path\to\outer\ObjectName.ClassName,
+// the same layout gildor's extract tool makes and UpkRepackager reads back.
+// In incremental mode a manifest is kept next to the folder (EXTRACTED_FOLDER.manifest). A file that is still
+// the one the manifest describes is left alone when its export didn't change since the last extraction.
+class UpkExtractor {
+public:
+	// The package must be opened without setLazyNames, since the file paths are made of the export names.
+	UpkExtractor(UpkPackage& package);
+	UpkExtractor(const UpkExtractor&) = delete;
+	UpkExtractor& operator=(const UpkExtractor&) = delete;
+	// How many exports are read and written at the same time. 0 means one per hardware thread. The default is 1.
+	void setJobCount(int count) { jobCount = count; }
+	// Runs the work on the given pool, which must outlive extract, instead of on a pool of its own.
+	void setThreadPool(ThreadPool* pool) { sharedPool = pool; }
+	void setIncremental(bool on) { incremental = on; }
+	// Creates the folder, whose parent must exist, and its subfolders as needed. Files already at the paths
+	// of the exports are overwritten, and any other files in the folder are left alone.
+	bool extract(LPCWSTR folder);
+	// Filled in by extract.
+	int getWrittenCount() const { return writtenCount; }
+	int getSkippedCount() const { return skippedCount; }
+	unsigned long long getBytesWritten() const { return bytesWritten; }
+	const std::wstring& getError() const { return error; }
+private:
+	// Fails if an export's name or class name would take its file outside the extracted folder.
+	bool checkFilePaths();
+	bool createFolders(const std::wstring& root);
+	bool writeFile(const std::wstring& path, const BYTE* data, size_t size, unsigned long long writeTime);
+	bool fail(const wchar_t* format, ...);
+	UpkPackage& package;
+	int jobCount = 1;
+	ThreadPool* sharedPool = nullptr;
+	bool incremental = false;
+	std::atomic<int> writtenCount { 0 };
+	std::atomic<int> skippedCount { 0 };
+	std::atomic<unsigned long long> bytesWritten { 0 };
+	// Set by whichever job fails first.
+	std::mutex errorMutex;
+	std::atomic<bool> failed { false };
+	std::wstring error;
+};
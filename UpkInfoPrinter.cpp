@@ -0,0 +1,646 @@
+#include "UpkInfoPrinter.h"
+#include <algorithm>
+#include <cwctype>
+
+struct FlagWithName {
+	const char* name = nullptr;
+	DWORD value = 0;
+};
+
+static const std::vector<FlagWithName> allPackageFlags {
+	{ "AllowDownload", 0x00000001 },
+	{ "ClientOptional", 0x00000002 },
+	{ "ServerSideOnly", 0x00000004 },
+	{ "Cooked", 0x00000008 },
+	{ "Unsecure", 0x00000010 },
+	{ "SavedWithNewerVersion", 0x00000020 },
+	{ "Need", 0x00008000 },
+	{ "Compiling", 0x00010000 },
+	{ "ContainsMap", 0x00020000 },
+	{ "Trash", 0x00040000 },
+	{ "DisallowLazyLoading", 0x00080000 },
+	{ "PlayInEditor", 0x00100000 },
+	{ "ContainsScript", 0x00200000 },
+	{ "ContainsDebugInfo", 0x00400000 },
+	{ "RequireImportsAlreadyLoaded", 0x00800000 },
+	{ "StoreCompressed", 0x02000000 },
+	{ "StoreFullyCompressed", 0x04000000 },
+	{ "ContainsFaceFXData", 0x10000000 },
+	{ "NoExportAllowed", 0x20000000 },
+	{ "StrippedSource", 0x40000000 },
+	{ "FilterEditorOnly", 0x80000000 }
+};
+
+static const std::vector<FlagWithName> allCompressionFlags {
+	{ "ZLIB", 0x01 },
+	{ "LZO", 0x02 },
+	{ "LZX", 0x04 },
+	{ "BiasMemory", 0x10 },
+	{ "BiasSpeed", 0x20 },
+	{ "ForcePPUDecompressZLib", 0x80 }
+};
+
+static const std::vector<FlagWithName> allExportFlags {
+	{ "ForcedExport", 0x1 },
+	{ "ScriptPatcherExport", 0x2 },
+	{ "MemberFieldPatchPending", 0x4 }
+};
+
+static void formatGuid(char (&buffer)[37], const UEGuid& guid) {
+	snprintf(buffer, sizeof buffer, "%.8x-%.4x-%.4x-%.2x%.2x-%.2x%.2x%.2x%.2x%.2x%.2x", guid.a, guid.b & 0xffff, (guid.b >> 16) & 0xffff, guid.c & 0xff,
+		(guid.c >> 8) & 0xff, (guid.c >> 16) & 0xff, (guid.c >> 24) & 0xff, guid.d & 0xff, (guid.d >> 8) & 0xff,
+		(guid.d >> 16) & 0xff, (guid.d >> 24) & 0xff);
+}
+
+static void printGuid(JsonWriter& out, const UEGuid& guid) {
+	char buffer[37];
+	formatGuid(buffer, guid);
+	out.write(buffer);
+}
+
+static void printFlags(JsonWriter& out, DWORD flagField, const std::vector<FlagWithName>& ar, const char* spaces = nullptr) {
+	out.write("[");
+	bool isFirst = true;
+	for (const FlagWithName& fwn : ar) {
+		if ((flagField & fwn.value) != 0) {
+			if (!isFirst) {
+				out.write(",\n");
+			} else {
+				out.write("\n");
+			}
+			if (spaces) out.write(spaces);
+			out.writeFormat("  \"%s\"", fwn.name);
+			isFirst = false;
+		}
+	}
+	if (!isFirst) {
+		out.write("\n");
+		if (spaces) out.write(spaces);
+	}
+	out.write("]");
+}
+
+void printSummaryInfo(JsonWriter& out, const Summary& summary) {
+	out.writeFormat("{\n  \"Main engine version\": %hd,\n", summary.mainEngineVersion());
+	out.writeFormat("  \"Licensee version\": %hd,\n", summary.licenseeVersion());
+	out.writeFormat("  \"Total header size\": \"0x%x\",\n", summary.totalHeaderSize);
+	out.write("  \"Foler name\": \"");
+	out.writeEscaped(summary.folderName);
+	out.write("\",\n");
+	out.writeFormat("  \"Package flags\": \"0x%x\",\n", summary.packageFlags);
+	out.write("  \"Package flags list\": ");
+	printFlags(out, summary.packageFlags, allPackageFlags, "  ");
+	out.write(",\n");
+	out.writeFormat("  \"Name count\": %d,\n", summary.nameCount);
+	out.writeFormat("  \"Name offset\": \"0x%x\",\n", summary.nameOffset);
+	out.writeFormat("  \"Export count\": %d,\n", summary.exportCount);
+	out.writeFormat("  \"Export offset\": \"0x%x\",\n", summary.exportOffset);
+	out.writeFormat("  \"Import count\": %d,\n", summary.importCount);
+	out.writeFormat("  \"Import offset\": \"0x%x\",\n", summary.importOffset);
+	out.writeFormat("  \"Depends offset\": \"0x%x\",\n", summary.dependsOffset);
+	if (summary.mainEngineVersion() >= 623) {
+		out.writeFormat("  \"Import export guid offsets\": \"0x%x\",\n", summary.importExportGuidOffsets);
+		out.writeFormat("  \"Import guids count\": %d,\n", summary.importGuidsCount);
+		out.writeFormat("  \"Export guids count\": %d,\n", summary.exportGuidsCount);
+	}
+	if (summary.mainEngineVersion() >= 584) {
+		out.writeFormat("  \"Thumbnail table offset\": \"0x%x\",\n", summary.thumbnailTableOffset);
+	}
+	out.write("  \"Guid\": \"");
+	printGuid(out, summary.guid);
+	out.write("\",\n");
+	out.writeFormat("  \"Generation count\": %d,\n", (int)summary.generations.size());
+	if (!summary.generations.empty()) {
+		out.write("  \"Generations\": [\n");
+		for (size_t i = 0; i < summary.generations.size(); ++i) {
+			const GenerationInfo& generation = summary.generations[i];
+			out.writeFormat("    {\n      \"Export count\": %d,\n", generation.exportCount);
+			out.writeFormat("      \"Name count\": %d,\n", generation.nameCount);
+			out.writeFormat("      \"Net object count\": %d\n", generation.netObjectCount);
+			if (i == summary.generations.size() - 1) {
+				out.write("    }\n");
+			} else {
+				out.write("    },\n");
+			}
+		}
+		out.write("  ],\n");
+	}
+	out.writeFormat("  \"Engine version\": %d,\n", summary.engineVersion);
+	out.writeFormat("  \"Cooked content version\": %d,\n", summary.cookedContentVersion);
+	out.writeFormat("  \"Compression flags\": \"0x%x\",\n", summary.compressionFlags);
+	out.write("  \"Compression flags list\": ");
+	printFlags(out, summary.compressionFlags, allCompressionFlags, "  ");
+	out.write(",\n");
+	if (!summary.compressedChunks.empty()) {
+		out.write("  \"Compressed chunks\": [\n");
+		for (size_t i = 0; i < summary.compressedChunks.size(); ++i) {
+			const CompressedChunk& chunk = summary.compressedChunks[i];
+			out.writeFormat("    {\n      \"Uncompressed offset\": \"0x%x\",\n", chunk.uncompressedOffset);
+			out.writeFormat("      \"Uncompressed size\": \"0x%x\",\n", chunk.uncompressedSize);
+			out.writeFormat("      \"Compressed offset\": \"0x%x\",\n", chunk.compressedOffset);
+			out.writeFormat("      \"Compressed size\": \"0x%x\"\n", chunk.compressedSize);
+			if (i == summary.compressedChunks.size() - 1) {
+				out.write("    }\n");
+			} else {
+				out.write("    },\n");
+			}
+		}
+		out.write("  ],\n");
+	}
+	out.writeFormat("  \"Package source\": \"0x%x\",\n", summary.packageSource);
+	if (!summary.additionalPackagesToCook.empty()) {
+		out.write("  \"Additional packages to cook\": [\n");
+		for (size_t i = 0; i < summary.additionalPackagesToCook.size(); ++i) {
+			out.write("    \"");
+			out.writeEscaped(summary.additionalPackagesToCook[i]);
+			out.write("\"");
+			if (i == summary.additionalPackagesToCook.size() - 1) {
+				out.write("\n");
+			} else {
+				out.write(",\n");
+			}
+		}
+		out.write("  ],\n");
+	}
+	if (!summary.textureTypes.empty()) {
+		out.write("  \"Texture allocations.Texture types\": [\n");
+		for (size_t i = 0; i < summary.textureTypes.size(); ++i) {
+			const TextureType& textureType = summary.textureTypes[i];
+			out.writeFormat("    {\n      \"Size X\": %d,\n", textureType.sizeX);
+			out.writeFormat("      \"Size Y\": %d,\n", textureType.sizeY);
+			out.writeFormat("      \"Num mips\": %d,\n", textureType.numMips);
+			out.writeFormat("      \"Format\": %d,\n", textureType.format);
+			out.writeFormat("      \"Tex create flags\": \"0x%x\"", textureType.texCreateFlags);
+			if (!textureType.exportIndices.empty()) {
+				out.write(",\n      \"Export indices\": [\n");
+				for (size_t j = 0; j < textureType.exportIndices.size(); ++j) {
+					out.writeFormat("        %d", textureType.exportIndices[j]);
+					if (j == textureType.exportIndices.size() - 1) {
+						out.write("\n");
+					} else {
+						out.write(",\n");
+					}
+				}
+				out.write("      ]");
+			}
+			out.write("\n    }");
+			if (i == summary.textureTypes.size() - 1) {
+				out.write("\n");
+			} else {
+				out.write(",\n");
+			}
+		}
+		out.write("  ],\n");
+	}
+}
+
+// Writes the name with its _N suffix straight into the output, without building the string first.
+static void printNameData(JsonWriter& out, const NameTable& nameTable, const NameData& nameData) {
+	out.writeEscaped(nameTable.getName(nameData.nameIndex), nameTable.getNameLength(nameData.nameIndex));
+	if (nameData.numberPart) {
+		out.writeFormat("_%llu", (unsigned long long)(nameData.numberPart - 1));
+	}
+}
+
+// Whether the whole text matches the pattern, where * is any run of characters and ? is any one character. Ignores case.
+static bool matchesWildcard(const wchar_t* text, size_t textLength, const std::wstring& pattern) {
+	size_t textPos = 0;
+	size_t patternPos = 0;
+	// Where the last * was, and how much of the text it has taken so far.
+	size_t starPos = std::wstring::npos;
+	size_t starTextPos = 0;
+	while (textPos < textLength) {
+		if (patternPos < pattern.size() && pattern[patternPos] == L'*') {
+			starPos = patternPos++;
+			starTextPos = textPos;
+		} else if (patternPos < pattern.size() && (pattern[patternPos] == L'?'
+				|| towupper(pattern[patternPos]) == towupper(text[textPos]))) {
+			++patternPos;
+			++textPos;
+		} else if (starPos != std::wstring::npos) {
+			patternPos = starPos + 1;
+			textPos = ++starTextPos;
+		} else {
+			return false;
+		}
+	}
+	while (patternPos < pattern.size() && pattern[patternPos] == L'*') ++patternPos;
+	return patternPos == pattern.size();
+}
+
+static void appendNameData(std::wstring& str, const NameTable& nameTable, const NameData& nameData) {
+	str.append(nameTable.getName(nameData.nameIndex), nameTable.getNameLength(nameData.nameIndex));
+	if (nameData.numberPart) {
+		wchar_t suffix[24];
+		swprintf(suffix, _countof(suffix), L"_%llu", (unsigned long long)(nameData.numberPart - 1));
+		str += suffix;
+	}
+}
+
+std::vector<int> findMatchingExports(const UpkPackage& package, const InfoQuery& query) {
+	const ExportTable& exports = package.exportTable;
+	const int first = (std::max)(query.firstExport, 0);
+	const int last = (std::min)(query.lastExport, exports.size() - 1);
+	std::vector<int> result;
+	if (query.className.empty() && query.pathPattern.empty()) {
+		for (int i = first; i <= last; ++i) {
+			result.push_back(i);
+		}
+		return result;
+	}
+	// Many exports share a class, so each class object is only compared once. 0 - not compared, 1 - matches, 2 - doesn't.
+	std::vector<char> classMatches(package.importTable.imports.size() + exports.size() + 1, 0);
+	const size_t classMatchesZero = package.importTable.imports.size();
+	std::wstring className;
+	std::wstring path;
+	std::vector<int> chain;
+	for (int i = first; i <= last; ++i) {
+		if (!query.className.empty()) {
+			const int classIndex = exports.classIndices[i];
+			char& matches = classMatches[classMatchesZero + classIndex];
+			if (!matches) {
+				// Class index 0 is for the exports that are classes themselves.
+				className = L"Class";
+				if (classIndex) {
+					className.clear();
+					appendNameData(className, package.nameTable, *package.getObjectNameData(classIndex));
+				}
+				matches = _wcsicmp(className.c_str(), query.className.c_str()) == 0 ? 1 : 2;
+			}
+			if (matches != 1) continue;
+		}
+		if (!query.pathPattern.empty()) {
+			// The package made sure there are no loops in the chains of outers.
+			chain.clear();
+			for (int outer = i; outer >= 0; outer = exports.outerIndices[outer] - 1) {
+				chain.push_back(outer);
+			}
+			path.clear();
+			for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+				if (it != chain.rbegin()) {
+					path += L'.';
+				}
+				appendNameData(path, package.nameTable, exports.objectNames[*it]);
+			}
+			if (!matchesWildcard(path.c_str(), path.size(), query.pathPattern)) continue;
+		}
+		result.push_back(i);
+	}
+	return result;
+}
+
+// Prints the "// imports[N]: ..." or "// exports[N]: ..." comment that follows a non-null object index field.
+static void printObjectIndexComment(JsonWriter& out, const UpkPackage& package, const char* fieldName, int objectIndex) {
+	if (!objectIndex) return;
+	if (objectIndex < 0) {
+		out.writeFormat("      \"%s comment\": \"// imports[%d]: \\\"", fieldName, -objectIndex - 1);
+	} else {
+		out.writeFormat("      \"%s comment\": \"// exports[%d]: \\\"", fieldName, objectIndex - 1);
+	}
+	printNameData(out, package.nameTable, *package.getObjectNameData(objectIndex));
+	out.write("\\\"\",\n");
+}
+
+void printTablesInfo(JsonWriter& out, const UpkPackage& package, const InfoQuery& query,
+		const std::vector<unsigned long long>* exportHashes) {
+	const NameTable& nameTable = package.nameTable;
+	const TableArray<Import>& imports = package.importTable.imports;
+	const ExportTable& exports = package.exportTable;
+	const std::vector<int> exportIndices = findMatchingExports(package, query);
+
+	if (query.includeNames) {
+		out.write("  \"Names\": [");
+		if (nameTable.size()) {
+			for (int i = 0; i < nameTable.size(); ++i) {
+				out.write("\n    {\n      \"Name\": \"");
+				out.writeEscaped(nameTable.getName(i), nameTable.getNameLength(i));
+				out.write("\",\n");
+				out.writeFormat("      \"Context flags\": \"%llx\"\n    }", nameTable.contextFlags[i]);
+				if (i != nameTable.size() - 1) {
+					out.write(",");
+				}
+			}
+			out.write("\n  ],\n");
+		} else {
+			out.write("  ],\n");
+		}
+	}
+
+	if (!query.includeImports) {
+		// Left out.
+	} else if (imports.empty()) {
+		out.write("  \"Imports\": [],\n");
+	} else {
+		out.write("  \"Imports\": [");
+		for (size_t i = 0; i < imports.size(); ++i) {
+			const Import& importStruct = imports[i];
+			out.write("\n    {\n      \"Class package\": \"");
+			printNameData(out, package.nameTable, importStruct.classPackage);
+			out.write("\",\n");
+			out.write("      \"Class name\": \"");
+			printNameData(out, package.nameTable, importStruct.className);
+			out.write("\",\n");
+			out.writeFormat("      \"Outer index\": %d,\n", importStruct.outerIndex);
+			if (importStruct.outerIndex > 0) {
+				out.write("      \"Outer index comment\": \"// points to exports, so \\\"");
+				printNameData(out, package.nameTable, *package.getObjectNameData(importStruct.outerIndex));
+				out.write("\\\"\",\n");
+			}
+			if (importStruct.outerIndex < 0) {
+				out.write("      \"Outer index comment\": \"// points to here, into Imports, so \\\"");
+				printNameData(out, package.nameTable, *package.getObjectNameData(importStruct.outerIndex));
+				out.write("\\\"\",\n");
+			}
+			out.write("      \"Object name\": \"");
+			printNameData(out, package.nameTable, importStruct.objectName);
+			out.write("\"\n    }");
+			if (i != imports.size() - 1) {
+				out.write(",");
+			}
+		}
+		out.write("\n  ],\n");
+	}
+
+	out.write("  \"Exports\": [");
+	if (exportIndices.empty()) {
+		out.write("  ]\n");
+		out.write("}\n");
+		return;
+	}
+	for (size_t k = 0; k < exportIndices.size(); ++k) {
+		const int i = exportIndices[k];
+		out.writeFormat("\n    {\n      \"Class index\": %d,\n", exports.classIndices[i]);
+		printObjectIndexComment(out, package, "Class index", exports.classIndices[i]);
+		out.writeFormat("      \"Super index\": %d,\n", exports.superIndices[i]);
+		printObjectIndexComment(out, package, "Super index", exports.superIndices[i]);
+		out.writeFormat("      \"Outer index\": %d,\n", exports.outerIndices[i]);
+		printObjectIndexComment(out, package, "Outer index", exports.outerIndices[i]);
+		out.write("      \"Object name\": \"");
+		printNameData(out, package.nameTable, exports.objectNames[i]);
+		out.write("\",\n");
+		out.writeFormat("      \"Archetype index\": %d,\n", exports.archetypeIndices[i]);
+		printObjectIndexComment(out, package, "Archetype index", exports.archetypeIndices[i]);
+		out.writeFormat("      \"Object flags\": \"0x%llx\",\n", exports.objectFlags[i]);
+		out.writeFormat("      \"Serialize size\": \"0x%x\",\n", exports.serializeSizes[i]);
+		out.writeFormat("      \"Serial offset\": \"0x%x\",\n", exports.serialOffsets[i]);
+		out.writeFormat("      \"Export flags\": \"0x%x\",\n", exports.exportFlags[i]);
+		out.write("      \"Export flags list\": ");
+		printFlags(out, exports.exportFlags[i], allExportFlags, "      ");
+		out.write(",\n");
+		const size_t generationNetObjectCountCount = exports.getGenerationNetObjectCountCount(i);
+		if (generationNetObjectCountCount) {
+			const int* generationNetObjectCounts = exports.getGenerationNetObjectCounts(i);
+			out.write("      \"Generation net object count\": [\n");
+			for (size_t j = 0; j < generationNetObjectCountCount; ++j) {
+				out.writeFormat("        %d", generationNetObjectCounts[j]);
+				if (j != generationNetObjectCountCount - 1) {
+					out.write(",");
+				}
+				out.write("\n");
+			}
+			out.write("      ],\n");
+		}
+		out.write("      \"Guid\": \"");
+		printGuid(out, exports.guids[i]);
+		out.write("\",\n");
+		if (exportHashes) {
+			out.writeFormat("      \"Hash\": \"0x%016llx\",\n", (*exportHashes)[i]);
+		}
+		out.writeFormat("      \"Index\": %d,\n", i);
+		out.writeFormat("      \"Package flags\": \"0x%x\"\n    }", exports.packageFlags[i]);
+		if (k != exportIndices.size() - 1) {
+			out.write(",");
+		}
+	}
+	out.write("\n  ]\n");
+	out.write("}\n");
+}
+
+// Writes the name with its _N suffix, the same as printNameData.
+template<typename Writer>
+static void writeNameData(Writer& out, const NameTable& nameTable, const NameData& nameData) {
+	char suffix[24];
+	if (nameData.numberPart) {
+		snprintf(suffix, sizeof suffix, "_%llu", (unsigned long long)(nameData.numberPart - 1));
+	}
+	out.writeString(nameTable.getName(nameData.nameIndex), nameTable.getNameLength(nameData.nameIndex),
+		nameData.numberPart ? suffix : nullptr);
+}
+
+template<typename Writer>
+static void writeGuid(Writer& out, const UEGuid& guid) {
+	char buffer[37];
+	formatGuid(buffer, guid);
+	out.writeAscii(buffer);
+}
+
+template<typename Writer>
+static void writeSummaryRecord(Writer& out, const Summary& summary) {
+	out.beginRecord("Summary");
+	out.key("Main engine version");
+	out.writeInt(summary.mainEngineVersion());
+	out.key("Licensee version");
+	out.writeInt(summary.licenseeVersion());
+	out.key("Total header size");
+	out.writeInt(summary.totalHeaderSize);
+	out.key("Folder name");
+	out.writeString(summary.folderName.c_str(), summary.folderName.size());
+	out.key("Package flags");
+	out.writeUnsigned(summary.packageFlags);
+	out.key("Name count");
+	out.writeInt(summary.nameCount);
+	out.key("Name offset");
+	out.writeInt(summary.nameOffset);
+	out.key("Export count");
+	out.writeInt(summary.exportCount);
+	out.key("Export offset");
+	out.writeInt(summary.exportOffset);
+	out.key("Import count");
+	out.writeInt(summary.importCount);
+	out.key("Import offset");
+	out.writeInt(summary.importOffset);
+	out.key("Depends offset");
+	out.writeInt(summary.dependsOffset);
+	if (summary.mainEngineVersion() >= 623) {
+		out.key("Import export guid offsets");
+		out.writeInt(summary.importExportGuidOffsets);
+		out.key("Import guids count");
+		out.writeInt(summary.importGuidsCount);
+		out.key("Export guids count");
+		out.writeInt(summary.exportGuidsCount);
+	}
+	if (summary.mainEngineVersion() >= 584) {
+		out.key("Thumbnail table offset");
+		out.writeInt(summary.thumbnailTableOffset);
+	}
+	out.key("Guid");
+	writeGuid(out, summary.guid);
+	out.key("Generations");
+	out.beginArray(summary.generations.size());
+	for (const GenerationInfo& generation : summary.generations) {
+		out.beginMap(3);
+		out.key("Export count");
+		out.writeInt(generation.exportCount);
+		out.key("Name count");
+		out.writeInt(generation.nameCount);
+		out.key("Net object count");
+		out.writeInt(generation.netObjectCount);
+		out.endMap();
+	}
+	out.endArray();
+	out.key("Engine version");
+	out.writeInt(summary.engineVersion);
+	out.key("Cooked content version");
+	out.writeInt(summary.cookedContentVersion);
+	out.key("Compression flags");
+	out.writeUnsigned(summary.compressionFlags);
+	out.key("Compressed chunks");
+	out.beginArray(summary.compressedChunks.size());
+	for (const CompressedChunk& chunk : summary.compressedChunks) {
+		out.beginMap(4);
+		out.key("Uncompressed offset");
+		out.writeInt(chunk.uncompressedOffset);
+		out.key("Uncompressed size");
+		out.writeInt(chunk.uncompressedSize);
+		out.key("Compressed offset");
+		out.writeInt(chunk.compressedOffset);
+		out.key("Compressed size");
+		out.writeInt(chunk.compressedSize);
+		out.endMap();
+	}
+	out.endArray();
+	out.key("Package source");
+	out.writeUnsigned(summary.packageSource);
+	out.key("Additional packages to cook");
+	out.beginArray(summary.additionalPackagesToCook.size());
+	for (const std::wstring& packageName : summary.additionalPackagesToCook) {
+		out.writeString(packageName.c_str(), packageName.size());
+	}
+	out.endArray();
+	out.key("Texture types");
+	out.beginArray(summary.textureTypes.size());
+	for (const TextureType& textureType : summary.textureTypes) {
+		out.beginMap(6);
+		out.key("Size X");
+		out.writeInt(textureType.sizeX);
+		out.key("Size Y");
+		out.writeInt(textureType.sizeY);
+		out.key("Num mips");
+		out.writeInt(textureType.numMips);
+		out.key("Format");
+		out.writeUnsigned(textureType.format);
+		out.key("Tex create flags");
+		out.writeUnsigned(textureType.texCreateFlags);
+		out.key("Export indices");
+		out.beginArray(textureType.exportIndices.size());
+		for (int exportIndex : textureType.exportIndices) {
+			out.writeInt(exportIndex);
+		}
+		out.endArray();
+		out.endMap();
+	}
+	out.endArray();
+	out.endRecord();
+}
+
+template<typename Writer>
+static void writeNameRecord(Writer& out, const NameTable& nameTable, int nameIndex) {
+	out.beginRecord("Name");
+	out.key("Index");
+	out.writeInt(nameIndex);
+	out.key("Name");
+	out.writeString(nameTable.getName(nameIndex), nameTable.getNameLength(nameIndex));
+	out.key("Context flags");
+	out.writeUnsigned(nameTable.contextFlags[nameIndex]);
+	out.endRecord();
+}
+
+template<typename Writer>
+static void writeImportRecord(Writer& out, const UpkPackage& package, int importIndex) {
+	const Import& importStruct = package.importTable.imports[importIndex];
+	out.beginRecord("Import");
+	out.key("Index");
+	out.writeInt(importIndex);
+	out.key("Class package");
+	writeNameData(out, package.nameTable, importStruct.classPackage);
+	out.key("Class name");
+	writeNameData(out, package.nameTable, importStruct.className);
+	out.key("Outer index");
+	out.writeInt(importStruct.outerIndex);
+	out.key("Object name");
+	writeNameData(out, package.nameTable, importStruct.objectName);
+	out.endRecord();
+}
+
+template<typename Writer>
+static void writeExportRecord(Writer& out, const UpkPackage& package, int exportIndex,
+		const std::vector<unsigned long long>* exportHashes) {
+	const ExportTable& exports = package.exportTable;
+	out.beginRecord("Export");
+	out.key("Index");
+	out.writeInt(exportIndex);
+	out.key("Class index");
+	out.writeInt(exports.classIndices[exportIndex]);
+	out.key("Super index");
+	out.writeInt(exports.superIndices[exportIndex]);
+	out.key("Outer index");
+	out.writeInt(exports.outerIndices[exportIndex]);
+	out.key("Object name");
+	writeNameData(out, package.nameTable, exports.objectNames[exportIndex]);
+	out.key("Archetype index");
+	out.writeInt(exports.archetypeIndices[exportIndex]);
+	out.key("Object flags");
+	out.writeUnsigned(exports.objectFlags[exportIndex]);
+	out.key("Serialize size");
+	out.writeInt(exports.serializeSizes[exportIndex]);
+	out.key("Serial offset");
+	out.writeInt(exports.serialOffsets[exportIndex]);
+	out.key("Export flags");
+	out.writeUnsigned(exports.exportFlags[exportIndex]);
+	const size_t generationNetObjectCountCount = exports.getGenerationNetObjectCountCount(exportIndex);
+	const int* generationNetObjectCounts = exports.getGenerationNetObjectCounts(exportIndex);
+	out.key("Generation net object count");
+	out.beginArray(generationNetObjectCountCount);
+	for (size_t i = 0; i < generationNetObjectCountCount; ++i) {
+		out.writeInt(generationNetObjectCounts[i]);
+	}
+	out.endArray();
+	out.key("Guid");
+	writeGuid(out, exports.guids[exportIndex]);
+	out.key("Package flags");
+	out.writeUnsigned(exports.packageFlags[exportIndex]);
+	if (exportHashes) {
+		out.key("Hash");
+		out.writeUnsigned((*exportHashes)[exportIndex]);
+	}
+	out.endRecord();
+}
+
+template<typename Writer>
+static void writeInfoRecords(Writer& out, const UpkPackage& package, const InfoQuery& query,
+		const std::vector<unsigned long long>* exportHashes) {
+	writeSummaryRecord(out, package.summary);
+	if (query.includeNames) {
+		for (int i = 0; i < package.nameTable.size(); ++i) {
+			writeNameRecord(out, package.nameTable, i);
+		}
+	}
+	if (query.includeImports) {
+		for (int i = 0; i < (int)package.importTable.imports.size(); ++i) {
+			writeImportRecord(out, package, i);
+		}
+	}
+	for (int exportIndex : findMatchingExports(package, query)) {
+		writeExportRecord(out, package, exportIndex, exportHashes);
+	}
+}
+
+void printInfoRecords(NdjsonRecordWriter& out, const UpkPackage& package, const InfoQuery& query,
+		const std::vector<unsigned long long>* exportHashes) {
+	writeInfoRecords(out, package, query, exportHashes);
+}
+
+void printInfoRecords(MsgPackRecordWriter& out, const UpkPackage& package, const InfoQuery& query,
+		const std::vector<unsigned long long>* exportHashes) {
+	writeInfoRecords(out, package, query, exportHashes);
+}
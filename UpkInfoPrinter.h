@@ -0,0 +1,36 @@
+#pragma once
+#include "UpkPackage.h"
+#include "JsonWriter.h"
+#include "InfoRecordWriter.h"
+#include <climits>
+
+// Which rows of the tables -info prints. By default all of them.
+struct InfoQuery {
+	bool includeNames = true;
+	bool includeImports = true;
+	// The exports from firstExport to lastExport, inclusive, that are also of the class, if there is one,
+	// and whose path, like Outer1.Outer2.ObjectName, matches the pattern, if there is one.
+	// The class and the pattern ignore case, and the pattern can have * and ? wildcards in it.
+	int firstExport = 0;
+	int lastExport = INT_MAX;
+	std::wstring className;
+	std::wstring pathPattern;
+};
+
+// The indices of the exports that match the query, in table order. Builds the path only of the exports that
+// get past the other conditions, and works without exports.names, see UpkPackage::setLazyNames.
+std::vector<int> findMatchingExports(const UpkPackage& package, const InfoQuery& query);
+
+// Prints the opening of the -info JSON and all the summary fields.
+void printSummaryInfo(JsonWriter& out, const Summary& summary);
+// Prints the names, imports and exports and closes the JSON started by printSummaryInfo.
+// Without names or imports in the query, their sections are left out entirely.
+// With exportHashes, from UpkPackage::hashExports, every export also gets a "Hash" field.
+void printTablesInfo(JsonWriter& out, const UpkPackage& package, const InfoQuery& query = InfoQuery(),
+	const std::vector<unsigned long long>* exportHashes = nullptr);
+// The same info as a stream of records: the summary, then every name, import and export, in the order of the tables.
+// Only the data is there: numbers are numbers instead of hex strings, and there are no comments or flag lists.
+void printInfoRecords(NdjsonRecordWriter& out, const UpkPackage& package, const InfoQuery& query = InfoQuery(),
+	const std::vector<unsigned long long>* exportHashes = nullptr);
+void printInfoRecords(MsgPackRecordWriter& out, const UpkPackage& package, const InfoQuery& query = InfoQuery(),
+	const std::vector<unsigned long long>* exportHashes = nullptr);
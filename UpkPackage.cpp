@@ -0,0 +1,802 @@
+#include "UpkPackage.h"
+#include "WinError.h"
+#include "Compression.h"
+#include "ThreadPool.h"
+#include "RunStats.h"
+#include "PackageIndex.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstdarg>
+#include <atomic>
+
+std::wstring nameDataToString(const NameTable& nameTable, const NameData& nameData) {
+	std::wstring result(nameTable.getName(nameData.nameIndex), nameTable.getNameLength(nameData.nameIndex));
+	if (nameData.numberPart) {
+		result += L'_';
+		unsigned long long numberPart64 = nameData.numberPart - 1;
+		char buffer[25]{ '\0' };
+		snprintf(buffer, sizeof buffer, "%llu", numberPart64);
+		result.reserve(result.size() + strlen(buffer));
+		for (char* c = buffer; *c != '\0' && c - buffer <= sizeof buffer; ++c) {
+			result += (wchar_t)*c;
+		}
+	}
+	return result;
+}
+
+static void readGuid(UEGuid& guid, ByteCursor& cursor) {
+	cursor.read(guid.a);
+	cursor.read(guid.b);
+	cursor.read(guid.c);
+	cursor.read(guid.d);
+}
+
+bool UpkPackage::fail(const wchar_t* format, ...) {
+	wchar_t buffer[1024];
+	va_list args;
+	va_start(args, format);
+	vswprintf(buffer, _countof(buffer), format, args);
+	va_end(args);
+	error = buffer;
+	return false;
+}
+
+bool UpkPackage::open(LPCWSTR path) {
+	close();
+	{
+		ScopedPhase phase("Map package file");
+		if (!mappedFile.open(path)) {
+			WinError err;
+			return fail(L"Failed to open file %ls: %ls", path, err.getMessage());
+		}
+	}
+	return parse(mappedFile.data(), mappedFile.size());
+}
+
+void UpkPackage::close() {
+	// The tables can point into the index file, so they go first.
+	nameTable = NameTable{};
+	importTable = ImportTable{};
+	exportTable = ExportTable{};
+	indexFile.close();
+	mappedFile.close();
+	decompressedData = std::vector<BYTE>{};
+	sortedChunks.clear();
+	chunkFirstBlocks.clear();
+	blocks.clear();
+	uncompressedSummary.clear();
+	uncompressedSize = 0;
+	chunkCache.clear();
+	compressedData = nullptr;
+	fileData = nullptr;
+	fileSize = 0;
+	summary = Summary{};
+	loadedFromIndex = false;
+	error.clear();
+}
+
+bool UpkPackage::parse(const BYTE* data, size_t size) {
+	compressedData = data;
+	fileData = data;
+	fileSize = size;
+	ByteCursor cursor(data, size);
+	{
+		ScopedPhase phase("Parse summary");
+		if (!parseSummary(cursor)) return false;
+	}
+	if (isCompressed()) {
+		ScopedPhase phase("Decompress package");
+		if (!decompress()) return false;
+	}
+	if (summary.totalHeaderSize < 0 || (size_t)summary.totalHeaderSize > fileSize) {
+		return fail(L"Total header size 0x%x is outside the file.", summary.totalHeaderSize);
+	}
+	// A package that isn't from a file has no size and write time to tell whether the index is for it.
+	const bool useIndex = !indexPath.empty() && getFileWriteTime() != 0;
+	if (useIndex && loadPackageIndex(indexPath.c_str(), *this, indexFile)) {
+		loadedFromIndex = true;
+	} else {
+		ByteCursor tablesCursor(fileData, fileSize);
+		if (!parseNames(tablesCursor)
+				|| !parseImports(tablesCursor)
+				|| !parseExports(tablesCursor)
+				|| !resolveExports()) {
+			return false;
+		}
+		if (useIndex) {
+			// The index is only a cache. If it can't be saved, the next open parses the tables again.
+			savePackageIndex(indexPath.c_str(), *this);
+		}
+	}
+	if (!lazyNames) buildExportNames();
+	return true;
+}
+
+bool UpkPackage::parseSummary(ByteCursor& cursor) {
+	DWORD tag;
+	cursor.read(tag);
+	if (tag != PACKAGE_FILE_TAG) {
+		return fail(L"Package file tag doesn't match.");
+	}
+	cursor.read(summary.fileVersion);
+	cursor.read(summary.totalHeaderSize);
+	cursor.readString(summary.folderName);
+	summary.filePositionForPackageFlags = (int)cursor.tell();
+	cursor.read(summary.packageFlags);
+	cursor.read(summary.nameCount);
+	cursor.read(summary.nameOffset);
+	cursor.read(summary.exportCount);
+	cursor.read(summary.exportOffset);
+	cursor.read(summary.importCount);
+	cursor.read(summary.importOffset);
+	cursor.read(summary.dependsOffset);
+	const int version = summary.mainEngineVersion();
+	if (version >= 623) {
+		cursor.read(summary.importExportGuidOffsets);
+		cursor.read(summary.importGuidsCount);
+		cursor.read(summary.exportGuidsCount);
+	}
+	if (version >= 584) {
+		cursor.read(summary.thumbnailTableOffset);
+	}
+	readGuid(summary.guid, cursor);
+	int generationCount;
+	cursor.read(generationCount);
+	for (int generationCounter = generationCount; generationCounter > 0 && !cursor.overrun; --generationCounter) {
+		GenerationInfo generation;
+		cursor.read(generation.exportCount);
+		cursor.read(generation.nameCount);
+		cursor.read(generation.netObjectCount);
+		summary.generations.push_back(generation);
+	}
+	cursor.read(summary.engineVersion);
+	cursor.read(summary.cookedContentVersion);
+	summary.filePositionForCompressionFlags = (int)cursor.tell();
+	cursor.read(summary.compressionFlags);
+	int compressedChunksCount;
+	cursor.read(compressedChunksCount);
+	for (int compressedChunksCounter = compressedChunksCount; compressedChunksCounter > 0 && !cursor.overrun; --compressedChunksCounter) {
+		CompressedChunk chunk;
+		cursor.read(chunk.uncompressedOffset);
+		cursor.read(chunk.uncompressedSize);
+		cursor.read(chunk.compressedOffset);
+		cursor.read(chunk.compressedSize);
+		summary.compressedChunks.push_back(chunk);
+	}
+	cursor.read(summary.packageSource);
+	if (version >= 516) {
+		int additionalPackagesToCookCount;
+		cursor.read(additionalPackagesToCookCount);
+		for (int additionalPackagesToCookCounter = additionalPackagesToCookCount; additionalPackagesToCookCounter > 0 && !cursor.overrun; --additionalPackagesToCookCounter) {
+			std::wstring packageName;
+			cursor.readString(packageName);
+			summary.additionalPackagesToCook.push_back(packageName);
+		}
+	}
+	if (version >= 767) {
+		int textureTypesCount;
+		cursor.read(textureTypesCount);
+		for (int textureTypesCounter = textureTypesCount; textureTypesCounter > 0 && !cursor.overrun; --textureTypesCounter) {
+			TextureType textureType;
+			cursor.read(textureType.sizeX);
+			cursor.read(textureType.sizeY);
+			cursor.read(textureType.numMips);
+			cursor.read(textureType.format);
+			cursor.read(textureType.texCreateFlags);
+			int exportIndicesCount;
+			cursor.read(exportIndicesCount);
+			for (int exportIndicesCounter = exportIndicesCount; exportIndicesCounter > 0 && !cursor.overrun; --exportIndicesCounter) {
+				int exportIndex;
+				cursor.read(exportIndex);
+				textureType.exportIndices.push_back(exportIndex);
+			}
+			summary.textureTypes.push_back(std::move(textureType));
+		}
+	}
+	if (cursor.overrun) {
+		return fail(L"The package summary is cut off by the end of the file.");
+	}
+	summary.sizeInFile = (int)cursor.tell();
+	return true;
+}
+
+bool UpkPackage::readChunkBlocks(int chunkIndex, std::vector<CompressedChunk>& blocks) {
+	const CompressedChunk& chunk = summary.compressedChunks[chunkIndex];
+	if (chunk.compressedOffset < 0 || chunk.compressedSize < 0 || chunk.uncompressedOffset < 0 || chunk.uncompressedSize < 0
+			|| (size_t)chunk.compressedOffset + (size_t)chunk.compressedSize > fileSize) {
+		return fail(L"Compressed chunk %d is outside the file.", chunkIndex);
+	}
+	// Each chunk starts with a table of its blocks, followed by the blocks themselves.
+	ByteCursor cursor(fileData + chunk.compressedOffset, chunk.compressedSize);
+	DWORD tag;
+	cursor.read(tag);
+	int blockSize = cursor.readInt();
+	int compressedSize = cursor.readInt();
+	int uncompressedSize = cursor.readInt();
+	if (tag != PACKAGE_FILE_TAG) {
+		return fail(L"Compressed chunk %d doesn't start with the package file tag.", chunkIndex);
+	}
+	// Older packages store the tag in place of the block size and use the default size.
+	if (blockSize == (int)PACKAGE_FILE_TAG) {
+		blockSize = 0x20000;
+	}
+	if (blockSize <= 0 || uncompressedSize != chunk.uncompressedSize || compressedSize < 0
+			|| (size_t)compressedSize > cursor.size() - cursor.tell()) {
+		return fail(L"Compressed chunk %d has a broken block table.", chunkIndex);
+	}
+	size_t blockCount = ((size_t)uncompressedSize + blockSize - 1) / blockSize;
+	if (blockCount > (cursor.size() - cursor.tell()) / 8) {
+		return fail(L"Compressed chunk %d has a broken block table.", chunkIndex);
+	}
+	const size_t firstBlockOffset = chunk.compressedOffset + cursor.tell() + blockCount * 8;
+	size_t compressedOffset = firstBlockOffset;
+	size_t uncompressedOffset = chunk.uncompressedOffset;
+	const size_t chunkEnd = (size_t)chunk.compressedOffset + chunk.compressedSize;
+	for (size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex) {
+		CompressedChunk block;
+		cursor.read(block.compressedSize);
+		cursor.read(block.uncompressedSize);
+		if (block.compressedSize < 0 || block.uncompressedSize < 0
+				|| chunkEnd - compressedOffset < (size_t)block.compressedSize
+				|| (size_t)chunk.uncompressedOffset + uncompressedSize - uncompressedOffset < (size_t)block.uncompressedSize) {
+			return fail(L"Compressed chunk %d has a broken block table.", chunkIndex);
+		}
+		block.compressedOffset = (int)compressedOffset;
+		block.uncompressedOffset = (int)uncompressedOffset;
+		compressedOffset += block.compressedSize;
+		uncompressedOffset += block.uncompressedSize;
+		blocks.push_back(block);
+	}
+	if (uncompressedOffset != (size_t)chunk.uncompressedOffset + uncompressedSize
+			|| compressedOffset - firstBlockOffset != (size_t)compressedSize) {
+		return fail(L"Compressed chunk %d has a broken block table.", chunkIndex);
+	}
+	return true;
+}
+
+bool UpkPackage::buildChunkIndex() {
+	const std::vector<CompressedChunk>& chunks = summary.compressedChunks;
+	if (!isDecompressionSupported(summary.compressionFlags)) {
+		return fail(L"The package is compressed with a method that isn't supported (compression flags 0x%x)."
+			L" You can decompress it using gildor's decompress tool, available on his website: https://www.gildor.org/downloads",
+			summary.compressionFlags);
+	}
+	if (chunks.empty()) {
+		return fail(L"The package is compressed but has no compressed chunks.");
+	}
+	sortedChunks.clear();
+	chunkFirstBlocks.clear();
+	blocks.clear();
+	chunkCache.clear();
+	std::vector<int> chunkOrder(chunks.size());
+	for (size_t i = 0; i < chunkOrder.size(); ++i) {
+		chunkOrder[i] = (int)i;
+	}
+	std::stable_sort(chunkOrder.begin(), chunkOrder.end(), [&](int a, int b) {
+		return chunks[a].uncompressedOffset < chunks[b].uncompressedOffset;
+	});
+	for (int chunkIndex : chunkOrder) {
+		chunkFirstBlocks.push_back(blocks.size());
+		if (!readChunkBlocks(chunkIndex, blocks)) return false;
+		sortedChunks.push_back(chunks[chunkIndex]);
+	}
+	chunkFirstBlocks.push_back(blocks.size());
+	// The chunks are decompressed in parallel, so they must not overlap.
+	for (size_t i = 1; i < sortedChunks.size(); ++i) {
+		if ((size_t)sortedChunks[i - 1].uncompressedOffset + sortedChunks[i - 1].uncompressedSize
+				> (size_t)sortedChunks[i].uncompressedOffset) {
+			return fail(L"Compressed chunks overlap each other.");
+		}
+	}
+	const CompressedChunk& lastChunk = sortedChunks.back();
+	uncompressedSize = (size_t)lastChunk.uncompressedOffset + lastChunk.uncompressedSize;
+	if (uncompressedSize > INT_MAX) {
+		return fail(L"The decompressed package would be over 2 GB.");
+	}
+	// The uncompressed package starts with the same summary, minus the compressed chunk table.
+	const size_t chunkTableEnd = (size_t)summary.filePositionForCompressionFlags + 8 + chunks.size() * 16;
+	uncompressedSummary.assign(fileData, fileData + summary.filePositionForCompressionFlags);
+	DWORD packageFlags = summary.packageFlags & ~(PKG_STORE_COMPRESSED | PKG_STORE_FULLY_COMPRESSED);
+	memcpy(uncompressedSummary.data() + summary.filePositionForPackageFlags, &packageFlags, 4);
+	uncompressedSummary.resize(uncompressedSummary.size() + 8, 0);
+	uncompressedSummary.insert(uncompressedSummary.end(), fileData + chunkTableEnd, fileData + summary.sizeInFile);
+	if (uncompressedSummary.size() > (size_t)sortedChunks[0].uncompressedOffset) {
+		return fail(L"Compressed chunks overlap the package summary.");
+	}
+	return true;
+}
+
+bool UpkPackage::decompress() {
+	if (!buildChunkIndex()) return false;
+	if (decompressOnDemand) {
+		// The tables are all in the header, so that's all that needs decompressing to parse them.
+		if (summary.totalHeaderSize < 0 || (size_t)summary.totalHeaderSize > uncompressedSize) {
+			return fail(L"Total header size 0x%x is outside the file.", summary.totalHeaderSize);
+		}
+		decompressedData.resize(summary.totalHeaderSize);
+		if (!readChunks(0, decompressedData.size(), decompressedData.data())) return false;
+		fileData = decompressedData.data();
+		fileSize = decompressedData.size();
+		return true;
+	}
+	decompressedData.assign(uncompressedSize, 0);
+	memcpy(decompressedData.data(), uncompressedSummary.data(), uncompressedSummary.size());
+	std::unique_ptr<ThreadPool> ownPool;
+	if (!sharedPool) ownPool.reset(new ThreadPool(jobCount));
+	ThreadPool& pool = sharedPool ? *sharedPool : *ownPool;
+	std::atomic<bool> failed { false };
+	std::atomic<size_t> failedBlock { 0 };
+	pool.parallelFor(blocks.size(), [&](size_t blockIndex) {
+		if (failed) return;
+		const CompressedChunk& block = blocks[blockIndex];
+		if (!decompressBlock(summary.compressionFlags,
+				fileData + block.compressedOffset, block.compressedSize,
+				decompressedData.data() + block.uncompressedOffset, block.uncompressedSize)) {
+			failedBlock = blockIndex;
+			failed = true;
+		}
+	});
+	if (failed) {
+		return fail(L"Failed to decompress the block at 0x%x: the data is corrupt.",
+			blocks[failedBlock].compressedOffset);
+	}
+	fileData = decompressedData.data();
+	fileSize = decompressedData.size();
+	return true;
+}
+
+void UpkPackage::setChunkCacheSize(size_t chunkCount) {
+	std::unique_lock<std::mutex> guard(chunkCacheMutex);
+	chunkCache.setCapacity(chunkCount);
+}
+
+bool UpkPackage::readChunks(size_t offset, size_t size, BYTE* out) {
+	if (offset > uncompressedSize || size > uncompressedSize - offset) {
+		return fail(L"0x%zx bytes at 0x%zx are outside the decompressed package.", size, offset);
+	}
+	// Gaps between chunks read as zeros, same as when the whole package is decompressed.
+	memset(out, 0, size);
+	if (offset < uncompressedSummary.size()) {
+		memcpy(out, uncompressedSummary.data() + offset, (std::min)(size, uncompressedSummary.size() - offset));
+	}
+	const size_t end = offset + size;
+	// The first chunk that ends after offset.
+	size_t chunkIndex = std::upper_bound(sortedChunks.begin(), sortedChunks.end(), offset,
+		[](size_t position, const CompressedChunk& chunk) {
+			return position < (size_t)chunk.uncompressedOffset + chunk.uncompressedSize;
+		}) - sortedChunks.begin();
+	for (; chunkIndex < sortedChunks.size() && (size_t)sortedChunks[chunkIndex].uncompressedOffset < end; ++chunkIndex) {
+		const CompressedChunk& chunk = sortedChunks[chunkIndex];
+		const std::vector<BYTE>* chunkData = chunkCache.find(chunkIndex);
+		if (!chunkData) {
+			ScopedPhase phase("Decompress chunk");
+			std::vector<BYTE> decompressedChunk(chunk.uncompressedSize);
+			for (size_t blockIndex = chunkFirstBlocks[chunkIndex]; blockIndex < chunkFirstBlocks[chunkIndex + 1]; ++blockIndex) {
+				const CompressedChunk& block = blocks[blockIndex];
+				if (!decompressBlock(summary.compressionFlags,
+						compressedData + block.compressedOffset, block.compressedSize,
+						decompressedChunk.data() + (block.uncompressedOffset - chunk.uncompressedOffset),
+						block.uncompressedSize)) {
+					return fail(L"Failed to decompress the block at 0x%x: the data is corrupt.", block.compressedOffset);
+				}
+			}
+			chunkData = &chunkCache.insert(chunkIndex, std::move(decompressedChunk));
+		}
+		size_t from = (std::max)(offset, (size_t)chunk.uncompressedOffset);
+		size_t to = (std::min)(end, (size_t)chunk.uncompressedOffset + chunk.uncompressedSize);
+		memcpy(out + (from - offset), chunkData->data() + (from - chunk.uncompressedOffset), to - from);
+	}
+	return true;
+}
+
+bool UpkPackage::readUncompressed(size_t offset, size_t size, BYTE* out) {
+	if (isDecompressedOnDemand()) {
+		std::unique_lock<std::mutex> guard(chunkCacheMutex);
+		return readChunks(offset, size, out);
+	}
+	if (offset > fileSize || size > fileSize - offset) {
+		std::unique_lock<std::mutex> guard(chunkCacheMutex);
+		return fail(L"0x%zx bytes at 0x%zx are outside the package file.", size, offset);
+	}
+	memcpy(out, fileData + offset, size);
+	return true;
+}
+
+bool UpkPackage::readExport(int exportIndex, std::vector<BYTE>& out) {
+	if (exportIndex < 0 || exportIndex >= exportTable.size()) {
+		std::unique_lock<std::mutex> guard(chunkCacheMutex);
+		return fail(L"Export index %d is out of range.", exportIndex);
+	}
+	const int serialOffset = exportTable.serialOffsets[exportIndex];
+	const int serializeSize = exportTable.serializeSizes[exportIndex];
+	if (serialOffset < 0 || serializeSize < 0) {
+		std::unique_lock<std::mutex> guard(chunkCacheMutex);
+		return fail(L"Export %d's data is outside the package file.", exportIndex);
+	}
+	out.resize(serializeSize);
+	return readUncompressed(serialOffset, serializeSize, out.data());
+}
+
+bool UpkPackage::hashExports(std::vector<unsigned long long>& hashes) {
+	ScopedPhase phase("Hash exports");
+	hashes.assign(exportTable.size(), 0);
+	std::unique_ptr<ThreadPool> ownPool;
+	if (!sharedPool) ownPool.reset(new ThreadPool(jobCount));
+	ThreadPool& pool = sharedPool ? *sharedPool : *ownPool;
+	std::atomic<bool> failed { false };
+	pool.parallelFor(hashes.size(), [&](size_t exportIndex) {
+		if (failed) return;
+		const int serialOffset = exportTable.serialOffsets[exportIndex];
+		const int serializeSize = exportTable.serializeSizes[exportIndex];
+		if (isDecompressedOnDemand()) {
+			std::vector<BYTE> buffer;
+			if (!readExport((int)exportIndex, buffer)) {
+				failed = true;
+				return;
+			}
+			hashes[exportIndex] = hash64(buffer.data(), buffer.size());
+		} else if (serialOffset < 0 || serializeSize < 0 || (size_t)serialOffset + (size_t)serializeSize > fileSize) {
+			std::unique_lock<std::mutex> guard(chunkCacheMutex);
+			failed = true;
+			fail(L"Export %d's data is outside the package file.", (int)exportIndex);
+		} else {
+			hashes[exportIndex] = hash64(fileData + serialOffset, serializeSize);
+		}
+	});
+	return !failed;
+}
+
+bool UpkPackage::parseNames(ByteCursor& cursor) {
+	ScopedPhase phase("Parse names");
+	if (summary.nameCount <= 0) {
+		nameTable.nameStarts.push_back(0);
+		return true;
+	}
+	cursor.seek(summary.nameOffset);
+	// Filled in as plain vectors, since the strings are read straight into the arena, and then handed to the table.
+	// A guess that's usually close, so the arena rarely grows more than once or twice.
+	std::vector<wchar_t> arena;
+	std::vector<size_t> nameStarts { 0 };
+	std::vector<unsigned long long> contextFlags;
+	arena.reserve((size_t)(std::min)(summary.nameCount, 0x1000000) * 16);
+	nameStarts.reserve((size_t)(std::min)(summary.nameCount, 0x1000000) + 1);
+	contextFlags.reserve((size_t)(std::min)(summary.nameCount, 0x1000000));
+	for (int nameCounter = summary.nameCount; nameCounter > 0 && !cursor.overrun; --nameCounter) {
+		cursor.appendString(arena);
+		arena.push_back(L'\0');
+		unsigned long long flags;
+		cursor.read(flags);
+		nameStarts.push_back(arena.size());
+		contextFlags.push_back(flags);
+	}
+	if (cursor.overrun) {
+		return fail(L"The name table is cut off by the end of the file.");
+	}
+	nameTable.arena.assign(std::move(arena));
+	nameTable.nameStarts.assign(std::move(nameStarts));
+	nameTable.contextFlags.assign(std::move(contextFlags));
+	return true;
+}
+
+bool UpkPackage::readNameData(ByteCursor& cursor, NameData& nameData) {
+	cursor.read(nameData.nameIndex);
+	if (nameData.nameIndex < 0 || nameData.nameIndex >= nameTable.size()) {
+		return fail(L"Name index %d outside the range [0;%d)", nameData.nameIndex, nameTable.size());
+	}
+	cursor.read(nameData.numberPart);
+	return true;
+}
+
+bool UpkPackage::parseImports(ByteCursor& cursor) {
+	ScopedPhase phase("Parse imports");
+	if (summary.importCount <= 0) return true;
+	std::vector<Import> imports;
+	cursor.seek(summary.importOffset);
+	for (int importCounter = summary.importCount; importCounter > 0 && !cursor.overrun; --importCounter) {
+		imports.emplace_back();
+		Import& importStruct = imports.back();
+		if (!readNameData(cursor, importStruct.classPackage)) return false;
+		if (!readNameData(cursor, importStruct.className)) return false;
+		cursor.read(importStruct.outerIndex);
+		if (!readNameData(cursor, importStruct.objectName)) return false;
+	}
+	if (cursor.overrun) {
+		return fail(L"The import table is cut off by the end of the file.");
+	}
+	importTable.imports.assign(std::move(imports));
+	return true;
+}
+
+// The export table's arrays while the table is parsed, as plain vectors, which are a little quicker to add to than
+// TableArrays. They're handed to the table once the whole table is read.
+struct ParsedExports {
+	std::vector<int> classIndices;
+	std::vector<int> superIndices;
+	std::vector<int> outerIndices;
+	std::vector<NameData> objectNames;
+	std::vector<int> archetypeIndices;
+	std::vector<unsigned long long> objectFlags;
+	std::vector<int> serializeSizes;
+	std::vector<int> serialOffsets;
+	std::vector<DWORD> exportFlags;
+	std::vector<int> generationNetObjectCounts;
+	std::vector<size_t> generationNetObjectCountStarts { 0 };
+	std::vector<UEGuid> guids;
+	std::vector<DWORD> packageFlags;
+	std::vector<int> filePositionsForSizeAndOffset;
+	void reserve(size_t count) {
+		classIndices.reserve(count);
+		superIndices.reserve(count);
+		outerIndices.reserve(count);
+		objectNames.reserve(count);
+		archetypeIndices.reserve(count);
+		objectFlags.reserve(count);
+		serializeSizes.reserve(count);
+		serialOffsets.reserve(count);
+		exportFlags.reserve(count);
+		generationNetObjectCountStarts.reserve(count + 1);
+		guids.reserve(count);
+		packageFlags.reserve(count);
+		filePositionsForSizeAndOffset.reserve(count);
+	}
+	void handOver(ExportTable& table) {
+		table.classIndices.assign(std::move(classIndices));
+		table.superIndices.assign(std::move(superIndices));
+		table.outerIndices.assign(std::move(outerIndices));
+		table.objectNames.assign(std::move(objectNames));
+		table.archetypeIndices.assign(std::move(archetypeIndices));
+		table.objectFlags.assign(std::move(objectFlags));
+		table.serializeSizes.assign(std::move(serializeSizes));
+		table.serialOffsets.assign(std::move(serialOffsets));
+		table.exportFlags.assign(std::move(exportFlags));
+		table.generationNetObjectCounts.assign(std::move(generationNetObjectCounts));
+		table.generationNetObjectCountStarts.assign(std::move(generationNetObjectCountStarts));
+		table.guids.assign(std::move(guids));
+		table.packageFlags.assign(std::move(packageFlags));
+		table.filePositionsForSizeAndOffset.assign(std::move(filePositionsForSizeAndOffset));
+	}
+};
+
+bool UpkPackage::parseExports(ByteCursor& cursor) {
+	if (summary.exportCount <= 0) return true;
+	ParsedExports exports;
+	const int version = summary.mainEngineVersion();
+	ScopedPhase phase("Parse exports");
+	cursor.seek(summary.exportOffset);
+	// Every export takes at least this many bytes, so a broken count can't make the reservation huge.
+	const size_t minExportSize = 68;
+	exports.reserve((std::min)((size_t)summary.exportCount, (cursor.size() - cursor.tell()) / minExportSize + 1));
+	// Class, outer and other indices can point forward, so they're checked and resolved once the whole table is read.
+	for (int exportCounter = summary.exportCount; exportCounter > 0 && !cursor.overrun; --exportCounter) {
+		exports.classIndices.push_back(cursor.readInt());
+		exports.superIndices.push_back(cursor.readInt());
+		exports.outerIndices.push_back(cursor.readInt());
+		NameData objectName;
+		if (!readNameData(cursor, objectName)) return false;
+		exports.objectNames.push_back(objectName);
+		exports.archetypeIndices.push_back(cursor.readInt());
+		unsigned long long objectFlags;
+		cursor.read(objectFlags);
+		exports.objectFlags.push_back(objectFlags);
+		exports.filePositionsForSizeAndOffset.push_back((int)cursor.tell());
+		exports.serializeSizes.push_back(cursor.readInt());
+		exports.serialOffsets.push_back(cursor.readInt());
+		if (version < 543) {
+			int len;
+			cursor.read(len);
+			cursor.skip((size_t)len * 3 * 4);
+		}
+		DWORD exportFlags;
+		cursor.read(exportFlags);
+		exports.exportFlags.push_back(exportFlags);
+		int generationNetObjectCountCount;
+		cursor.read(generationNetObjectCountCount);
+		for (int generationNetObjectCountCounter = generationNetObjectCountCount;
+				generationNetObjectCountCounter > 0 && !cursor.overrun; --generationNetObjectCountCounter) {
+			exports.generationNetObjectCounts.push_back(cursor.readInt());
+		}
+		exports.generationNetObjectCountStarts.push_back(exports.generationNetObjectCounts.size());
+		UEGuid guid;
+		readGuid(guid, cursor);
+		exports.guids.push_back(guid);
+		DWORD packageFlags;
+		cursor.read(packageFlags);
+		exports.packageFlags.push_back(packageFlags);
+	}
+	if (cursor.overrun) {
+		return fail(L"The export table is cut off by the end of the file.");
+	}
+	exports.handOver(exportTable);
+	return true;
+}
+
+bool UpkPackage::resolveExports() {
+	if (exportTable.empty()) return true;
+	ScopedPhase phase("Check export references");
+	ExportTable& exports = exportTable;
+	const int exportCount = exports.size();
+	for (int i = 0; i < exportCount; ++i) {
+		if (!isValidObjectIndex(exports.classIndices[i])
+				|| !isValidObjectIndex(exports.superIndices[i])
+				|| !isValidObjectIndex(exports.outerIndices[i])
+				|| !isValidObjectIndex(exports.archetypeIndices[i])) {
+			return fail(L"Export %d refers to an object outside the import and export tables.", i);
+		}
+	}
+	for (const Import& importStruct : importTable.imports) {
+		if (!isValidObjectIndex(importStruct.outerIndex)) {
+			return fail(L"Import \"%ls\" has outer index %d outside the import and export tables.",
+				nameDataToString(nameTable, importStruct.objectName).c_str(), importStruct.outerIndex);
+		}
+	}
+	// Anything following the outers relies on there being no loops.
+	std::vector<char> outerStates(exportCount, 0);  // 0 - not checked, 1 - being checked, 2 - checked
+	std::vector<int> chain;
+	for (int i = 0; i < exportCount; ++i) {
+		chain.clear();
+		int outer = exports.outerIndices[i] - 1;
+		while (outer >= 0 && outerStates[outer] != 2) {
+			if (outerStates[outer] == 1) {
+				return fail(L"Export \"%ls\" has a loop in its chain of outers.",
+					nameDataToString(nameTable, exports.objectNames[i]).c_str());
+			}
+			outerStates[outer] = 1;
+			chain.push_back(outer);
+			outer = exports.outerIndices[outer] - 1;
+		}
+		for (int checked : chain) {
+			outerStates[checked] = 2;
+		}
+	}
+	return true;
+}
+
+// Adds the name the way nameDataToString makes it, without making a string of it first.
+static void appendNameData(std::vector<wchar_t>& arena, const NameTable& nameTable, const NameData& nameData) {
+	const wchar_t* name = nameTable.getName(nameData.nameIndex);
+	arena.insert(arena.end(), name, name + nameTable.getNameLength(nameData.nameIndex));
+	if (nameData.numberPart) {
+		// Most exports have a number, so the digits are written out by hand rather than with snprintf.
+		unsigned long long numberPart64 = nameData.numberPart - 1;
+		wchar_t digits[21];
+		wchar_t* first = digits + _countof(digits);
+		do {
+			*--first = (wchar_t)(L'0' + numberPart64 % 10);
+			numberPart64 /= 10;
+		} while (numberPart64);
+		arena.push_back(L'_');
+		arena.insert(arena.end(), first, digits + _countof(digits));
+	}
+}
+
+void UpkPackage::buildExportNames() {
+	if (exportTable.empty()) return;
+	ScopedPhase phase("Build export names and paths");
+	ExportTable& exports = exportTable;
+	const size_t exportCount = exports.size();
+	// Each table is put together in plain vectors and then handed over.
+	std::vector<wchar_t> nameArena;
+	std::vector<StringSpan> nameSpans(exportCount);
+	nameArena.reserve(exportCount * 16);
+	for (size_t i = 0; i < exportCount; ++i) {
+		nameSpans[i].start = nameArena.size();
+		appendNameData(nameArena, nameTable, exports.objectNames[i]);
+		nameSpans[i].length = nameArena.size() - nameSpans[i].start;
+	}
+
+	// A package has few classes and many exports of each, so every class name is in the arena once and the exports
+	// of a class share it.
+	std::vector<wchar_t> classArena;
+	std::vector<StringSpan> classSpans(exportCount);
+	const size_t importCount = importTable.imports.size();
+	std::vector<size_t> classSpanOf(importCount + 1 + exportCount, SIZE_MAX);  // by class index + importCount
+	for (size_t i = 0; i < exportCount; ++i) {
+		const int classIndex = exports.classIndices[i];
+		size_t& known = classSpanOf[classIndex + importCount];
+		if (known != SIZE_MAX) {
+			classSpans[i] = classSpans[known];
+			continue;
+		}
+		known = i;
+		classSpans[i].start = classArena.size();
+		if (classIndex > 0) {
+			const StringSpan& name = nameSpans[classIndex - 1];
+			classArena.insert(classArena.end(), nameArena.begin() + name.start, nameArena.begin() + name.start + name.length);
+		} else if (classIndex < 0) {
+			appendNameData(classArena, nameTable, importTable.imports[-classIndex - 1].objectName);
+		} else {
+			// A class index of 0 means the export is a class itself. gildor's extract tool names those files
+			// Name.Class, so the repackager finds them under the same name.
+			static const wchar_t classOfClasses[] = L"Class";
+			classArena.insert(classArena.end(), classOfClasses, classOfClasses + _countof(classOfClasses) - 1);
+		}
+		classSpans[i].length = classArena.size() - classSpans[i].start;
+	}
+
+	// Outers that are imports don't make folders, so the chains only follow exports. resolveExports or the index
+	// already made sure there are no loops in them.
+	std::vector<wchar_t> folderArena;
+	std::vector<StringSpan> folderSpans(exportCount);
+	std::vector<char> isBuilt(exportCount, 0);
+	std::vector<int> chain;
+	for (size_t i = 0; i < exportCount; ++i) {
+		chain.clear();
+		for (int outer = exports.outerIndices[i] - 1; outer >= 0 && !isBuilt[outer]; outer = exports.outerIndices[outer] - 1) {
+			chain.push_back(outer);
+		}
+		for (auto folder = chain.rbegin(); folder != chain.rend(); ++folder) {
+			isBuilt[*folder] = 1;
+			const int parent = exports.outerIndices[*folder] - 1;
+			StringSpan& folderPath = folderSpans[*folder];
+			folderPath.start = folderArena.size();
+			if (parent >= 0) {
+				// Copied through a resize, since inserting a range of the vector into itself isn't allowed.
+				const StringSpan parentPath = folderSpans[parent];
+				folderArena.resize(folderPath.start + parentPath.length);
+				std::copy(folderArena.begin() + parentPath.start, folderArena.begin() + parentPath.start + parentPath.length,
+					folderArena.begin() + folderPath.start);
+			}
+			const StringSpan& name = nameSpans[*folder];
+			folderArena.insert(folderArena.end(), nameArena.begin() + name.start, nameArena.begin() + name.start + name.length);
+			folderArena.push_back(PATH_SEPARATOR);
+			folderPath.length = folderArena.size() - folderPath.start;
+		}
+	}
+
+	exports.names.arena.assign(std::move(nameArena));
+	exports.names.spans.assign(std::move(nameSpans));
+	exports.classNames.arena.assign(std::move(classArena));
+	exports.classNames.spans.assign(std::move(classSpans));
+	exports.folderPaths.arena.assign(std::move(folderArena));
+	exports.folderPaths.spans.assign(std::move(folderSpans));
+}
+
+std::wstring ExportTable::getFilePath(int exportIndex) const {
+	int outer = outerIndices[exportIndex] - 1;
+	std::wstring path;
+	if (outer >= 0) {
+		path.assign(folderPaths.getString(outer), folderPaths.getLength(outer));
+	}
+	path.append(names.getString(exportIndex), names.getLength(exportIndex));
+	path += L'.';
+	path.append(classNames.getString(exportIndex), classNames.getLength(exportIndex));
+	return path;
+}
+
+std::wstring ExportTable::getObjectPath(int exportIndex) const {
+	// Names can have any characters in them, so the path is built from the names rather than from folderPaths.
+	std::vector<int> chain;
+	for (int outer = exportIndex; outer >= 0; outer = outerIndices[outer] - 1) {
+		chain.push_back(outer);
+	}
+	std::wstring path;
+	for (auto link = chain.rbegin(); link != chain.rend(); ++link) {
+		if (!path.empty()) {
+			path += L'.';
+		}
+		path.append(names.getString(*link), names.getLength(*link));
+	}
+	return path;
+}
+
+bool UpkPackage::isValidObjectIndex(int objectIndex) const {
+	return objectIndex >= -(int)importTable.imports.size()
+		&& objectIndex <= exportTable.size();
+}
+
+std::wstring UpkPackage::getObjectName(int objectIndex) const {
+	if (objectIndex > 0 && !exportTable.names.empty()) {
+		return exportTable.names.get(objectIndex - 1);
+	}
+	const NameData* nameData = getObjectNameData(objectIndex);
+	return nameData ? nameDataToString(nameTable, *nameData) : std::wstring();
+}
+
+const NameData* UpkPackage::getObjectNameData(int objectIndex) const {
+	if (objectIndex < 0) {
+		return &importTable.imports[-objectIndex - 1].objectName;
+	} else if (objectIndex > 0) {
+		return &exportTable.objectNames[objectIndex - 1];
+	}
+	return nullptr;
+}
@@ -0,0 +1,281 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "ByteCursor.h"
+#include "ChunkCache.h"
+#include "TableArray.h"
+#include <mutex>
+
+class ThreadPool;
+
+#define PACKAGE_FILE_TAG			0x9E2A83C1
+#define PKG_STORE_COMPRESSED		0x02000000
+#define PKG_STORE_FULLY_COMPRESSED	0x04000000
+
+struct UEGuid {
+	DWORD a = 0;
+	DWORD b = 0;
+	DWORD c = 0;
+	DWORD d = 0;
+};
+
+// A name as the tables store it: an index into the name table and a number part.
+struct NameData {
+	int nameIndex = 0;
+	int numberPart = 0;
+};
+
+struct GenerationInfo {
+	int exportCount = 0;
+	int nameCount = 0;
+	int netObjectCount = 0;
+};
+
+// Also used for the blocks a chunk is made of, which are compressed separately from each other.
+struct CompressedChunk {
+	int uncompressedOffset = 0;
+	int uncompressedSize = 0;
+	int compressedOffset = 0;
+	int compressedSize = 0;
+};
+
+struct TextureType {
+	int sizeX = 0;
+	int sizeY = 0;
+	int numMips = 0;
+	DWORD format = 0;
+	DWORD texCreateFlags = 0;
+	std::vector<int> exportIndices;
+};
+
+// Everything stored in the package file before the name table.
+struct Summary {
+	int fileVersion = 0;
+	int totalHeaderSize = 0;
+	std::wstring folderName;
+	DWORD packageFlags = 0;
+	int nameCount = 0;
+	int nameOffset = 0;
+	int exportCount = 0;
+	int exportOffset = 0;
+	int importCount = 0;
+	int importOffset = 0;
+	int dependsOffset = 0;
+	// Only present in file version 623 and above.
+	int importExportGuidOffsets = -1;
+	int importGuidsCount = 0;
+	int exportGuidsCount = 0;
+	// Only present in file version 584 and above.
+	int thumbnailTableOffset = 0;
+	UEGuid guid;
+	std::vector<GenerationInfo> generations;
+	int engineVersion = 0;
+	int cookedContentVersion = 0;
+	DWORD compressionFlags = 0;
+	std::vector<CompressedChunk> compressedChunks;
+	DWORD packageSource = 0;
+	// Only present in file version 516 and above.
+	std::vector<std::wstring> additionalPackagesToCook;
+	// Only present in file version 767 and above.
+	std::vector<TextureType> textureTypes;
+	// Where packageFlags and compressionFlags are in the file, and how many bytes the whole summary takes.
+	int filePositionForPackageFlags = 0;
+	int filePositionForCompressionFlags = 0;
+	int sizeInFile = 0;
+	int mainEngineVersion() const { return fileVersion & 0xffff; }
+	int licenseeVersion() const { return (fileVersion >> 16) & 0xffff; }
+};
+
+// All the names are stored one after another in one block of memory, each followed by a null character,
+// instead of in a string of their own.
+struct NameTable {
+	TableArray<wchar_t> arena;
+	// Where each name starts in the arena, plus the end of the arena as the last element.
+	TableArray<size_t> nameStarts;
+	TableArray<unsigned long long> contextFlags;
+	int size() const { return (int)contextFlags.size(); }
+	const wchar_t* getName(int nameIndex) const { return arena.data() + nameStarts[nameIndex]; }
+	// Without the null character.
+	size_t getNameLength(int nameIndex) const { return nameStarts[nameIndex + 1] - nameStarts[nameIndex] - 1; }
+};
+
+// Appends _N to the name if it has a number part, the way the engine displays it.
+std::wstring nameDataToString(const NameTable& nameTable, const NameData& nameData);
+
+struct Import {
+	NameData classPackage;
+	NameData className;
+	int outerIndex = 0;
+	NameData objectName;
+};
+
+struct ImportTable {
+	TableArray<Import> imports;
+};
+
+// Where a string is in a StringTable's arena.
+struct StringSpan {
+	size_t start = 0;
+	size_t length = 0;
+};
+
+// Strings kept the way NameTable keeps the names, all in one arena, but without null characters in between
+// and not necessarily in order, so that a string can be added once the ones it's made of are there.
+struct StringTable {
+	TableArray<wchar_t> arena;
+	TableArray<StringSpan> spans;
+	size_t size() const { return spans.size(); }
+	bool empty() const { return spans.empty(); }
+	const wchar_t* getString(size_t index) const { return arena.data() + spans[index].start; }
+	size_t getLength(size_t index) const { return spans[index].length; }
+	std::wstring get(size_t index) const { return std::wstring(getString(index), getLength(index)); }
+};
+
+// A struct of arrays: every vector has one element per export, so going over one field of all the exports,
+// like when following outer chains or looking up classes, only touches the memory of that field.
+struct ExportTable {
+	TableArray<int> classIndices;
+	TableArray<int> superIndices;
+	TableArray<int> outerIndices;
+	TableArray<NameData> objectNames;
+	TableArray<int> archetypeIndices;
+	TableArray<unsigned long long> objectFlags;
+	TableArray<int> serializeSizes;
+	TableArray<int> serialOffsets;
+	TableArray<DWORD> exportFlags;
+	// The counts of export i are generationNetObjectCounts[generationNetObjectCountStarts[i]] up to
+	// generationNetObjectCounts[generationNetObjectCountStarts[i + 1]]. Has one more element than there are exports.
+	TableArray<int> generationNetObjectCounts;
+	TableArray<size_t> generationNetObjectCountStarts { 0 };
+	TableArray<UEGuid> guids;
+	TableArray<DWORD> packageFlags;
+	// Position of serializeSize in the file. serialOffset follows it.
+	TableArray<int> filePositionsForSizeAndOffset;
+	// Worked out from the tables above once they're all read, one string per export, in export order.
+	StringTable names;
+	// The class part of the exports' file names. Exports with a class index of 0, which are classes, get Class.
+	StringTable classNames;
+	// The tree of folders the exports go in when extracted. Only exports that are the outer of another export
+	// have one: the folder of their own outer, their name and a \. So each shared part of a path is built only once.
+	StringTable folderPaths;
+	int size() const { return (int)classIndices.size(); }
+	bool empty() const { return classIndices.empty(); }
+	size_t getGenerationNetObjectCountCount(int exportIndex) const {
+		return generationNetObjectCountStarts[exportIndex + 1] - generationNetObjectCountStarts[exportIndex];
+	}
+	const int* getGenerationNetObjectCounts(int exportIndex) const {
+		return generationNetObjectCounts.data() + generationNetObjectCountStarts[exportIndex];
+	}
+	// Where gildor's extract tool puts the export, relative to the extracted folder: Outer1\Outer2\Name.Class.
+	std::wstring getFilePath(int exportIndex) const;
+	// The path of the export inside the package: Outer1.Outer2.Name.
+	std::wstring getObjectPath(int exportIndex) const;
+};
+
+// A parsed package. Open it once and query the tables as many times as needed.
+// Object indices used by the tables follow the engine's convention: 0 is null, negative values -1, -2, ...
+// point to imports[0], imports[1], ..., positive values 1, 2, ... point to exports[0], exports[1], ...
+class UpkPackage {
+public:
+	// Maps the file and parses it. On failure returns false and getError() says why.
+	bool open(LPCWSTR path);
+	// Parses a package that is already in memory. The memory must outlive this object.
+	bool parse(const BYTE* data, size_t size);
+	void close();
+	const std::wstring& getError() const { return error; }
+	// How many threads decompress a compressed package. 0, the default, means one per hardware thread.
+	void setJobCount(int count) { jobCount = count; }
+	// Decompresses on the given pool, which must outlive open or parse, instead of on a pool of its own.
+	void setThreadPool(ThreadPool* pool) { sharedPool = pool; }
+	// Takes effect on the next open or parse. For a compressed package, only the chunks the header is in get
+	// decompressed, and data() and size() cover just the header. The exports are read with readUncompressed
+	// or readExport, which decompress only the chunks they need.
+	void setDecompressOnDemand(bool on) { decompressOnDemand = on; }
+	bool isDecompressedOnDemand() const { return decompressOnDemand && isCompressed(); }
+	// Takes effect on the next open or parse. The tables are still checked, but exports.names, classNames and
+	// folderPaths aren't built, which saves working out a few strings per export when only the tables themselves
+	// are read, the way -info reads them. getFilePath and getObjectPath can't be used then.
+	void setLazyNames(bool on) { lazyNames = on; }
+	// How many decompressed chunks readUncompressed keeps for reuse. Default is 8.
+	void setChunkCacheSize(size_t chunkCount);
+	// Copies a range of the uncompressed package. Works the same whether the package is compressed or not,
+	// and whether it's decompressed on demand or not. Safe to call from several threads at once.
+	bool readUncompressed(size_t offset, size_t size, BYTE* out);
+	// The export's serialized data. Also safe to call from several threads at once.
+	bool readExport(int exportIndex, std::vector<BYTE>& out);
+	// hash64 of every export's serialized data, on the same threads as decompression. With decompression on demand
+	// the chunks are decompressed one at a time, so a package that gets all of its exports hashed is better opened
+	// without it.
+	bool hashExports(std::vector<unsigned long long>& hashes);
+	// The summary still describes the file, compressed chunks included, but the tables, data() and size()
+	// refer to the decompressed contents.
+	bool isCompressed() const { return summary.compressionFlags != 0; }
+	// The uncompressed package. For a compressed package this is the decompressed copy, whose summary says it isn't
+	// compressed, the same as what gildor's decompress tool produces.
+	const BYTE* data() const { return fileData; }
+	size_t size() const { return fileSize; }
+	// Zero if the package wasn't opened from a file.
+	unsigned long long getFileWriteTime() const { return mappedFile.getLastWriteTime(); }
+	// The size of the file itself, which for a compressed package isn't size(). Zero if it wasn't opened from a file.
+	unsigned long long getFileSize() const { return mappedFile.size(); }
+	// Takes effect on the next open. The name, import and export tables are loaded from the index file at this path
+	// if it was made from the same package file, and otherwise parsed and saved there for the next time. See PackageIndex.
+	// The loaded tables point into the mapped index instead of being copied out of it. The export names and paths
+	// aren't in the index and are worked out from the tables, unless setLazyNames is on.
+	// The summary is always parsed, and a compressed package is decompressed the same as without an index.
+	void setIndexPath(LPCWSTR path) { indexPath = path ? path : L""; }
+	// Whether the last open got the tables from the index.
+	bool isLoadedFromIndex() const { return loadedFromIndex; }
+	bool isValidObjectIndex(int objectIndex) const;
+	// The object name, with the _N suffix, of an import or export. Empty for 0.
+	std::wstring getObjectName(int objectIndex) const;
+	// The object name of an import or export as it's stored in the table. Null for 0.
+	const NameData* getObjectNameData(int objectIndex) const;
+	Summary summary;
+	NameTable nameTable;
+	ImportTable importTable;
+	ExportTable exportTable;
+private:
+	bool parseSummary(ByteCursor& cursor);
+	bool decompress();
+	bool buildChunkIndex();
+	bool readChunkBlocks(int chunkIndex, std::vector<CompressedChunk>& blocks);
+	bool readChunks(size_t offset, size_t size, BYTE* out);
+	bool parseNames(ByteCursor& cursor);
+	bool parseImports(ByteCursor& cursor);
+	bool parseExports(ByteCursor& cursor);
+	// Checks the indices in the tables and that the chains of outers have no loops.
+	bool resolveExports();
+	// Works out the names, class names and folders of the exports from the tables.
+	void buildExportNames();
+	bool readNameData(ByteCursor& cursor, NameData& nameData);
+	bool fail(const wchar_t* format, ...);
+	MappedFile mappedFile;
+	// The index the tables were loaded from. They point into it, so it stays mapped until close.
+	MappedFile indexFile;
+	std::vector<BYTE> decompressedData;
+	int jobCount = 0;
+	ThreadPool* sharedPool = nullptr;
+	bool decompressOnDemand = false;
+	bool lazyNames = false;
+	std::wstring indexPath;
+	bool loadedFromIndex = false;
+	// The chunk index: compressed chunks sorted by uncompressed offset, and all their blocks in the same order.
+	// The blocks of sortedChunks[i] are blocks[chunkFirstBlocks[i]] up to blocks[chunkFirstBlocks[i + 1]].
+	std::vector<CompressedChunk> sortedChunks;
+	std::vector<size_t> chunkFirstBlocks;
+	std::vector<CompressedChunk> blocks;
+	// The summary the uncompressed package starts with, which isn't stored in any chunk.
+	std::vector<BYTE> uncompressedSummary;
+	size_t uncompressedSize = 0;
+	ChunkCache chunkCache;
+	// Also held while readUncompressed sets the error, since it can be called from several threads.
+	std::mutex chunkCacheMutex;
+	// The package as it was passed to parse, still compressed.
+	const BYTE* compressedData = nullptr;
+	const BYTE* fileData = nullptr;
+	size_t fileSize = 0;
+	std::wstring error;
+};
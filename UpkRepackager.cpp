@@ -0,0 +1,701 @@
+#include "UpkRepackager.h"
+#include "WinError.h"
+#include "FileIo.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include "Hash.h"
+#include "Compression.h"
+#include "RunStats.h"
+#include <algorithm>
+#include <cstdarg>
+#include <chrono>
+#include <climits>
+
+static std::wstring joinPath(LPCWSTR folder, const std::wstring& relativePath) {
+	std::wstring fullPath = folder;
+	if (!fullPath.empty() && fullPath[fullPath.size() - 1] != PATH_SEPARATOR) {
+		fullPath += PATH_SEPARATOR;
+	}
+	return fullPath + relativePath;
+}
+
+std::wstring getExtractedFilePath(LPCWSTR extractedFolder, const ExportTable& exports, int exportIndex) {
+	return joinPath(extractedFolder, exports.getFilePath(exportIndex));
+}
+
+// Runs func on the pool for every index, lending each call a buffer of the buffer pool for as long as it runs.
+// A pool shared with other work can run more calls at once than it has threads, as a waiting worker picks up
+// other tasks, and those calls wait for a buffer instead of growing the memory use.
+template<typename Func>
+static void parallelForWithBuffer(ThreadPool& pool, BufferPool& buffers, size_t count, Func func) {
+	pool.parallelFor(count, [&](size_t index) {
+		BufferLease buffer(buffers);
+		func(index, buffer);
+	});
+}
+
+// The payloads are copied through buffers of this size, or smaller ones under a tight memory limit, but never smaller
+// than the chunks of a compressed package, which are each put together in one buffer.
+static const size_t maxCopyBufferSize = 0x400000;
+static const size_t compressedChunkSize = UpkRepackager::minMemoryLimit;
+static const size_t compressedBlockSize = 0x20000;
+
+std::unique_ptr<BufferPool> UpkRepackager::createBufferPool(size_t memoryLimit, int threadCount) {
+	if (!memoryLimit) {
+		return std::unique_ptr<BufferPool>(new BufferPool(maxCopyBufferSize, (size_t)(std::max)(threadCount, 1)));
+	}
+	const size_t bufferSize = (std::max)(compressedChunkSize, (std::min)(maxCopyBufferSize, memoryLimit));
+	return std::unique_ptr<BufferPool>(new BufferPool(bufferSize, memoryLimit / bufferSize));
+}
+
+UpkRepackager::UpkRepackager(const UpkPackage& package) : package(package) { }
+
+UpkRepackager::~UpkRepackager() {
+	closeOutput();
+}
+
+void UpkRepackager::closeOutput() {
+	output.close();
+}
+
+bool UpkRepackager::fail(const wchar_t* format, ...) {
+	wchar_t buffer[1024];
+	va_list args;
+	va_start(args, format);
+	vswprintf(buffer, _countof(buffer), format, args);
+	va_end(args);
+	std::unique_lock<std::mutex> guard(errorMutex);
+	if (!failed) {
+		failed = true;
+		error = buffer;
+	}
+	return false;
+}
+
+bool UpkRepackager::createOutput(LPCWSTR path) {
+	failed = false;
+	error.clear();
+	if (incremental) {
+		// The old output is kept, because whatever didn't change in it gets reused.
+		output.open(path, FILE_MODE_OPEN_ALWAYS);
+		manifestPath = std::wstring(path) + L".manifest";
+	} else {
+		output.open(path, FILE_MODE_CREATE_NEW);
+	}
+	if (!output.isOpen()) {
+		WinError err;
+		return fail(L"Failed to create file at location: %ls\n%ls", path, err.getMessage());
+	}
+	addRunStat(STAT_FILES_OPENED);
+	return true;
+}
+
+void UpkRepackager::replacePayload(int exportIndex, const void* data, size_t size) {
+	std::vector<BYTE>& buffer = replacedPayloads[exportIndex];
+	buffer.assign((const BYTE*)data, (const BYTE*)data + size);
+}
+
+bool UpkRepackager::planPayload(int exportIndex, LPCWSTR extractedFolder, const ExtractedFolderIndex& folderIndex,
+		PayloadPlan& plan) {
+	const ExportTable& exports = package.exportTable;
+	auto found = replacedPayloads.find(exportIndex);
+	if (found != replacedPayloads.end()) {
+		if (found->second.size() > INT_MAX) {
+			return fail(L"The data given for export %d is %llu bytes, more than the 2 GB that an export's size can be.",
+				exportIndex, (unsigned long long)found->second.size());
+		}
+		plan.data = found->second.data();
+		plan.size = (DWORD)found->second.size();
+	} else if (extractedFolder) {
+		plan.fileIndex = folderIndex.find(exports.getFilePath(exportIndex));
+		if (plan.fileIndex == -1) {
+			// Reported along with all the other missing files once every export is planned.
+			plan.path = getExtractedFilePath(extractedFolder, exports, exportIndex);
+			plan.isMissing = true;
+			return true;
+		}
+		const ExtractedFolderIndex::File& file = folderIndex.getFiles()[plan.fileIndex];
+		plan.path = joinPath(extractedFolder, file.relativePath);
+		// The export's size is a 32-bit signed field in the package.
+		if (file.size > INT_MAX) {
+			return fail(L"File %ls is %llu bytes, more than the 2 GB that an export's size can be.",
+				plan.path.c_str(), file.size);
+		}
+		plan.size = (DWORD)file.size;
+		plan.writeTime = file.writeTime;
+	} else if (package.isDecompressedOnDemand()) {
+		return fail(L"Export %d's original data is needed, but the package was only decompressed on demand.", exportIndex);
+	} else {
+		const int serialOffset = exports.serialOffsets[exportIndex];
+		const int serializeSize = exports.serializeSizes[exportIndex];
+		if (serialOffset < 0 || serializeSize < 0 || (size_t)serialOffset + (size_t)serializeSize > package.size()) {
+			return fail(L"Export %d's data is outside the package file.", exportIndex);
+		}
+		plan.data = package.data() + serialOffset;
+		plan.size = (DWORD)serializeSize;
+	}
+	return true;
+}
+
+bool UpkRepackager::writeAt(const void* data, DWORD size, unsigned long long offset) {
+	// The write goes to an offset rather than through a shared file pointer,
+	// so several jobs can write their parts of the file at the same time.
+	ScopedPhase phase("Write output");
+	addRunStat(STAT_WRITE_CALLS);
+	addRunStat(STAT_BYTES_WRITTEN, size);
+	if (!output.writeAt(data, size, offset)) {
+		WinError err;
+		return fail(L"Failed to write the new package: %ls", err.getMessage());
+	}
+	return true;
+}
+
+bool UpkRepackager::readAt(void* data, DWORD size, unsigned long long offset) {
+	ScopedPhase phase("Read output");
+	addRunStat(STAT_READ_CALLS);
+	addRunStat(STAT_BYTES_READ, size);
+	size_t bytesRead = 0;
+	if (!output.readAt(data, size, offset, bytesRead)) {
+		WinError err;
+		return fail(L"Failed to read the old contents of the new package: %ls", err.getMessage());
+	}
+	if (bytesRead != size) {
+		return fail(L"The new package got shorter while it was being updated.");
+	}
+	return true;
+}
+
+bool UpkRepackager::openPayloadFile(const PayloadPlan& plan, File& file) {
+	if (!file.open(plan.path.c_str(), FILE_MODE_READ, FILE_HINT_SEQUENTIAL)) {
+		WinError err;
+		return fail(L"Failed to open file %ls: %ls", plan.path.c_str(), err.getMessage());
+	}
+	addRunStat(STAT_FILES_OPENED);
+	return true;
+}
+
+bool UpkRepackager::readPayloadFile(File& file, const PayloadPlan& plan, size_t offset, size_t size, BYTE* out) {
+	ScopedPhase phase("Read extracted file");
+	addRunStat(STAT_READ_CALLS);
+	addRunStat(STAT_BYTES_READ, size);
+	size_t bytesRead = 0;
+	if (!file.readAt(out, size, offset, bytesRead)) {
+		WinError err;
+		return fail(L"Failed to read file %ls: %ls", plan.path.c_str(), err.getMessage());
+	}
+	if (bytesRead != size) {
+		return fail(L"File %ls changed while the package was being written.", plan.path.c_str());
+	}
+	return true;
+}
+
+bool UpkRepackager::hashPayload(const PayloadPlan& plan, const BufferLease& buffer, unsigned long long& hash) {
+	if (plan.path.empty()) {
+		hash = hash64(plan.data, plan.size);
+		return true;
+	}
+	File file;
+	if (!openPayloadFile(plan, file)) return false;
+	Hasher64 hasher;
+	for (DWORD done = 0; done < plan.size; ) {
+		const DWORD length = (DWORD)(std::min)((size_t)(plan.size - done), buffer.size());
+		if (!readPayloadFile(file, plan, done, length, buffer.data())) return false;
+		hasher.update(buffer.data(), length);
+		done += length;
+	}
+	hash = hasher.finish();
+	return true;
+}
+
+bool UpkRepackager::streamPayload(PayloadPlan& plan, const BufferLease& buffer) {
+	File file;
+	if (!plan.path.empty() && !openPayloadFile(plan, file)) return false;
+	Hasher64 hasher;
+	for (DWORD done = 0; done < plan.size; ) {
+		const DWORD length = (DWORD)(std::min)((size_t)(plan.size - done), buffer.size());
+		const BYTE* data = plan.data + done;
+		if (!plan.path.empty()) {
+			if (!readPayloadFile(file, plan, done, length, buffer.data())) return false;
+			data = buffer.data();
+		}
+		if (incremental) {
+			hasher.update(data, length);
+		}
+		if (!writeAt(data, length, plan.newOffset + done)) return false;
+		done += length;
+	}
+	if (incremental) {
+		plan.hash = hasher.finish();
+	}
+	return true;
+}
+
+bool UpkRepackager::patchHeader(const std::vector<PayloadPlan>& plans, size_t offset, size_t size, BYTE* out) {
+	const ExportTable& exports = package.exportTable;
+	const size_t headerSize = package.summary.totalHeaderSize;
+	for (int exportIndex = 0; exportIndex < exports.size(); ++exportIndex) {
+		int position = exports.filePositionsForSizeAndOffset[exportIndex];
+		if (position < 0 || (size_t)position + 8 > headerSize) {
+			return fail(L"Export %d is outside the package header.", exportIndex);
+		}
+		// The 8 bytes may be cut in two by the end of the part.
+		const size_t from = (std::max)((size_t)position, offset);
+		const size_t to = (std::min)((size_t)position + 8, offset + size);
+		if (from >= to) continue;
+		// Both fit, writeOutput made sure of it.
+		int sizeAndOffset[2] { (int)plans[exportIndex].size, (int)plans[exportIndex].newOffset };
+		memcpy(out + (from - offset), (const BYTE*)sizeAndOffset + (from - position), to - from);
+	}
+	return true;
+}
+
+bool UpkRepackager::writeHeader(BufferPool& buffers, const std::vector<PayloadPlan>& plans) {
+	BufferLease buffer(buffers);
+	const size_t headerSize = package.summary.totalHeaderSize;
+	for (size_t done = 0; done < headerSize; ) {
+		const size_t length = (std::min)(buffer.size(), headerSize - done);
+		memcpy(buffer.data(), package.data() + done, length);
+		if (!patchHeader(plans, done, length, buffer.data())
+				|| !writeAt(buffer.data(), (DWORD)length, done)) {
+			return false;
+		}
+		done += length;
+	}
+	return true;
+}
+
+bool UpkRepackager::copyPayloads(ThreadPool& pool, BufferPool& buffers, std::vector<PayloadPlan>& plans) {
+	ScopedPhase phase("Copy payloads");
+	// The payloads are laid out back to back, so neighbours that both need writing are gathered into one buffer
+	// and written with one call, which turns thousands of small writes into a few big sequential ones.
+	// A payload bigger than a buffer is streamed on its own, a buffer at a time.
+	const DWORD runSizeLimit = (DWORD)buffers.getBufferSize();
+	struct Run {
+		size_t firstPlan;
+		size_t planCount;
+		DWORD size;
+	};
+	std::vector<Run> runs;
+	for (size_t planIndex = 0; planIndex < plans.size(); ++planIndex) {
+		const PayloadPlan& plan = plans[planIndex];
+		if (!plan.changed) continue;
+		if (!runs.empty() && runs.back().firstPlan + runs.back().planCount == planIndex
+				&& runs.back().size + plan.size <= runSizeLimit) {
+			++runs.back().planCount;
+			runs.back().size += plan.size;
+		} else {
+			runs.push_back({ planIndex, 1, plan.size });
+		}
+	}
+	parallelForWithBuffer(pool, buffers, runs.size(), [&](size_t runIndex, const BufferLease& buffer) {
+		if (failed) return;
+		const Run& run = runs[runIndex];
+		if (run.size > runSizeLimit) {
+			streamPayload(plans[run.firstPlan], buffer);
+			return;
+		}
+		// The files of a run are all read with one readFiles, which can have them all in flight at once.
+		std::vector<FileReadRequest> requests;
+		DWORD position = 0;
+		for (size_t planIndex = run.firstPlan; planIndex < run.firstPlan + run.planCount; ++planIndex) {
+			const PayloadPlan& plan = plans[planIndex];
+			if (plan.path.empty()) {
+				memcpy(buffer.data() + position, plan.data, plan.size);
+			} else {
+				FileReadRequest request;
+				request.path = plan.path.c_str();
+				request.size = plan.size;
+				request.out = buffer.data() + position;
+				requests.push_back(request);
+			}
+			position += plan.size;
+		}
+		if (!requests.empty()) {
+			ScopedPhase phase("Read extracted files");
+			const int failedIndex = readFiles(requests, useIoUring);
+			if (failedIndex != -1) {
+				WinError err;
+				const FileReadRequest& request = requests[failedIndex];
+				fail(request.isOpened ? L"Failed to read file %ls: %ls" : L"Failed to open file %ls: %ls",
+					request.path, err.getMessage());
+				return;
+			}
+			for (const FileReadRequest& request : requests) {
+				if (request.bytesRead != request.size) {
+					fail(L"File %ls changed while the package was being written.", request.path);
+					return;
+				}
+			}
+		}
+		if (incremental) {
+			position = 0;
+			for (size_t planIndex = run.firstPlan; planIndex < run.firstPlan + run.planCount; ++planIndex) {
+				PayloadPlan& plan = plans[planIndex];
+				plan.hash = hash64(buffer.data() + position, plan.size);
+				position += plan.size;
+			}
+		}
+		writeAt(buffer.data(), run.size, plans[run.firstPlan].newOffset);
+	});
+	return !failed;
+}
+
+bool UpkRepackager::isManifestCurrent(const RepackageManifest& manifest) {
+	if (manifest.packageSize != package.size()
+			|| manifest.packageWriteTime != package.getFileWriteTime()
+			|| memcmp(&manifest.packageGuid, &package.summary.guid, sizeof(UEGuid)) != 0
+			|| manifest.entries.size() != (size_t)package.exportTable.size()) {
+		return false;
+	}
+	// Anything else that wrote to the output since it was made changes its time.
+	unsigned long long outputSize;
+	unsigned long long outputWriteTime;
+	return output.getSize(outputSize)
+		&& output.getWriteTime(outputWriteTime)
+		&& outputSize == manifest.outputSize
+		&& outputWriteTime == manifest.outputWriteTime;
+}
+
+bool UpkRepackager::moveWithinOutput(unsigned long long from, unsigned long long to, unsigned long long size,
+		const BufferLease& buffer) {
+	const DWORD chunkSize = (DWORD)buffer.size();
+	// Going in the direction of the move, a chunk never lands on a part of the payload that hasn't been read yet.
+	for (unsigned long long done = 0; done < size; ) {
+		DWORD length = (DWORD)(std::min)((unsigned long long)chunkSize, size - done);
+		unsigned long long position = to < from ? done : size - done - length;
+		if (!readAt(buffer.data(), length, from + position)
+				|| !writeAt(buffer.data(), length, to + position)) {
+			return false;
+		}
+		done += length;
+	}
+	return true;
+}
+
+bool UpkRepackager::updateOutput(ThreadPool& pool, BufferPool& buffers, std::vector<PayloadPlan>& plans,
+		const RepackageManifest& manifest) {
+	// A file with the same path, size and time as last time is taken as unchanged without reading it.
+	// Otherwise its contents decide, so touching a file without changing it costs a read but no write.
+	{
+		ScopedPhase phase("Compare with manifest");
+		parallelForWithBuffer(pool, buffers, plans.size(), [&](size_t exportIndex, const BufferLease& buffer) {
+			if (failed) return;
+			PayloadPlan& plan = plans[exportIndex];
+			const ManifestEntry& entry = manifest.entries[exportIndex];
+			if (!plan.path.empty() && plan.path == entry.path && plan.size == entry.size
+					&& plan.writeTime == entry.writeTime) {
+				plan.hash = entry.hash;
+				plan.changed = false;
+				return;
+			}
+			if (!hashPayload(plan, buffer, plan.hash)) return;
+			plan.changed = plan.size != entry.size || plan.hash != entry.hash;
+		});
+	}
+	if (failed) return false;
+
+	// Unchanged payloads that have to make room for, or fill the room left by, a resized one are moved
+	// within the output. Neighbours that move by the same amount are moved together.
+	struct Move {
+		unsigned long long from;
+		unsigned long long to;
+		unsigned long long size;
+	};
+	std::vector<Move> moves;
+	for (size_t exportIndex = 0; exportIndex < plans.size(); ++exportIndex) {
+		const PayloadPlan& plan = plans[exportIndex];
+		const ManifestEntry& entry = manifest.entries[exportIndex];
+		if (plan.changed || plan.newOffset == entry.offset) continue;
+		if (!moves.empty() && moves.back().from + moves.back().size == entry.offset
+				&& moves.back().to + moves.back().size == plan.newOffset) {
+			moves.back().size += plan.size;
+		} else {
+			moves.push_back({ entry.offset, plan.newOffset, plan.size });
+		}
+	}
+	// Moves towards the start go in file order, moves towards the end go in reverse,
+	// so nothing is overwritten before it has been moved itself.
+	{
+		ScopedPhase phase("Move payloads");
+		BufferLease buffer(buffers);
+		for (const Move& move : moves) {
+			if (move.to < move.from && !moveWithinOutput(move.from, move.to, move.size, buffer)) return false;
+		}
+		for (auto move = moves.rbegin(); move != moves.rend(); ++move) {
+			if (move->to > move->from && !moveWithinOutput(move->from, move->to, move->size, buffer)) return false;
+		}
+	}
+	// The sizes and offsets of the moved and changed exports are all patched in memory and written with the header.
+	return copyPayloads(pool, buffers, plans) && writeHeader(buffers, plans);
+}
+
+bool UpkRepackager::finishIncremental(const std::vector<PayloadPlan>& plans) {
+	ScopedPhase phase("Finish incremental output");
+	const unsigned long long outputSize = plans.empty()
+		? package.summary.totalHeaderSize
+		: (unsigned long long)plans.back().newOffset + plans.back().size;
+	if (!output.setSize(outputSize)) {
+		WinError err;
+		return fail(L"Failed to set the size of the new package: %ls", err.getMessage());
+	}
+	// The output gets a time of our own choosing, which is remembered, so that the next run can tell
+	// if anything else has written to it since.
+	const unsigned long long now = getCurrentFileTime();
+	if (!output.setWriteTime(now)) {
+		WinError err;
+		return fail(L"Failed to set the time of the new package: %ls", err.getMessage());
+	}
+
+	RepackageManifest manifest;
+	manifest.packageSize = package.size();
+	manifest.packageWriteTime = package.getFileWriteTime();
+	manifest.packageGuid = package.summary.guid;
+	manifest.outputSize = outputSize;
+	manifest.outputWriteTime = now;
+	manifest.entries.resize(plans.size());
+	for (size_t exportIndex = 0; exportIndex < plans.size(); ++exportIndex) {
+		const PayloadPlan& plan = plans[exportIndex];
+		ManifestEntry& entry = manifest.entries[exportIndex];
+		entry.path = plan.path;
+		entry.size = plan.size;
+		entry.writeTime = plan.writeTime;
+		entry.hash = plan.hash;
+		entry.offset = plan.newOffset;
+	}
+	if (!manifest.save(manifestPath.c_str())) {
+		WinError err;
+		return fail(L"Failed to save the manifest %ls: %ls", manifestPath.c_str(), err.getMessage());
+	}
+	return true;
+}
+
+bool UpkRepackager::readPayloadPart(const PayloadPlan& plan, size_t offset, size_t size, BYTE* out) {
+	if (plan.path.empty()) {
+		memcpy(out, plan.data + offset, size);
+		return true;
+	}
+	File file;
+	return openPayloadFile(plan, file) && readPayloadFile(file, plan, offset, size, out);
+}
+
+bool UpkRepackager::readUncompressed(const std::vector<PayloadPlan>& plans, size_t offset, size_t size, BYTE* out) {
+	// Same as what writeOutput writes without compression: the header, then the payloads over it, gaps left zeroed.
+	memset(out, 0, size);
+	const size_t headerSize = package.summary.totalHeaderSize;
+	if (offset < headerSize) {
+		const size_t length = (std::min)(size, headerSize - offset);
+		memcpy(out, package.data() + offset, length);
+		if (!patchHeader(plans, offset, length, out)) return false;
+	}
+	const size_t end = offset + size;
+	auto plan = std::upper_bound(plans.begin(), plans.end(), offset, [](size_t position, const PayloadPlan& plan) {
+		return position < (size_t)plan.newOffset + plan.size;
+	});
+	for (; plan != plans.end() && (size_t)plan->newOffset < end; ++plan) {
+		size_t from = (std::max)(offset, (size_t)plan->newOffset);
+		size_t to = (std::min)(end, (size_t)plan->newOffset + plan->size);
+		if (from < to && !readPayloadPart(*plan, from - plan->newOffset, to - from, out + (from - offset))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool UpkRepackager::compressChunk(const std::vector<PayloadPlan>& plans, size_t chunkStart, size_t chunkSize,
+		const BufferLease& buffer, std::vector<BYTE>& chunk) {
+	ScopedPhase phase("Compress chunk");
+	if (!readUncompressed(plans, chunkStart, chunkSize, buffer.data())) return false;
+	const size_t blockSize = compressedBlockSize;
+	const size_t blockCount = (chunkSize + blockSize - 1) / blockSize;
+	chunk.resize(16 + blockCount * 8);
+	DWORD chunkHeader[4] { PACKAGE_FILE_TAG, (DWORD)blockSize, 0, (DWORD)chunkSize };
+	std::vector<BYTE> block;
+	for (size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex) {
+		size_t blockStart = blockIndex * blockSize;
+		size_t thisBlockSize = (std::min)(blockSize, chunkSize - blockStart);
+		compressBlock(compression, buffer.data() + blockStart, thisBlockSize, block);
+		DWORD sizes[2] { (DWORD)block.size(), (DWORD)thisBlockSize };
+		memcpy(chunk.data() + 16 + blockIndex * 8, sizes, sizeof sizes);
+		chunk.insert(chunk.end(), block.begin(), block.end());
+		chunkHeader[2] += (DWORD)block.size();
+	}
+	memcpy(chunk.data(), chunkHeader, sizeof chunkHeader);
+	return true;
+}
+
+bool UpkRepackager::writeCompressedOutput(ThreadPool& pool, BufferPool& buffers, const std::vector<PayloadPlan>& plans) {
+	const Summary& summary = package.summary;
+	if (!isCompressionSupported(compression)) {
+		return fail(L"Compression flags 0x%x don't name a supported compression method.", compression);
+	}
+	// Every export's place in the header is checked before anything is written, rather than when its chunk is.
+	if (!patchHeader(plans, 0, 0, nullptr)) return false;
+
+	// Everything after the summary is compressed, in chunks of a fixed uncompressed size, each split into blocks
+	// that are compressed separately. The engine reads the same block size.
+	const size_t chunkSize = compressedChunkSize;
+	const size_t headerSize = summary.totalHeaderSize;
+	// package.data() is always uncompressed, so its summary has no chunk table.
+	const size_t summarySize = summary.sizeInFile - summary.compressedChunks.size() * 16;
+	const size_t uncompressedSize = plans.empty()
+		? headerSize
+		: (std::max)(headerSize, (size_t)plans.back().newOffset + plans.back().size);
+	const size_t chunkCount = (uncompressedSize - summarySize + chunkSize - 1) / chunkSize;
+	// The chunk table has 32-bit signed fields, the uncompressed offsets and sizes included.
+	if (uncompressedSize > INT_MAX) {
+		return fail(L"The package would be 0x%llx bytes uncompressed,"
+			L" more than the 2 GB that a compressed package can hold.", (unsigned long long)uncompressedSize);
+	}
+
+	// The chunks are compressed a wave at a time, and each wave is written as soon as it's done, so only one wave
+	// of compressed chunks is ever held. A wave's compressed chunks take at most about half of what the buffers can,
+	// so with a memory limit everything stays within one and a half times the limit, however big the package is.
+	// The summary with the chunk table goes in front of the chunks, and is written last.
+	const size_t waveSize = (std::max)(buffers.getBufferSize() * buffers.getMaxCount() / (2 * chunkSize), (size_t)1);
+	std::vector<std::vector<BYTE>> wave((std::min)(waveSize, chunkCount));
+	std::vector<size_t> compressedSizes(chunkCount);
+	const size_t firstChunkOffset = summarySize + chunkCount * 16;
+	size_t compressedOffset = firstChunkOffset;
+	auto startTime = std::chrono::steady_clock::now();
+	for (size_t firstChunk = 0; firstChunk < chunkCount; firstChunk += wave.size()) {
+		const size_t chunksInWave = (std::min)(wave.size(), chunkCount - firstChunk);
+		parallelForWithBuffer(pool, buffers, chunksInWave, [&](size_t waveIndex, const BufferLease& buffer) {
+			if (failed) return;
+			const size_t chunkStart = summarySize + (firstChunk + waveIndex) * chunkSize;
+			const size_t thisChunkSize = (std::min)(chunkSize, uncompressedSize - chunkStart);
+			compressChunk(plans, chunkStart, thisChunkSize, buffer, wave[waveIndex]);
+		});
+		if (failed) return false;
+		for (size_t waveIndex = 0; waveIndex < chunksInWave; ++waveIndex) {
+			std::vector<BYTE>& chunk = wave[waveIndex];
+			if (compressedOffset + chunk.size() > INT_MAX) {
+				return fail(L"The compressed package would be over 2 GB.");
+			}
+			if (!writeAt(chunk.data(), (DWORD)chunk.size(), compressedOffset)) return false;
+			compressedSizes[firstChunk + waveIndex] = chunk.size();
+			compressedOffset += chunk.size();
+			chunk.clear();
+		}
+	}
+	compressionStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	// The summary stays uncompressed, with the compressed chunk table added in.
+	const size_t compressionFlagsPosition = summary.filePositionForCompressionFlags;
+	std::vector<BYTE> fileSummary(package.data(), package.data() + compressionFlagsPosition);
+	DWORD packageFlags = summary.packageFlags | PKG_STORE_COMPRESSED;
+	memcpy(fileSummary.data() + summary.filePositionForPackageFlags, &packageFlags, 4);
+	int chunkTableHead[2] { (int)compression, (int)chunkCount };
+	fileSummary.insert(fileSummary.end(), (const BYTE*)chunkTableHead, (const BYTE*)(chunkTableHead + 2));
+	size_t chunkOffset = firstChunkOffset;
+	for (size_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex) {
+		size_t chunkStart = summarySize + chunkIndex * chunkSize;
+		int entry[4] {
+			(int)chunkStart,
+			(int)(std::min)(chunkSize, uncompressedSize - chunkStart),
+			(int)chunkOffset,
+			(int)compressedSizes[chunkIndex]
+		};
+		fileSummary.insert(fileSummary.end(), (const BYTE*)entry, (const BYTE*)(entry + 4));
+		chunkOffset += compressedSizes[chunkIndex];
+	}
+	fileSummary.insert(fileSummary.end(), package.data() + compressionFlagsPosition + 8, package.data() + summarySize);
+	if (!writeAt(fileSummary.data(), (DWORD)fileSummary.size(), 0)) return false;
+	compressionStats.uncompressedSize = uncompressedSize;
+	compressionStats.compressedSize = compressedOffset;
+	return true;
+}
+
+bool UpkRepackager::writeOutput(LPCWSTR extractedFolder) {
+	const ExportTable& exports = package.exportTable;
+	if (!sharedBuffers && memoryLimit && memoryLimit < minMemoryLimit) {
+		return fail(L"The memory limit must be at least %d bytes.", (int)minMemoryLimit);
+	}
+	unusedFiles.clear();
+	ExtractedFolderIndex folderIndex;
+	if (extractedFolder && !folderIndex.build(extractedFolder)) {
+		return fail(L"%ls", folderIndex.getError().c_str());
+	}
+
+	std::unique_ptr<ThreadPool> ownPool;
+	if (!sharedPool) ownPool.reset(new ThreadPool(jobCount));
+	ThreadPool& pool = sharedPool ? *sharedPool : *ownPool;
+	std::unique_ptr<BufferPool> ownBuffers;
+	if (!sharedBuffers) ownBuffers = createBufferPool(memoryLimit, pool.getThreadCount());
+	BufferPool& buffers = sharedBuffers ? *sharedBuffers : *ownBuffers;
+	std::vector<PayloadPlan> plans(exports.size());
+	{
+		ScopedPhase phase("Plan payloads");
+		pool.parallelFor(exports.size(), [&](size_t exportIndex) {
+			if (!failed) planPayload((int)exportIndex, extractedFolder, folderIndex, plans[exportIndex]);
+		});
+	}
+	if (failed) return false;
+	if (extractedFolder) {
+		std::wstring missingFiles;
+		std::vector<bool> isFileUsed(folderIndex.getFiles().size(), false);
+		for (const PayloadPlan& plan : plans) {
+			if (plan.isMissing) {
+				if (!missingFiles.empty()) missingFiles += L'\n';
+				missingFiles += L"File not found: " + plan.path;
+			} else if (plan.fileIndex != -1) {
+				isFileUsed[plan.fileIndex] = true;
+			}
+		}
+		for (size_t fileIndex = 0; fileIndex < isFileUsed.size(); ++fileIndex) {
+			if (!isFileUsed[fileIndex]) {
+				unusedFiles.push_back(joinPath(extractedFolder, folderIndex.getFiles()[fileIndex].relativePath));
+			}
+		}
+		if (!missingFiles.empty()) {
+			// Can be longer than what fail formats.
+			failed = true;
+			error = missingFiles;
+			return false;
+		}
+	}
+
+	// The new offsets are known before anything is read, so the payloads can be copied in any order.
+	// They're worked out in 64 bits, but each export's offset is a 32-bit signed field in the package, so the new
+	// package can't go on once an export would start past 2 GB. Caught here, before anything is written.
+	unsigned long long currentOffset = exports.empty() ? 0 : (unsigned long long)(std::max)(exports.serialOffsets[0], 0);
+	for (size_t exportIndex = 0; exportIndex < plans.size(); ++exportIndex) {
+		PayloadPlan& plan = plans[exportIndex];
+		if (currentOffset > INT_MAX) {
+			return fail(L"Export %d would start at 0x%llx in the new package,"
+				L" past the 2 GB that an export's offset can point to.", (int)exportIndex, currentOffset);
+		}
+		plan.newOffset = currentOffset;
+		currentOffset += plan.size;
+	}
+
+	if (compression) {
+		if (incremental) {
+			return fail(L"A compressed package can't be updated incrementally.");
+		}
+		return writeCompressedOutput(pool, buffers, plans);
+	}
+
+	if (incremental) {
+		RepackageManifest manifest;
+		bool isCurrent = manifest.load(manifestPath.c_str()) && isManifestCurrent(manifest);
+		// Once the output starts changing, the old manifest no longer describes it.
+		if (!deleteFile(manifestPath.c_str())) {
+			WinError err;
+			return fail(L"Failed to delete the old manifest %ls: %ls", manifestPath.c_str(), err.getMessage());
+		}
+		if (isCurrent) {
+			return updateOutput(pool, buffers, plans, manifest) && finishIncremental(plans);
+		}
+	}
+
+	// Sized up front, so the file system can give it space in one go rather than growing it with every write.
+	const unsigned long long outputSize = (std::max)((unsigned long long)package.summary.totalHeaderSize,
+		plans.empty() ? 0 : (unsigned long long)plans.back().newOffset + plans.back().size);
+	if (!output.setSize(outputSize)) {
+		WinError err;
+		return fail(L"Failed to set the size of the new package: %ls", err.getMessage());
+	}
+	return copyPayloads(pool, buffers, plans)
+		&& writeHeader(buffers, plans)
+		&& (!incremental || finishIncremental(plans));
+}
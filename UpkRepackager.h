@@ -0,0 +1,140 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include "UpkPackage.h"
+#include "RepackageManifest.h"
+#include "ExtractedFolderIndex.h"
+#include "FileIo.h"
+
+class ThreadPool;
+class BufferPool;
+class BufferLease;
+
+// Writes a copy of a package with the export payloads replaced.
+// A payload comes from, in order of preference: a buffer given to replacePayload, the file in the extracted folder
+// (extracted with gildor's tool, at path\to\outer\ObjectName.ClassName), the original package.
+// The layout of the new file is the original header followed by the payloads in export order.
+// With compression on, the new file is a compressed package instead, made of compressed chunks of the same layout.
+// In incremental mode a manifest is kept next to the new file. If the new file is still the one the manifest describes,
+// only the exports that changed since then are written: in place when their size is the same, otherwise by shifting
+// the exports after them.
+class UpkRepackager {
+public:
+	UpkRepackager(const UpkPackage& package);
+	UpkRepackager(const UpkRepackager&) = delete;
+	UpkRepackager& operator=(const UpkRepackager&) = delete;
+	~UpkRepackager();
+	// Creates the new package file, which starts a save, so the error of the last one is cleared.
+	// Fails if the file already exists, unless incremental mode is on.
+	bool createOutput(LPCWSTR path);
+	void closeOutput();
+	void replacePayload(int exportIndex, const void* data, size_t size);
+	// How many exports are read and written at the same time. 0 means one per hardware thread. The default is 1.
+	void setJobCount(int count) { jobCount = count; }
+	// Runs the work on the given pool, which must outlive writeOutput, instead of on a pool of its own.
+	// The job count is ignored then. Lets many packages share one pool, see BatchRunner.
+	void setThreadPool(ThreadPool* pool) { sharedPool = pool; }
+	// Caps the memory that the payloads are copied through at about this many bytes, however big they are,
+	// by streaming the bigger ones. 0, the default, gives every thread one 4 MB buffer. Anything else must be
+	// at least minMemoryLimit, the size of one compressed chunk, or writeOutput fails.
+	void setMemoryLimit(size_t bytes) { memoryLimit = bytes; }
+	static const size_t minMemoryLimit = 0x100000;
+	// Copies through the buffers of the given pool, which must outlive writeOutput, instead of a pool of its own.
+	// The memory limit is ignored then. Lets many packages share one memory limit, see BatchRunner.
+	void setBufferPool(BufferPool* pool) { sharedBuffers = pool; }
+	// The buffer pool writeOutput makes for itself for the given memory limit.
+	static std::unique_ptr<BufferPool> createBufferPool(size_t memoryLimit, int threadCount);
+	// Must be called before createOutput. Can't be combined with compression.
+	void setIncremental(bool on) { incremental = on; }
+	// Reads the extracted files through io_uring where the system has it, see readFiles. Off by default.
+	void setIoUring(bool on) { useIoUring = on; }
+	// COMPRESS_ZLIB or COMPRESS_LZO to write a compressed package. 0, the default, writes it uncompressed.
+	void setCompression(DWORD compressionFlags) { compression = compressionFlags; }
+	struct CompressionStats {
+		unsigned long long uncompressedSize = 0;
+		unsigned long long compressedSize = 0;
+		// Wall time spent compressing, reading the payloads included.
+		double seconds = 0.;
+	};
+	// Filled in by writeOutput when compression is on.
+	const CompressionStats& getCompressionStats() const { return compressionStats; }
+	// extractedFolder may be null, then exports that weren't replaced keep their original payloads.
+	// The folder is listed once up front. If files are missing for several exports, the error lists all of them.
+	bool writeOutput(LPCWSTR extractedFolder);
+	// Files in the extracted folder that no export was read from. Filled in by writeOutput.
+	const std::vector<std::wstring>& getUnusedFiles() const { return unusedFiles; }
+	const std::wstring& getError() const { return error; }
+private:
+	// Where one export's payload comes from and where it goes in the new file.
+	struct PayloadPlan {
+		// Empty when the payload is already in memory.
+		std::wstring path;
+		const BYTE* data = nullptr;
+		DWORD size = 0;
+		unsigned long long writeTime = 0;
+		// Only filled in incremental mode.
+		unsigned long long hash = 0;
+		// Always fits the 32-bit field, but is added to in 64 bits.
+		unsigned long long newOffset = 0;
+		bool changed = true;
+		// Into the extracted folder index. -1 if the payload doesn't come from a file.
+		int fileIndex = -1;
+		// The export's file isn't in the extracted folder. path says where it should have been.
+		bool isMissing = false;
+	};
+	bool planPayload(int exportIndex, LPCWSTR extractedFolder, const ExtractedFolderIndex& folderIndex, PayloadPlan& plan);
+	bool openPayloadFile(const PayloadPlan& plan, File& file);
+	bool readPayloadFile(File& file, const PayloadPlan& plan, size_t offset, size_t size, BYTE* out);
+	// Hashes the payload, reading it from its file a buffer at a time if it comes from one.
+	bool hashPayload(const PayloadPlan& plan, const BufferLease& buffer, unsigned long long& hash);
+	// Writes a payload too big for one buffer a buffer at a time, computing its hash in incremental mode.
+	bool streamPayload(PayloadPlan& plan, const BufferLease& buffer);
+	// Patches the new size and offset of every export that falls into the part of the header at offset.
+	bool patchHeader(const std::vector<PayloadPlan>& plans, size_t offset, size_t size, BYTE* out);
+	// Writes the original header with every export's new size and offset patched in, a buffer at a time.
+	bool writeHeader(BufferPool& buffers, const std::vector<PayloadPlan>& plans);
+	// Writes the payloads of the plans that changed, computing their hashes in incremental mode.
+	bool copyPayloads(ThreadPool& pool, BufferPool& buffers, std::vector<PayloadPlan>& plans);
+	bool isManifestCurrent(const RepackageManifest& manifest);
+	bool updateOutput(ThreadPool& pool, BufferPool& buffers, std::vector<PayloadPlan>& plans,
+		const RepackageManifest& manifest);
+	bool moveWithinOutput(unsigned long long from, unsigned long long to, unsigned long long size,
+		const BufferLease& buffer);
+	bool finishIncremental(const std::vector<PayloadPlan>& plans);
+	bool writeCompressedOutput(ThreadPool& pool, BufferPool& buffers, const std::vector<PayloadPlan>& plans);
+	// Reads part of the new package as it would be if it were uncompressed.
+	bool readUncompressed(const std::vector<PayloadPlan>& plans, size_t offset, size_t size, BYTE* out);
+	// Compresses the part of the new package at chunkStart into one chunk the way the engine stores them:
+	// a table of the blocks and then the blocks. The buffer holds the uncompressed part meanwhile.
+	bool compressChunk(const std::vector<PayloadPlan>& plans, size_t chunkStart, size_t chunkSize,
+		const BufferLease& buffer, std::vector<BYTE>& chunk);
+	bool readPayloadPart(const PayloadPlan& plan, size_t offset, size_t size, BYTE* out);
+	bool writeAt(const void* data, DWORD size, unsigned long long offset);
+	bool readAt(void* data, DWORD size, unsigned long long offset);
+	bool fail(const wchar_t* format, ...);
+	const UpkPackage& package;
+	std::unordered_map<int, std::vector<BYTE>> replacedPayloads;
+	int jobCount = 1;
+	ThreadPool* sharedPool = nullptr;
+	size_t memoryLimit = 0;
+	BufferPool* sharedBuffers = nullptr;
+	bool incremental = false;
+	bool useIoUring = false;
+	DWORD compression = 0;
+	CompressionStats compressionStats;
+	std::vector<std::wstring> unusedFiles;
+	File output;
+	std::wstring manifestPath;
+	// Set by whichever job fails first.
+	std::mutex errorMutex;
+	std::atomic<bool> failed { false };
+	std::wstring error;
+};
+
+// Builds path\to\outer\ObjectName.ClassName of the export under the extracted folder.
+std::wstring getExtractedFilePath(LPCWSTR extractedFolder, const ExportTable& exports, int exportIndex);
@@ -1,11 +1,27 @@
-#include <Windows.h>
 #include "WinError.h"
 #include <iostream>
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdlib>
+#endif
 
 // This is an almost exact copy-paste of the WinError.cpp file from ggxrd_hitbox_overlay project
+// Outside Windows the code is errno and the message comes from strerror.
+
+#ifdef _WIN32
+#define allocMessage(size) LocalAlloc(0, size)
+#define freeMessage(message) LocalFree(message)
+#else
+#define allocMessage(size) malloc(size)
+#define freeMessage(message) free(message)
+#endif
 
 WinError::WinError() {
+#ifdef _WIN32
     code = GetLastError();
+#else
+    code = errno;
+#endif
 }
 void WinError::moveFrom(WinError& src) noexcept {
     message = src.message;
@@ -17,7 +33,7 @@ void WinError::copyFrom(const WinError& src) {
     code = src.code;
     if (src.message) {
         size_t len = wcslen(src.message);
-        message = (LPWSTR)LocalAlloc(0, (len + 1) * sizeof(wchar_t));
+        message = (LPWSTR)allocMessage((len + 1) * sizeof(wchar_t));
         if (message) {
             memcpy(message, src.message, (len + 1) * sizeof(wchar_t));
         }
@@ -36,6 +52,7 @@ WinError::WinError(WinError&& src) noexcept {
 }
 LPCWSTR WinError::getMessage() {
     if (!message) {
+#ifdef _WIN32
         FormatMessageW(
             FORMAT_MESSAGE_ALLOCATE_BUFFER |
             FORMAT_MESSAGE_FROM_SYSTEM |
@@ -45,6 +62,13 @@ LPCWSTR WinError::getMessage() {
             MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
             (LPWSTR)(&message),
             0, NULL);
+#else
+        std::wstring text = utf8ToWide(std::string(strerror((int)code)));
+        message = (LPWSTR)allocMessage((text.size() + 1) * sizeof(wchar_t));
+        if (message) {
+            memcpy(message, text.c_str(), (text.size() + 1) * sizeof(wchar_t));
+        }
+#endif
     }
 
     
@@ -67,7 +91,7 @@ std::string WinError::getMessageA() {
 }
 void WinError::clear() {
     if (message) {
-        LocalFree(message);
+        freeMessage(message);
         message = NULL;
     }
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "Platform.h"
 #include <string>
 // This is an exact copy-paste of the WinError.h file from ggxrd_hitbox_overlay project
 